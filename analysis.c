@@ -0,0 +1,954 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "mem.h"
+#include "minesweeper.h"
+
+/* Worker view of a cell: the count of an open cell plus what is known about it */
+#define VIEW_COUNT_BITS 0x0f
+#define VIEW_OPEN_BIT 0x10
+#define VIEW_SAFE_BIT 0x20
+#define VIEW_MINE_BIT 0x40
+#define VIEW_QUEUED_BIT 0x80
+#define VIEW_KNOWN_BITS (VIEW_OPEN_BIT | VIEW_SAFE_BIT | VIEW_MINE_BIT)
+
+/* Solver scratch for a frontier cell: its value in the first model, and whether it is settled or can go either way */
+#define ANALYSIS_SAT_MINE 0x01
+#define ANALYSIS_SAT_DONE 0x02
+
+/* Component search flags for a cell: reached in the current pass, and given an exact mine share */
+#define COMPONENT_SEEN 0x01
+#define COMPONENT_EXACT 0x02
+/* Tag of a covered cell in a component key, numbers are tagged with the mines still needed around them */
+#define COMPONENT_COVERED 0xff
+/* A covered cell takes part in at most 8 numbers */
+#define COMPONENT_MAX_RECORDS (ANALYSIS_COMPONENT_MAX_CELLS * 9)
+
+/* Covered neighbors of an open cell that are not worked out yet, and how many of them are mines */
+typedef struct Constraint {
+  uint32_t cells[8];
+  unsigned int len;
+  int need;
+} Constraint_T;
+
+/**
+ * A frontier component: covered cells in doubt and the numbers around them, with every number next to one of the
+ * cells and every cell in doubt next to one of the numbers. The key is its canonical form, one (row, column, tag)
+ * triple per cell sorted by position, taken over the eight rotations and reflections of the square and translated to
+ * the origin, whichever reads smallest, then the topology. order[k] is the cell behind the k-th triple.
+ */
+typedef struct Component {
+  uint32_t index[COMPONENT_MAX_RECORDS];
+  int row[COMPONENT_MAX_RECORDS];
+  int col[COMPONENT_MAX_RECORDS];
+  uint8_t tag[COMPONENT_MAX_RECORDS];
+  unsigned int len;
+  unsigned int num_covered;
+  uint8_t key[3 * COMPONENT_MAX_RECORDS + 1];
+  uint16_t order[COMPONENT_MAX_RECORDS];
+} Component_T;
+
+/* Enumeration of a component's layouts in key order */
+typedef struct ComponentSearch {
+  unsigned int num_covered;
+  uint8_t numbers[ANALYSIS_COMPONENT_MAX_CELLS][8];
+  uint8_t num_numbers[ANALYSIS_COMPONENT_MAX_CELLS];
+  int need[COMPONENT_MAX_RECORDS];
+  int mines[COMPONENT_MAX_RECORDS];
+  int left[COMPONENT_MAX_RECORDS];
+  uint8_t mine[ANALYSIS_COMPONENT_MAX_CELLS];
+  uint64_t mine_layouts[ANALYSIS_COMPONENT_MAX_CELLS];
+  uint64_t layouts;
+  unsigned long steps;
+} ComponentSearch_T;
+
+/* One run of the solver: the covered cells next to a number, and the bounds the mine total puts on their mines */
+typedef struct SatQuery {
+  uint32_t *frontier;
+  uint32_t *lits;
+  uint8_t *flags;
+  unsigned int num_frontier;
+  unsigned int interior;
+  unsigned int bombs;
+  unsigned int lo;
+  unsigned int hi;
+  /* Whether some model seen so far leaves a mine, or a safe cell, off the frontier */
+  int interior_mine;
+  int interior_safe;
+} SatQuery_T;
+
+static unsigned int analysis_neighbors(GameBoard_T *board, unsigned int index, uint32_t out[8]) {
+  return topology_neighbors(&board->topology, index, out);
+}
+
+/* Called between reads of the board: the read is only consistent if the generation has not moved since it began */
+static int analysis_cancelled(Analysis_T *analysis, uint64_t generation) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&analysis->stopping, memory_order_relaxed) ||
+         atomic_load_explicit(&analysis->generation, memory_order_relaxed) != generation;
+}
+
+static void analysis_constraint(Analysis_T *analysis, GameBoard_T *board, unsigned int index, Constraint_T *k) {
+  uint32_t neighbors[8];
+  unsigned int n = analysis_neighbors(board, index, neighbors);
+  k->len = 0;
+  k->need = analysis->view[index] & VIEW_COUNT_BITS;
+  for (unsigned int ii = 0; ii < n; ii++) {
+    uint8_t v = analysis->view[neighbors[ii]];
+    if (v & VIEW_MINE_BIT) {
+      k->need--;
+    } else if (!(v & VIEW_KNOWN_BITS)) {
+      k->cells[k->len++] = neighbors[ii];
+    }
+  }
+}
+
+/* Only numbered open cells constrain their neighbors, the bomb that went off is open but has no count */
+static void analysis_queue(Analysis_T *analysis, unsigned int index, size_t *top) {
+  uint8_t v = analysis->view[index];
+  if ((v & (VIEW_OPEN_BIT | VIEW_MINE_BIT | VIEW_QUEUED_BIT)) == VIEW_OPEN_BIT && (v & VIEW_COUNT_BITS)) {
+    analysis->view[index] |= VIEW_QUEUED_BIT;
+    analysis->work[(*top)++] = index;
+  }
+}
+
+/* Settles a cell and requeues the open cells whose constraints it took part in */
+static void analysis_mark(Analysis_T *analysis, GameBoard_T *board, unsigned int index, uint8_t bit, size_t *top) {
+  uint32_t neighbors[8];
+  analysis->view[index] |= bit;
+  if (analysis->solving && bit == VIEW_SAFE_BIT) {
+    analysis->work[(*top)++] = index;
+  }
+  unsigned int n = analysis_neighbors(board, index, neighbors);
+  for (unsigned int ii = 0; ii < n; ii++) {
+    analysis_queue(analysis, neighbors[ii], top);
+  }
+}
+
+/* Returns 1 if the cells were all safe or all mines */
+static int analysis_settle(Analysis_T *analysis, GameBoard_T *board, const uint32_t *cells, unsigned int len, int need,
+                           size_t *top) {
+  if (need != 0 && need != (int)len) {
+    return 0;
+  }
+  for (unsigned int ii = 0; ii < len; ii++) {
+    analysis_mark(analysis, board, cells[ii], need ? VIEW_MINE_BIT : VIEW_SAFE_BIT, top);
+  }
+  return 1;
+}
+
+/**
+ * Applies the subset rule between an open cell and the other open cells whose cells in doubt take in all of its own.
+ * Those all border its first cell in doubt, so only the open cells around that one are looked at.
+ */
+static void analysis_subsets(Analysis_T *analysis, GameBoard_T *board, unsigned int index, const Constraint_T *k,
+                             size_t *top) {
+  if (!k->len) {
+    return;
+  }
+  uint32_t neighbors[8];
+  unsigned int n = analysis_neighbors(board, k->cells[0], neighbors);
+  for (unsigned int nn = 0; nn < n; nn++) {
+    unsigned int other = neighbors[nn];
+    if (other == index || !(analysis->view[other] & VIEW_OPEN_BIT) || !(analysis->view[other] & VIEW_COUNT_BITS)) {
+      continue;
+    }
+    Constraint_T bigger;
+    analysis_constraint(analysis, board, other, &bigger);
+    if (bigger.len <= k->len) {
+      continue;
+    }
+
+    uint32_t rest[8];
+    unsigned int rest_len = 0, shared = 0;
+    for (unsigned int ii = 0; ii < bigger.len; ii++) {
+      int found = 0;
+      for (unsigned int jj = 0; jj < k->len && !found; jj++) {
+        found = bigger.cells[ii] == k->cells[jj];
+      }
+      if (found) {
+        shared++;
+      } else {
+        rest[rest_len++] = bigger.cells[ii];
+      }
+    }
+    if (shared == k->len) {
+      analysis_settle(analysis, board, rest, rest_len, bigger.need - k->need, top);
+    }
+  }
+}
+
+/* Finds the key of a component. Returns 0 if it spans too far for a key */
+static int analysis_component_key(Component_T *c, TopologyKind_T kind) {
+  uint8_t candidate[3 * COMPONENT_MAX_RECORDS];
+  uint16_t order[COMPONENT_MAX_RECORDS];
+  int row[COMPONENT_MAX_RECORDS], col[COMPONENT_MAX_RECORDS];
+  int found = 0;
+  for (int t = 0; t < 8; t++) {
+    int min_row = INT_MAX, min_col = INT_MAX;
+    for (unsigned int ii = 0; ii < c->len; ii++) {
+      int r = (t & 2) ? -c->row[ii] : c->row[ii], q = (t & 1) ? -c->col[ii] : c->col[ii];
+      row[ii] = (t & 4) ? q : r;
+      col[ii] = (t & 4) ? r : q;
+      min_row = (row[ii] < min_row) ? row[ii] : min_row;
+      min_col = (col[ii] < min_col) ? col[ii] : min_col;
+    }
+    /* Insertion sort, components are small */
+    for (unsigned int ii = 0; ii < c->len; ii++) {
+      row[ii] -= min_row;
+      col[ii] -= min_col;
+      if (row[ii] > UINT8_MAX || col[ii] > UINT8_MAX) {
+        return 0;
+      }
+      int pos = row[ii] * (UINT8_MAX + 1) + col[ii];
+      unsigned int jj = ii;
+      for (; jj > 0 && row[order[jj - 1]] * (UINT8_MAX + 1) + col[order[jj - 1]] > pos; jj--) {
+        order[jj] = order[jj - 1];
+      }
+      order[jj] = ii;
+    }
+    for (unsigned int k = 0; k < c->len; k++) {
+      candidate[3 * k] = row[order[k]];
+      candidate[3 * k + 1] = col[order[k]];
+      candidate[3 * k + 2] = c->tag[order[k]];
+    }
+    if (!found || memcmp(candidate, c->key, 3 * c->len) < 0) {
+      memcpy(c->key, candidate, 3 * c->len);
+      memcpy(c->order, order, c->len * sizeof(uint16_t));
+      found = 1;
+    }
+  }
+  c->key[3 * c->len] = kind;
+  return 1;
+}
+
+/* Lays out the tags of a component that is not cached in the order it was gathered, where solving looks for them */
+static void analysis_component_unkeyed(Component_T *c) {
+  for (unsigned int k = 0; k < c->len; k++) {
+    c->key[3 * k] = c->key[3 * k + 1] = 0;
+    c->key[3 * k + 2] = c->tag[k];
+    c->order[k] = k;
+  }
+}
+
+static void analysis_component_search(ComponentSearch_T *s, unsigned int cell) {
+  if (++s->steps > ANALYSIS_COMPONENT_MAX_STEPS) {
+    return;
+  }
+  if (cell == s->num_covered) {
+    s->layouts++;
+    for (unsigned int ii = 0; ii < s->num_covered; ii++) {
+      s->mine_layouts[ii] += s->mine[ii];
+    }
+    return;
+  }
+  for (int mine = 0; mine <= 1; mine++) {
+    int fits = 1;
+    s->mine[cell] = mine;
+    for (unsigned int ii = 0; ii < s->num_numbers[cell]; ii++) {
+      unsigned int n = s->numbers[cell][ii];
+      s->mines[n] += mine;
+      s->left[n]--;
+      fits &= s->mines[n] <= s->need[n] && s->mines[n] + s->left[n] >= s->need[n];
+    }
+    if (fits) {
+      analysis_component_search(s, cell + 1);
+    }
+    for (unsigned int ii = 0; ii < s->num_numbers[cell]; ii++) {
+      unsigned int n = s->numbers[cell][ii];
+      s->mines[n] -= mine;
+      s->left[n]++;
+    }
+  }
+}
+
+/**
+ * Counts the layouts of a component. Fills in the share of layouts with a mine on each covered cell, in key order.
+ * Where the topology translates, which cells are neighbors follows from the key, so the answer holds wherever the
+ * shape turns up. Returns 0 if the search ran too long.
+ */
+static int analysis_component_solve(const Topology_T *topo, const Component_T *c, float *share) {
+  ComponentSearch_T s;
+  unsigned int covered[ANALYSIS_COMPONENT_MAX_CELLS];
+  memset(&s, 0, sizeof(ComponentSearch_T));
+  for (unsigned int k = 0; k < c->len; k++) {
+    if (c->key[3 * k + 2] == COMPONENT_COVERED) {
+      covered[s.num_covered++] = k;
+    }
+  }
+  for (unsigned int k = 0; k < c->len; k++) {
+    if (c->key[3 * k + 2] == COMPONENT_COVERED) {
+      continue;
+    }
+    s.need[k] = c->key[3 * k + 2];
+    for (unsigned int ii = 0; ii < s.num_covered; ii++) {
+      if (topology_adjacent(topo, c->index[c->order[covered[ii]]], c->index[c->order[k]])) {
+        s.numbers[ii][s.num_numbers[ii]++] = k;
+        s.left[k]++;
+      }
+    }
+  }
+  analysis_component_search(&s, 0);
+  if (s.steps > ANALYSIS_COMPONENT_MAX_STEPS || !s.layouts) {
+    return 0;
+  }
+  for (unsigned int ii = 0; ii < s.num_covered; ii++) {
+    share[ii] = (float)s.mine_layouts[ii] / s.layouts;
+  }
+  return 1;
+}
+
+/* Adds a cell to the component being gathered, leaving out what does not fit once it is too big to solve */
+static void analysis_component_add(Component_T *c, GameBoard_T *board, unsigned int index, uint8_t tag) {
+  c->num_covered += tag == COMPONENT_COVERED;
+  if (c->len == COMPONENT_MAX_RECORDS) {
+    c->num_covered = ANALYSIS_COMPONENT_MAX_CELLS + 1;
+  }
+  if (c->num_covered > ANALYSIS_COMPONENT_MAX_CELLS) {
+    return;
+  }
+  c->index[c->len] = index;
+  c->row[c->len] = CELL_ROW(board, index);
+  c->col[c->len] = CELL_COL(board, index);
+  c->tag[c->len++] = tag;
+}
+
+/* Gathers the component around an open cell with neighbors in doubt, marking everything it reaches as seen */
+static void analysis_component_gather(Analysis_T *analysis, GameBoard_T *board, unsigned int start, Component_T *c) {
+  uint32_t *queue = analysis->component;
+  size_t head = 0, tail = 0;
+  c->len = c->num_covered = 0;
+  analysis->component_flags[start] |= COMPONENT_SEEN;
+  queue[tail++] = start;
+  while (head < tail) {
+    unsigned int index = queue[head++];
+    if (analysis->view[index] & VIEW_OPEN_BIT) {
+      Constraint_T k;
+      analysis_constraint(analysis, board, index, &k);
+      analysis_component_add(c, board, index, k.need);
+      for (unsigned int ii = 0; ii < k.len; ii++) {
+        if (!(analysis->component_flags[k.cells[ii]] & COMPONENT_SEEN)) {
+          analysis->component_flags[k.cells[ii]] |= COMPONENT_SEEN;
+          queue[tail++] = k.cells[ii];
+        }
+      }
+      continue;
+    }
+    analysis_component_add(c, board, index, COMPONENT_COVERED);
+    uint32_t neighbors[8];
+    unsigned int n = analysis_neighbors(board, index, neighbors);
+    for (unsigned int ii = 0; ii < n; ii++) {
+      uint8_t v = analysis->view[neighbors[ii]];
+      if ((v & VIEW_OPEN_BIT) && !(v & VIEW_MINE_BIT) && (v & VIEW_COUNT_BITS) &&
+          !(analysis->component_flags[neighbors[ii]] & COMPONENT_SEEN)) {
+        analysis->component_flags[neighbors[ii]] |= COMPONENT_SEEN;
+        queue[tail++] = neighbors[ii];
+      }
+    }
+  }
+}
+
+/**
+ * Solves every small component in doubt, through the cache. Settles the cells a component forces and notes the mine
+ * share of the rest. Returns how many cells were settled, or -1 if the board changed first.
+ */
+static int analysis_components(Analysis_T *analysis, GameBoard_T *board, uint64_t generation, size_t *top) {
+  unsigned int cells = board->height * board->width, settled = 0;
+  Component_T c;
+  for (unsigned int index = 0; index < cells; index++) {
+    analysis->component_flags[index] &= ~COMPONENT_SEEN;
+  }
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t v = analysis->view[index];
+    if (!(v & VIEW_OPEN_BIT) || (v & VIEW_MINE_BIT) || !(v & VIEW_COUNT_BITS) ||
+        (analysis->component_flags[index] & COMPONENT_SEEN)) {
+      continue;
+    }
+    Constraint_T k;
+    analysis_constraint(analysis, board, index, &k);
+    if (!k.len) {
+      continue;
+    }
+    analysis_component_gather(analysis, board, index, &c);
+    if (c.num_covered > ANALYSIS_COMPONENT_MAX_CELLS) {
+      continue;
+    }
+
+    /* Only shapes whose neighbors follow from the key can be looked up */
+    float solved[ANALYSIS_COMPONENT_MAX_CELLS];
+    const float *share = NULL;
+    if (!topology_translates(board->topology.kind)) {
+      analysis_component_unkeyed(&c);
+      share = analysis_component_solve(&board->topology, &c, solved) ? solved : NULL;
+    } else if (analysis_component_key(&c, board->topology.kind)) {
+      size_t key_len = 3 * c.len + 1;
+      uint64_t hash = component_cache_hash(c.key, key_len);
+      share = component_cache_get(&analysis->cache, c.key, key_len, hash);
+      if (!share && analysis_component_solve(&board->topology, &c, solved)) {
+        float *stored = component_cache_put(&analysis->cache, c.key, key_len, hash, c.num_covered);
+        memcpy(stored, solved, c.num_covered * sizeof(float));
+        share = stored;
+      }
+    }
+    if (!share) {
+      continue;
+    }
+
+    for (unsigned int k = 0, covered = 0; k < c.len; k++) {
+      if (c.key[3 * k + 2] != COMPONENT_COVERED) {
+        continue;
+      }
+      unsigned int cell = c.index[c.order[k]];
+      float p = share[covered++];
+      if (p == 0 || p == 1) {
+        analysis_mark(analysis, board, cell, p ? VIEW_MINE_BIT : VIEW_SAFE_BIT, top);
+        settled++;
+      } else {
+        analysis->probability[cell] = p;
+        analysis->component_flags[cell] |= COMPONENT_EXACT;
+      }
+    }
+    if (analysis_cancelled(analysis, generation)) {
+      return -1;
+    }
+  }
+  return settled;
+}
+
+static int analysis_sat_cancelled(void *opaque) {
+  Analysis_T *analysis = (Analysis_T *)opaque;
+  return analysis_cancelled(analysis, analysis->sat_generation);
+}
+
+static void analysis_sat_reset(Analysis_T *analysis, unsigned int cells) {
+  sat_free(&analysis->sat);
+  sat_init(&analysis->sat);
+  analysis->sat.cancelled = analysis_sat_cancelled;
+  analysis->sat.opaque = analysis;
+  memset(analysis->sat_fact, 0, cells);
+  memset(analysis->sat_var, 0, cells * sizeof(uint32_t));
+  analysis->sat_cell_vars = 0;
+  analysis->sat_guard = SAT_TRUE;
+}
+
+static uint32_t analysis_sat_lit(Analysis_T *analysis, unsigned int index) {
+  if (!analysis->sat_var[index]) {
+    analysis->sat_var[index] = sat_new_var(&analysis->sat);
+    analysis->sat_cell_vars++;
+  }
+  return SAT_LIT(analysis->sat_var[index]);
+}
+
+/**
+ * Tells the solver about the cells opened since the last run. Returns 1 if a cell it was told about has since been
+ * covered again or shows another count (undo, a new game), so the solver holds facts that are gone, and -1 if a mine
+ * is open and there is nothing left to work out.
+ */
+static int analysis_sat_sync(Analysis_T *analysis, GameBoard_T *board) {
+  unsigned int cells = board->height * board->width;
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t v = analysis->view[index];
+    uint8_t fact = v & (VIEW_OPEN_BIT | VIEW_COUNT_BITS);
+    if ((v & VIEW_OPEN_BIT) && (v & VIEW_MINE_BIT)) {
+      return -1;
+    }
+    if (fact == analysis->sat_fact[index]) {
+      continue;
+    } else if (analysis->sat_fact[index]) {
+      return 1;
+    }
+    analysis->sat_fact[index] = fact;
+    if (analysis->sat_var[index]) {
+      uint32_t safe = SAT_NOT(SAT_LIT(analysis->sat_var[index]));
+      sat_add_clause(&analysis->sat, &safe, 1);
+    }
+    if (fact & VIEW_COUNT_BITS) {
+      uint32_t neighbors[8], lits[8];
+      unsigned int n = analysis_neighbors(board, index, neighbors), len = 0;
+      for (unsigned int ii = 0; ii < n; ii++) {
+        if (!(analysis->view[neighbors[ii]] & VIEW_OPEN_BIT)) {
+          lits[len++] = analysis_sat_lit(analysis, neighbors[ii]);
+        }
+      }
+      unsigned int need = fact & VIEW_COUNT_BITS;
+      sat_add_cardinality(&analysis->sat, lits, len, need, need, SAT_TRUE, NULL);
+    }
+  }
+  return 0;
+}
+
+static int analysis_frontier(Analysis_T *analysis, GameBoard_T *board, unsigned int index) {
+  uint32_t neighbors[8];
+  unsigned int n = analysis_neighbors(board, index, neighbors);
+  for (unsigned int ii = 0; ii < n; ii++) {
+    if ((analysis->view[neighbors[ii]] & VIEW_OPEN_BIT) && (analysis->view[neighbors[ii]] & VIEW_COUNT_BITS)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Returns 1 if the solver's model respects the mine total, noting what it allows in the interior */
+static int analysis_sat_witness(Analysis_T *analysis, SatQuery_T *q) {
+  unsigned int mines = 0;
+  for (unsigned int ii = 0; ii < q->num_frontier; ii++) {
+    mines += sat_model_true(&analysis->sat, q->lits[ii]);
+  }
+  if (mines < q->lo || mines > q->hi) {
+    return 0;
+  }
+  q->interior_mine |= mines < q->bombs;
+  q->interior_safe |= mines + q->interior > q->bombs;
+  return 1;
+}
+
+/**
+ * Asks, for each frontier cell still open to question, whether it can take the other value than in a first model.
+ * A cell is settled once the answer is no, and left alone once models that respect the mine total have shown it both
+ * ways. Every model found unsettles all the cells it disagrees on, so most cells need no question of their own.
+ */
+static SatResult_T analysis_sat_pass(Analysis_T *analysis, SatQuery_T *q, uint32_t guard) {
+  SatSolver_T *sat = &analysis->sat;
+  SatResult_T answer = sat_solve(sat, &guard, 1);
+  if (answer != SAT_SATISFIABLE || !analysis_sat_witness(analysis, q)) {
+    return answer;
+  }
+  for (unsigned int ii = 0; ii < q->num_frontier; ii++) {
+    q->flags[ii] = (q->flags[ii] & ANALYSIS_SAT_DONE) | (sat_model_true(sat, q->lits[ii]) ? ANALYSIS_SAT_MINE : 0);
+  }
+
+  for (unsigned int ii = 0; ii < q->num_frontier; ii++) {
+    if (q->flags[ii] & ANALYSIS_SAT_DONE) {
+      continue;
+    }
+    int mine = q->flags[ii] & ANALYSIS_SAT_MINE;
+    uint32_t assumptions[2] = {guard, mine ? SAT_NOT(q->lits[ii]) : q->lits[ii]};
+    answer = sat_solve(sat, assumptions, 2);
+    if (answer == SAT_UNKNOWN) {
+      return answer;
+    } else if (answer == SAT_UNSATISFIABLE) {
+      uint32_t settled = SAT_NOT(assumptions[1]);
+      sat_add_clause(sat, &settled, 1);
+      analysis->view[q->frontier[ii]] |= mine ? VIEW_MINE_BIT : VIEW_SAFE_BIT;
+      q->flags[ii] |= ANALYSIS_SAT_DONE;
+    } else if (analysis_sat_witness(analysis, q)) {
+      for (unsigned int jj = ii; jj < q->num_frontier; jj++) {
+        if (sat_model_true(sat, q->lits[jj]) != (q->flags[jj] & ANALYSIS_SAT_MINE)) {
+          q->flags[jj] |= ANALYSIS_SAT_DONE;
+        }
+      }
+    }
+  }
+  return SAT_SATISFIABLE;
+}
+
+/**
+ * Settles what the local rules could not. A first pass weighs the numbers alone, which is usually all it takes, and
+ * only when that leaves cells that no model respecting the mine total has shown both ways does a second pass add the
+ * total over the frontier. The covered cells off the frontier are interchangeable and are settled together.
+ * Returns -1 if the board changed first.
+ */
+static int analysis_sat(Analysis_T *analysis, GameBoard_T *board, uint64_t generation) {
+  unsigned int cells = board->height * board->width;
+  if (!analysis->sat_var) {
+    return 0;
+  }
+  analysis->sat_generation = generation;
+  int stale = analysis_sat_sync(analysis, board);
+  if (stale < 0) {
+    return 0;
+  }
+  if (stale || analysis->sat.num_vars > ANALYSIS_SAT_SPARE_VARS + 2 * analysis->sat_cell_vars) {
+    analysis_sat_reset(analysis, cells);
+    analysis_sat_sync(analysis, board);
+  }
+
+  /* The work stack is empty once the local rules are done */
+  SatQuery_T q = {.frontier = analysis->work, .lits = analysis->sat_lits, .flags = analysis->sat_flags};
+  unsigned int unsettled = 0;
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t v = analysis->view[index];
+    if (v & VIEW_OPEN_BIT) {
+      continue;
+    } else if (analysis_frontier(analysis, board, index)) {
+      q.flags[q.num_frontier] = (v & VIEW_KNOWN_BITS) ? ANALYSIS_SAT_DONE : 0;
+      q.lits[q.num_frontier] = analysis_sat_lit(analysis, index);
+      q.frontier[q.num_frontier++] = index;
+      unsettled += !(v & VIEW_KNOWN_BITS);
+    } else {
+      q.interior++;
+    }
+  }
+  /* Deductions stay in the solver, so the total must belong to the same board as the view */
+  q.bombs = board->num_bombs;
+  if (analysis_cancelled(analysis, generation)) {
+    return -1;
+  }
+  q.lo = (q.bombs > q.interior) ? q.bombs - q.interior : 0;
+  q.hi = (q.bombs < q.num_frontier) ? q.bombs : q.num_frontier;
+  if ((!unsettled && !q.interior) || q.num_frontier > ANALYSIS_SAT_MAX_FRONTIER || q.lo > q.hi) {
+    return 0;
+  }
+
+  /* The last run's total covered another frontier, switch it off for good */
+  SatSolver_T *sat = &analysis->sat;
+  if (analysis->sat_guard != SAT_TRUE) {
+    uint32_t retired = SAT_NOT(analysis->sat_guard);
+    sat_add_clause(sat, &retired, 1);
+    analysis->sat_guard = SAT_TRUE;
+  }
+  SatResult_T answer = analysis_sat_pass(analysis, &q, SAT_TRUE);
+  if (answer != SAT_SATISFIABLE) {
+    return (answer == SAT_UNKNOWN) ? -1 : 0;
+  }
+  int open = 0;
+  for (unsigned int ii = 0; ii < q.num_frontier; ii++) {
+    open |= !(q.flags[ii] & ANALYSIS_SAT_DONE);
+  }
+  if (!open && (!q.interior || (q.interior_mine && q.interior_safe))) {
+    return 0;
+  }
+
+  uint32_t guard = analysis->sat_guard = SAT_LIT(sat_new_var(sat));
+  uint32_t *at_least = q.lits + q.num_frontier;
+  sat_add_cardinality(sat, q.lits, q.num_frontier, q.lo, q.hi, guard, at_least);
+  answer = analysis_sat_pass(analysis, &q, guard);
+  if (answer != SAT_SATISFIABLE) {
+    return (answer == SAT_UNKNOWN) ? -1 : 0;
+  }
+
+  /* The interior can hold a mine unless the frontier must take all of them, and a safe cell unless it must take the
+   * fewest it can */
+  if (q.interior && !q.interior_mine) {
+    uint32_t assumptions[2] = {guard, SAT_NOT(at_least[q.bombs - q.lo])};
+    if ((answer = sat_solve(sat, assumptions, 2)) == SAT_UNKNOWN) {
+      return -1;
+    }
+    q.interior_mine = answer == SAT_SATISFIABLE;
+  }
+  if (q.interior && !q.interior_safe) {
+    uint32_t assumptions[2] = {guard, at_least[1]};
+    if ((answer = sat_solve(sat, assumptions, 2)) == SAT_UNKNOWN) {
+      return -1;
+    }
+    q.interior_safe = answer == SAT_SATISFIABLE;
+  }
+  for (unsigned int index = 0; q.interior && (!q.interior_mine || !q.interior_safe) && index < cells; index++) {
+    if (!(analysis->view[index] & VIEW_OPEN_BIT) && !analysis_frontier(analysis, board, index)) {
+      analysis->view[index] |= q.interior_mine ? VIEW_MINE_BIT : VIEW_SAFE_BIT;
+    }
+  }
+  return 0;
+}
+
+/* Trivial rules, then the subset rule, until nothing more can be worked out. Returns -1 if the board changed first */
+static int analysis_rules(Analysis_T *analysis, GameBoard_T *board, uint64_t generation, size_t *top) {
+  for (unsigned int steps = 1; *top; steps++) {
+    unsigned int index = analysis->work[--*top];
+    analysis->view[index] &= ~VIEW_QUEUED_BIT;
+    Constraint_T k;
+    analysis_constraint(analysis, board, index, &k);
+    /* A settled constraint leaves nothing for the subset rule to work with */
+    if (k.len && !analysis_settle(analysis, board, k.cells, k.len, k.need, top)) {
+      analysis_subsets(analysis, board, index, &k, top);
+    }
+    if (steps % ANALYSIS_CANCEL_STRIDE == 0 && analysis_cancelled(analysis, generation)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Returns NULL if the board changed before the analysis finished */
+static AnalysisResult_T *analysis_run(Analysis_T *analysis, uint64_t generation) {
+  GameBoard_T *board = analysis->board;
+  unsigned int cells = board->height * board->width;
+  size_t top = 0;
+
+  /* Copy what the player can see. An uncovered bomb is the one that just went off */
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t cell = __atomic_load_n(&CELL_KNOWN(board, index), __ATOMIC_RELAXED);
+    if (!(cell & CELL_UNCOVERED_BIT)) {
+      analysis->view[index] = 0;
+    } else if (cell & CELL_HASBOMB_BIT) {
+      analysis->view[index] = VIEW_OPEN_BIT | VIEW_MINE_BIT;
+    } else {
+      analysis->view[index] = VIEW_OPEN_BIT | (cell & CELL_NUMBOMBS_BITS);
+    }
+    if ((index + 1) % ANALYSIS_CANCEL_STRIDE == 0 && analysis_cancelled(analysis, generation)) {
+      return NULL;
+    }
+  }
+  if (analysis_cancelled(analysis, generation)) {
+    return NULL;
+  }
+
+  for (unsigned int index = 0; index < cells; index++) {
+    analysis_queue(analysis, index, &top);
+    analysis->probability[index] = -1;
+    analysis->component_flags[index] = 0;
+  }
+
+  /* The local rules, then the components they leave, until neither works out anything more */
+  int settled;
+  do {
+    if (analysis_rules(analysis, board, generation, &top) < 0 ||
+        (settled = analysis_components(analysis, board, generation, &top)) < 0) {
+      return NULL;
+    }
+  } while (settled);
+
+  if (analysis_sat(analysis, board, generation) < 0) {
+    return NULL;
+  }
+
+  /* A frontier cell outside a solved component is as risky as its most demanding constraint, the others share the
+   * mines left over */
+  unsigned int known_mines = 0, interior = 0;
+  float frontier_mines = 0;
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t v = analysis->view[index];
+    if (v & VIEW_MINE_BIT) {
+      known_mines++;
+    }
+    if (!(v & VIEW_COUNT_BITS)) {
+      continue;
+    }
+    Constraint_T k;
+    analysis_constraint(analysis, board, index, &k);
+    for (unsigned int ii = 0; ii < k.len; ii++) {
+      float p = (float)k.need / k.len;
+      if (!(analysis->component_flags[k.cells[ii]] & COMPONENT_EXACT) && p > analysis->probability[k.cells[ii]]) {
+        analysis->probability[k.cells[ii]] = p;
+      }
+    }
+  }
+
+  size_t num_safe = 0, num_mines = 0;
+  for (unsigned int index = 0; index < cells; index++) {
+    uint8_t v = analysis->view[index];
+    if (v & VIEW_OPEN_BIT) {
+      continue;
+    } else if (v & VIEW_SAFE_BIT) {
+      analysis->work[num_safe++] = index;
+    } else if (v & VIEW_MINE_BIT) {
+      analysis->work[cells - ++num_mines] = index;
+    } else if (analysis->probability[index] < 0) {
+      interior++;
+    } else {
+      frontier_mines += analysis->probability[index];
+    }
+  }
+  float interior_probability = interior ? ((float)board->num_bombs - known_mines - frontier_mines) / interior : 1;
+  interior_probability = (interior_probability < 0) ? 0 : (interior_probability > 1) ? 1 : interior_probability;
+
+  AnalysisResult_T *result =
+      (AnalysisResult_T *)mem_alloc(MEM_SOLVER, sizeof(AnalysisResult_T) + (num_safe + num_mines) * sizeof(uint32_t));
+  result->generation = generation;
+  result->safe = (uint32_t *)(result + 1);
+  result->num_safe = num_safe;
+  result->mines = result->safe + num_safe;
+  result->num_mines = num_mines;
+  memcpy(result->safe, analysis->work, num_safe * sizeof(uint32_t));
+  memcpy(result->mines, analysis->work + cells - num_mines, num_mines * sizeof(uint32_t));
+  result->guess = INVALID_INDEX;
+  result->guess_probability = 2;
+  for (unsigned int index = 0; index < cells; index++) {
+    if (analysis->view[index] & VIEW_KNOWN_BITS) {
+      continue;
+    }
+    float p = (analysis->probability[index] < 0) ? interior_probability : analysis->probability[index];
+    if (p < result->guess_probability) {
+      result->guess = index;
+      result->guess_probability = p;
+    }
+  }
+  return result;
+}
+
+/**
+ * Plays a board out from `first` with the same rules, opening every cell they find safe. Returns 1 if that uncovers
+ * every safe cell, so the board can be won without guessing. Reads the layout straight from the board, which the
+ * player need not have touched. `view` holds one entry per cell and `work` two.
+ */
+int analysis_solvable(GameBoard_T *board, unsigned int first, uint8_t *view, uint32_t *work) {
+  Analysis_T analysis = {.board = board, .solving = 1, .view = view, .work = work};
+  unsigned int cells = board->height * board->width, opened = 0;
+  size_t top = 0;
+  memset(view, 0, cells);
+  analysis_mark(&analysis, board, first, VIEW_SAFE_BIT, &top);
+
+  /* Safe cells come off the stack covered and are opened, open cells come off it to have their constraint applied */
+  while (top) {
+    unsigned int index = work[--top];
+    if (!(view[index] & VIEW_OPEN_BIT)) {
+      if (CELL_HASBOMB(board, index)) {
+        return 0;
+      }
+      unsigned int count = cell_mine_count(board, index);
+      view[index] = VIEW_OPEN_BIT | count;
+      opened++;
+      analysis_queue(&analysis, index, &top);
+      if (!count) {
+        uint32_t neighbors[8];
+        unsigned int n = analysis_neighbors(board, index, neighbors);
+        for (unsigned int ii = 0; ii < n; ii++) {
+          if (!(view[neighbors[ii]] & VIEW_KNOWN_BITS)) {
+            analysis_mark(&analysis, board, neighbors[ii], VIEW_SAFE_BIT, &top);
+          }
+        }
+      }
+      continue;
+    }
+    view[index] &= ~VIEW_QUEUED_BIT;
+    Constraint_T k;
+    analysis_constraint(&analysis, board, index, &k);
+    /* A settled constraint leaves nothing for the subset rule to work with */
+    if (k.len && !analysis_settle(&analysis, board, k.cells, k.len, k.need, &top)) {
+      analysis_subsets(&analysis, board, index, &k, &top);
+    }
+  }
+  return opened == cells - board->num_bombs;
+}
+
+static void *analysis_thread(void *opaque) {
+  Analysis_T *analysis = (Analysis_T *)opaque;
+  uint64_t done = UINT64_MAX;
+  while (!atomic_load(&analysis->stopping)) {
+    sem_wait(&analysis->wake);
+    uint64_t generation = atomic_load_explicit(&analysis->generation, memory_order_acquire);
+    if ((generation & 1) || generation == done) {
+      continue;
+    }
+    AnalysisResult_T *result = analysis_run(analysis, generation);
+    if (result) {
+      done = generation;
+      mem_free(atomic_exchange(&analysis->result, result));
+    }
+  }
+  return NULL;
+}
+
+void analysis_init(Analysis_T *analysis, GameBoard_T *board) {
+  unsigned int cells = board->height * board->width;
+  memset(analysis, 0, sizeof(Analysis_T));
+  analysis->board = board;
+  analysis->view = (uint8_t *)mem_alloc(MEM_SOLVER, cells);
+  analysis->probability = (float *)mem_alloc(MEM_SOLVER, cells * sizeof(float));
+  analysis->work = (uint32_t *)mem_alloc(MEM_SOLVER, cells * sizeof(uint32_t));
+  analysis->component = (uint32_t *)mem_alloc(MEM_SOLVER, cells * sizeof(uint32_t));
+  analysis->component_flags = (uint8_t *)mem_alloc(MEM_SOLVER, cells);
+  component_cache_init(&analysis->cache, ANALYSIS_CACHE_ENTRIES);
+  if (cells <= ANALYSIS_SAT_MAX_CELLS) {
+    analysis->sat_fact = (uint8_t *)mem_alloc(MEM_SOLVER, cells);
+    analysis->sat_var = (uint32_t *)mem_alloc(MEM_SOLVER, cells * sizeof(uint32_t));
+    /* Frontier literals followed by the counts of the mine total */
+    analysis->sat_lits = (uint32_t *)mem_alloc(MEM_SOLVER, (2 * cells + 2) * sizeof(uint32_t));
+    analysis->sat_flags = (uint8_t *)mem_alloc(MEM_SOLVER, cells);
+    analysis_sat_reset(analysis, cells);
+  }
+  sem_init(&analysis->wake, 0, 1);
+  analysis->running = !pthread_create(&analysis->thread, NULL, analysis_thread, analysis);
+}
+
+void analysis_begin_change(Analysis_T *analysis) {
+  atomic_fetch_add_explicit(&analysis->generation, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+void analysis_end_change(Analysis_T *analysis) {
+  atomic_fetch_add_explicit(&analysis->generation, 1, memory_order_release);
+  sem_post(&analysis->wake);
+}
+
+/* Called after the board was reset: what was worked out about the last layout no longer holds */
+void analysis_new_game(Analysis_T *analysis) {
+  analysis->game_generation = atomic_load(&analysis->generation);
+  mem_free(atomic_exchange(&analysis->result, NULL));
+}
+
+static unsigned int analysis_nearest(GameBoard_T *board, const uint32_t *cells, size_t len, unsigned int cursor,
+                                     uint8_t skip_bits) {
+  unsigned int best = INVALID_INDEX, best_distance = UINT_MAX;
+  int row = INDEX_ON_BOARD(board, cursor) ? (int)CELL_ROW(board, cursor) : 0;
+  int col = INDEX_ON_BOARD(board, cursor) ? (int)CELL_COL(board, cursor) : 0;
+  for (size_t ii = 0; ii < len; ii++) {
+    if (CELL_KNOWN(board, cells[ii]) & skip_bits) {
+      continue;
+    }
+    unsigned int dr = abs((int)CELL_ROW(board, cells[ii]) - row), dc = abs((int)CELL_COL(board, cells[ii]) - col);
+    unsigned int distance = (dr > dc) ? dr : dc;
+    if (distance < best_distance) {
+      best = cells[ii];
+      best_distance = distance;
+    }
+  }
+  return best;
+}
+
+/**
+ * Logic thread: picks a cell to look at from the latest finished analysis without waiting for a newer one. Prefers the
+ * nearest safe cell, then the nearest unflagged mine, then the safest guess.
+ * Returns INVALID_INDEX if there is no analysis of this game yet.
+ */
+unsigned int analysis_hint(Analysis_T *analysis, unsigned int cursor) {
+  GameBoard_T *board = analysis->board;
+  AnalysisResult_T *result = atomic_exchange(&analysis->result, NULL);
+  if (!result) {
+    return INVALID_INDEX;
+  }
+  if (result->generation < analysis->game_generation) {
+    mem_free(result);
+    return INVALID_INDEX;
+  }
+
+  unsigned int hint = analysis_nearest(board, result->safe, result->num_safe, cursor, CELL_UNCOVERED_BIT);
+  if (hint == INVALID_INDEX) {
+    hint = analysis_nearest(board, result->mines, result->num_mines, cursor, CELL_UNCOVERED_BIT | CELL_FLAGGED_BIT);
+  }
+  if (hint == INVALID_INDEX && result->guess != INVALID_INDEX && !CELL_UNCOVERED(board, result->guess)) {
+    hint = result->guess;
+  }
+
+  /* Hand it back unless the worker published a newer one meanwhile */
+  AnalysisResult_T *empty = NULL;
+  if (!atomic_compare_exchange_strong(&analysis->result, &empty, result)) {
+    mem_free(result);
+  }
+  return hint;
+}
+
+void analysis_report(Analysis_T *analysis, FILE *out) {
+  ComponentCache_T *cache = &analysis->cache;
+  unsigned long lookups = atomic_load_explicit(&cache->lookups, memory_order_relaxed);
+  unsigned long hits = atomic_load_explicit(&cache->hits, memory_order_relaxed);
+  fprintf(out, "analysis: component cache %lu lookups, %lu hits (%.1f%%), %lu evictions\n", lookups, hits,
+          lookups ? 100.0 * hits / lookups : 0.0, atomic_load_explicit(&cache->evictions, memory_order_relaxed));
+}
+
+void analysis_exit(Analysis_T *analysis) {
+  if (!analysis->board) {
+    return;
+  }
+  if (analysis->running) {
+    atomic_store(&analysis->stopping, 1);
+    sem_post(&analysis->wake);
+    pthread_join(analysis->thread, NULL);
+  }
+  sem_destroy(&analysis->wake);
+  mem_free(atomic_exchange(&analysis->result, NULL));
+  mem_free(analysis->view);
+  mem_free(analysis->probability);
+  mem_free(analysis->work);
+  sat_free(&analysis->sat);
+  mem_free(analysis->sat_fact);
+  mem_free(analysis->sat_var);
+  mem_free(analysis->sat_lits);
+  mem_free(analysis->sat_flags);
+  mem_free(analysis->component);
+  mem_free(analysis->component_flags);
+  component_cache_exit(&analysis->cache);
+  memset(analysis, 0, sizeof(Analysis_T));
+}
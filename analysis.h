@@ -0,0 +1,122 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "component_cache.h"
+#include "sat.h"
+
+/**
+ * Background board analysis.
+ *
+ * A worker thread works out which covered cells are safe, which are mines and which guess is least risky, using only
+ * what the player can see. The logic thread brackets every board change with analysis_begin_change() and
+ * analysis_end_change(), which makes the generation counter odd while cells are being written. The worker only
+ * starts from an even generation and throws its work away as soon as the counter moves, so a stale analysis is
+ * abandoned within a few thousand cells and restarted on the newer board.
+ *
+ * Finished results are published by swapping a pointer. The hint key takes the latest one without waiting, and since
+ * deductions about a layout stay true for the rest of the game, a result that is a move or two old still gives good
+ * hints while the next one is being worked out.
+ *
+ * Positions the local rules leave stuck go to a SAT solver that weighs every number on the frontier together with the
+ * total mine count. It lives as long as the game: numbers are added once as they open, clauses it learns carry over
+ * from move to move, and a run asks its questions as assumptions. The total is only added, for the current frontier
+ * and behind a fresh activation literal, when the numbers alone leave a cell in doubt.
+ *
+ * Before that, the cells the local rules leave in doubt are split into components that share no number, and small
+ * components are solved outright by enumerating their mine layouts, which settles what they force and gives each cell
+ * the share of layouts that put a mine on it. Solutions are cached under the component's shape, so a run only pays
+ * for the components the last move changed. On torus and hex boards the shape alone does not tell which cells are
+ * neighbors, and components are solved every run.
+ */
+struct GameBoard;
+
+/* Work is checked for cancellation every this many cells */
+#define ANALYSIS_CANCEL_STRIDE 4096
+/* The solver is only used on boards up to this many cells, and on frontiers up to this many */
+#define ANALYSIS_SAT_MAX_CELLS (1 << 16)
+#define ANALYSIS_SAT_MAX_FRONTIER 1024
+/* Counter variables of earlier runs allowed to pile up before the solver is rebuilt */
+#define ANALYSIS_SAT_SPARE_VARS 4096
+/* Components with more covered cells than this, or that take more search steps, are left to the SAT solver */
+#define ANALYSIS_COMPONENT_MAX_CELLS 20
+#define ANALYSIS_COMPONENT_MAX_STEPS (1 << 20)
+/* Solved components kept */
+#define ANALYSIS_CACHE_ENTRIES 4096
+
+typedef struct AnalysisResult {
+  uint64_t generation;
+  uint32_t *safe;
+  size_t num_safe;
+  uint32_t *mines;
+  size_t num_mines;
+  /* Covered cell least likely to hold a mine, INVALID_INDEX if nothing is covered */
+  unsigned int guess;
+  float guess_probability;
+} AnalysisResult_T;
+
+typedef struct Analysis {
+  struct GameBoard *board;
+  pthread_t thread;
+  int running;
+  sem_t wake;
+  atomic_int stopping;
+  /* Odd while the logic thread is changing cells */
+  _Atomic uint64_t generation;
+  /* Results older than this belong to a previous game */
+  uint64_t game_generation;
+  _Atomic(AnalysisResult_T *) result;
+
+  /* Set by analysis_solvable(): cells found safe are pushed to be opened */
+  int solving;
+
+  /* Worker-only scratch, one entry per cell */
+  uint8_t *view;
+  float *probability;
+  uint32_t *work;
+
+  /* Worker-only solver state, left NULL on boards too big for it. The open cells it was told about as their view,
+   * and the variable of each covered cell it has seen on the frontier, 0 for none */
+  SatSolver_T sat;
+  uint8_t *sat_fact;
+  uint32_t *sat_var;
+  uint32_t *sat_lits;
+  uint8_t *sat_flags;
+  unsigned int sat_cell_vars;
+  /* Activation literal of the last run's mine total, SAT_TRUE before the first */
+  uint32_t sat_guard;
+  uint64_t sat_generation;
+
+  /* Worker-only component search state, one entry per cell, and the solved components */
+  uint32_t *component;
+  uint8_t *component_flags;
+  ComponentCache_T cache;
+} Analysis_T;
+
+/* Analysis prototypes begin */
+
+void analysis_init(Analysis_T *analysis, struct GameBoard *board);
+
+void analysis_begin_change(Analysis_T *analysis);
+
+void analysis_end_change(Analysis_T *analysis);
+
+void analysis_new_game(Analysis_T *analysis);
+
+unsigned int analysis_hint(Analysis_T *analysis, unsigned int cursor);
+
+void analysis_report(Analysis_T *analysis, FILE *out);
+
+int analysis_solvable(struct GameBoard *board, unsigned int first, uint8_t *view, uint32_t *work);
+
+void analysis_exit(Analysis_T *analysis);
+
+/* Analysis prototypes end */
+
+#endif /* ANALYSIS_H */
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minesweeper.h"
+#include "perf.h"
+#include "snapshot.h"
+
+/**
+ * Headless engine benchmark.
+ *
+ * Each iteration generates a board, opens it from the center, then plays it out by uncovering every remaining
+ * safe cell in index order. Before the play-out, a snapshot of the opened board is forked and spread-out safe cells
+ * are uncovered on the fork one at a time, reverting after each, as a solver trying moves would. Generation, flood
+ * fill and these what-if moves are reported per phase with hardware counters when available. On eagerly counted
+ * boards generation includes counting every cell's neighbors, so running the same board stored as rows and as tiles
+ * (see layout.h) shows what the layout does to cache and TLB misses in both neighbor-heavy phases.
+ */
+#define BENCH_WHAT_IF_PROBES 64
+
+/* Uncovers every probe on a fork of the board, putting the fork back after each */
+static void bench_what_if(GameBoard_T *played) {
+  BoardSnapshot_T snap;
+  GameBoard_T fork;
+  GameBoard_T *board = &fork;
+  unsigned int cells = played->height * played->width;
+  if (board_snapshot(&snap, played) || board_fork(&snap, board)) {
+    board_snapshot_free(&snap);
+    return;
+  }
+  for (unsigned int probe = 0; probe < BENCH_WHAT_IF_PROBES; probe++) {
+    unsigned int index = (unsigned int)((uint64_t)cells * probe / BENCH_WHAT_IF_PROBES);
+    if (!CELL_UNCOVERED(board, index) && !CELL_HASBOMB(board, index)) {
+      uncover_cell_block(board, index);
+      board_fork_revert(&snap, board);
+    }
+  }
+  free_board(board);
+  board_snapshot_free(&snap);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4 || argc > 10) {
+    fprintf(stderr,
+            "Usage: %s <rows> <cols> <bombs> [iterations] [seed] [rand|banded] [square|torus|hex|knight]"
+            " [eager|lazy] [rows|tiles]\n",
+            argv[0]);
+    return 1;
+  }
+
+  unsigned int rows = strtoul(argv[1], NULL, 10);
+  unsigned int cols = strtoul(argv[2], NULL, 10);
+  unsigned int bombs = strtoul(argv[3], NULL, 10);
+  unsigned int iterations = (argc > 4) ? strtoul(argv[4], NULL, 10) : 1;
+  unsigned int seed = (argc > 5) ? strtoul(argv[5], NULL, 10) : 11;
+  BoardGenerator_T generator = (argc > 6 && !strcmp(argv[6], "banded")) ? BOARD_GENERATOR_BANDED : BOARD_GENERATOR_RAND;
+  TopologyKind_T topology = TOPOLOGY_SQUARE;
+  if (argc > 7 && topology_parse(argv[7], &topology)) {
+    fprintf(stderr, "Unknown topology %s\n", argv[7]);
+    return 1;
+  }
+  int lazy_counts = argc > 8 && !strcmp(argv[8], "lazy");
+  LayoutKind_T layout = LAYOUT_ROWS;
+  if (argc > 9 && layout_parse(argv[9], &layout)) {
+    fprintf(stderr, "Unknown layout %s\n", argv[9]);
+    return 1;
+  }
+  if (!rows || !cols || bombs + 9 > rows * cols) {
+    fprintf(stderr, "Board %ux%u cannot hold %u bombs\n", rows, cols, bombs);
+    return 1;
+  }
+
+  if (perf_open()) {
+    fprintf(stderr, "perf_event_open failed, reporting wall time only\n");
+  }
+
+  GameBoard_T game = {0};
+  GameBoard_T *board = &game;
+  board->topology.kind = topology;
+  board->layout.kind = layout;
+  unsigned long opened = 0;
+  for (unsigned int it = 0; it < iterations; it++) {
+    generate_board(board, rows, cols);
+    board->seed = seed + it;
+    board->generator = generator;
+    board->lazy_counts = lazy_counts;
+    board->curr_index = CELL_INDEX(board, rows / 2, cols / 2);
+
+    perf_begin(PERF_PHASE_GENERATE);
+    generate_bombs(board, bombs);
+    perf_end(PERF_PHASE_GENERATE);
+
+    perf_begin(PERF_PHASE_FLOOD_FILL);
+    uncover_cell_block(board, board->curr_index);
+    perf_end(PERF_PHASE_FLOOD_FILL);
+
+    perf_begin(PERF_PHASE_WHAT_IF);
+    bench_what_if(board);
+    perf_end(PERF_PHASE_WHAT_IF);
+
+    perf_begin(PERF_PHASE_FLOOD_FILL);
+    for (unsigned int index = 0; index < rows * cols; index++) {
+      if (!CELL_HASBOMB(board, index)) {
+        uncover_cell_block(board, index);
+      }
+    }
+    perf_end(PERF_PHASE_FLOOD_FILL);
+
+    opened += rows * cols - bombs - board->remaining_open_cells;
+    free_board(board);
+  }
+
+  printf("board %ux%u bombs=%u topology=%s counts=%s layout=%s iterations=%u cells_opened=%lu\n", rows, cols, bombs,
+         topology_name(topology), lazy_counts ? "lazy" : "eager", layout_name(layout), iterations, opened);
+  perf_report(stdout);
+  perf_close();
+  return 0;
+}
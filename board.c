@@ -0,0 +1,352 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "generator.h"
+#include "mem.h"
+#include "minesweeper.h"
+#include "perf.h"
+
+/* Makes room for extra more cells on the fill stack. Returns 1, leaving the stack as it was, if it cannot grow */
+static int flood_fill_reserve(FloodFill_T *fill, size_t extra) {
+  if (fill->len + extra <= fill->capacity) {
+    return 0;
+  }
+  size_t capacity = fill->capacity ? fill->capacity * 2 : 1024;
+  while (capacity < fill->len + extra) {
+    capacity *= 2;
+  }
+  uint32_t *stack = (uint32_t *)mem_realloc(MEM_BOARD, fill->stack, capacity * sizeof(uint32_t));
+  if (!stack) {
+    return 1;
+  }
+  fill->stack = stack;
+  fill->capacity = capacity;
+  return 0;
+}
+
+/**
+ * Uncovers a covered cell, found at cell, and reports it. Zeros go on the fill stack to have their neighbors
+ * uncovered, so the caller makes room for one first
+ */
+static void flood_fill_uncover(GameBoard_T *board, unsigned int index, uint8_t *cell) {
+  FloodFill_T *fill = &board->fill;
+  if (!(*cell & CELL_COUNTED_BIT)) {
+    cell_settle_count(board, index);
+  }
+  *cell |= CELL_UNCOVERED_BIT;
+  board->remaining_open_cells--;
+  CELL_CHANGED(board, index);
+  if (*cell & (CELL_NUMBOMBS_BITS | CELL_HASBOMB_BIT)) {
+    return;
+  }
+  fill->stack[fill->len++] = index;
+}
+
+#define FLOOD_FILL_NEIGHBOR(board, n)                                                                                  \
+  if ((n) != INVALID_INDEX) {                                                                                          \
+    uint8_t *_cell = &CELL_KNOWN(board, n);                                                                            \
+    if (!(*_cell & CELL_UNCOVERED_BIT)) {                                                                              \
+      flood_fill_uncover(board, n, _cell);                                                                             \
+    }                                                                                                                  \
+  }
+
+/* On a board stored as rows a cell's index is its offset */
+#define FLOOD_FILL_ROW_NEIGHBOR(board, n)                                                                              \
+  if ((n) != INVALID_INDEX && !(board->board[n] & CELL_UNCOVERED_BIT)) {                                               \
+    flood_fill_uncover(board, n, board->board + (n));                                                                  \
+  }
+
+static int flood_fill_out_of_time(const struct timespec *start, uint64_t budget_ns) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000 + now.tv_nsec - start->tv_nsec >= budget_ns;
+}
+
+/**
+ * Works through the fill stack until it is empty or budget_ns has gone by. Returns 1 if there is work left, or -1 if
+ * the stack could not grow, in which case the work left stays on it for a later call. Flagged cells in the way are
+ * uncovered like any other. Each layout has its own loop, so boards stored as rows never look for tiles.
+ */
+int flood_fill_run(GameBoard_T *board, uint64_t budget_ns) {
+  FloodFill_T *fill = &board->fill;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!board->layout.tile_rank) {
+    for (unsigned int cells = 1; fill->len; cells++) {
+      /* A cell's neighbors take its place on the stack, so room is made before it is taken off */
+      if (flood_fill_reserve(fill, TOPOLOGY_MAX_NEIGHBORS - 1)) {
+        return -1;
+      }
+      unsigned int index = fill->stack[--fill->len];
+      SURROUNDING_CELL_ACTION(board, index, FLOOD_FILL_ROW_NEIGHBOR);
+      if (cells % FLOOD_FILL_CLOCK_STRIDE == 0 && flood_fill_out_of_time(&start, budget_ns)) {
+        break;
+      }
+    }
+    return fill->len != 0;
+  }
+
+  for (unsigned int cells = 1; fill->len; cells++) {
+    if (flood_fill_reserve(fill, TOPOLOGY_MAX_NEIGHBORS - 1)) {
+      return -1;
+    }
+    unsigned int index = fill->stack[--fill->len];
+    size_t at = cell_inner_offset(board, index);
+    if (at != SIZE_MAX) {
+      /* Inside a tile the neighbors are checked at fixed steps, without finding each one's tile */
+      uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+      topology_neighbors(&board->topology, index, neighbors);
+      for (unsigned int n = 0; n < TOPOLOGY_MAX_NEIGHBORS; n++) {
+        uint8_t *cell = board->board + at + TILE_SQUARE_STEPS[n];
+        if (!(*cell & CELL_UNCOVERED_BIT)) {
+          flood_fill_uncover(board, neighbors[n], cell);
+        }
+      }
+    } else {
+      SURROUNDING_CELL_ACTION(board, index, FLOOD_FILL_NEIGHBOR);
+    }
+    if (cells % FLOOD_FILL_CLOCK_STRIDE == 0 && flood_fill_out_of_time(&start, budget_ns)) {
+      break;
+    }
+  }
+  return fill->len != 0;
+}
+
+/**
+ * Uncovers a cell, and the whole opening around it if it is a zero unless the fill is sliced. Returns 1 if the fill
+ * stack could not grow, leaving the cell covered or the rest of its opening on the stack
+ */
+int uncover_cell_block(GameBoard_T *board, unsigned int index) {
+  uint8_t *cell = &CELL_KNOWN(board, index);
+  if (*cell & CELL_UNCOVERED_BIT) {
+    return 0;
+  }
+  if (flood_fill_reserve(&board->fill, 1)) {
+    return 1;
+  }
+  flood_fill_uncover(board, index, cell);
+  if (!board->fill.sliced) {
+    return flood_fill_run(board, UINT64_MAX) < 0;
+  }
+  return 0;
+}
+
+GameState_T update_game_condition(GameBoard_T *board, unsigned int index) {
+  if (board->game_state == QUIT) {
+    return QUIT;
+  } else if (CELL_UNCOVERED(board, index) && CELL_HASBOMB(board, index)) {
+    return EXPLODE;
+  } else if (board->remaining_open_cells == 0 && !board->is_first_turn) {
+    return WIN;
+  } else {
+    return TURNS;
+  }
+}
+
+void generate_board(GameBoard_T *board, unsigned int rows, unsigned int columns) {
+  layout_init(&board->layout, board->layout.kind, rows, columns);
+  board->board = (uint8_t *)mem_alloc(MEM_BOARD, layout_bytes(&board->layout));
+  reset_board(board, rows, columns);
+}
+
+/**
+ * Starts a new game in the cells board->board already points at, which must hold layout_bytes() for the new size.
+ * The board keeps its layout and topology, whose tables are only rebuilt when the size changes.
+ */
+void reset_board(GameBoard_T *board, unsigned int rows, unsigned int columns) {
+  /* Board data */
+  layout_init(&board->layout, board->layout.kind, rows, columns);
+  layout_align(&board->layout, board->board);
+  memset(board->board, DEFAULT_CELL, layout_bytes(&board->layout));
+  board->height = rows;
+  board->width = columns;
+  topology_init(&board->topology, board->topology.kind, rows, columns);
+  board->num_bombs = 0;
+  board->num_flags = 0;
+  board->remaining_open_cells = 0;
+
+  /* User data */
+  board->curr_index = 0;
+
+  /* State data */
+  board->game_state = BOARD_GENERATION;
+  board->seconds_elapsed = 0;
+  board->timeout = 1000; /* 1000 ms */
+  board->is_first_turn = 1;
+  board->refresh_board_print = 0;
+}
+
+void free_board(GameBoard_T *board) {
+  if (board->mapping) {
+    munmap(board->mapping, board->mapping_len);
+  } else {
+    mem_free(board->board);
+  }
+  mem_free(board->fill.stack);
+  memset(&board->fill, 0, sizeof(FloodFill_T));
+  layout_exit(&board->layout);
+  topology_exit(&board->topology);
+  board->board = NULL;
+  board->mapping = NULL;
+  board->mapping_len = 0;
+}
+
+/* Sets the number of bombs around every cell. Boards stored as rows get a loop of their own, indexing cells directly */
+void count_bombs(GameBoard_T *board) {
+  unsigned int cells = board->height * board->width;
+  if (!board->layout.tile_rank) {
+    for (unsigned int index = 0; index < cells; index++) {
+      uint8_t *cell = board->board + index;
+      uint8_t count = surrounding_cells_in_rows(board, index, CELL_HASBOMB_BIT);
+      *cell = (*cell & ~CELL_NUMBOMBS_BITS) | CELL_COUNTED_BIT | count;
+    }
+    return;
+  }
+  for (unsigned int index = 0; index < cells; index++) {
+    CELL_SET_NUMBOMBS(board, index, surrounding_cells_in_tiles(board, index, CELL_HASBOMB_BIT));
+  }
+}
+
+int generate_bombs(GameBoard_T *board, int bombs) {
+  // TODO: Should bomb generation be random or clustered?
+  board->game_state = BOMB_GENERATION;
+  if (board->generator == BOARD_GENERATOR_NONE) {
+    board->generator = BOARD_GENERATOR_RAND;
+  }
+  board->num_bombs = bombs;
+  if (board->generator == BOARD_GENERATOR_BANDED) {
+    generate_bombs_banded(board, 0);
+  } else {
+    srand(board->seed);
+    for (int b = 0; b < board->num_bombs; b++) {
+      int placement;
+      do {
+        placement = rand() % (board->width * board->height);
+      } while (!PLACE_BOMB_CONDITION(board, placement));
+      CELL_SET_HASBOMB(board, placement);
+    }
+
+    if (!board->lazy_counts) {
+      count_bombs(board);
+    }
+  }
+
+  /* The banded generator places fewer mines when they do not all fit */
+  board->num_flags = board->num_bombs;
+  board->remaining_open_cells = (board->width * board->height) - board->num_bombs;
+  return 0;
+}
+
+static void flag_cell(GameBoard_T *board, unsigned int index) {
+  if (board->num_flags == 0 || CELL_UNCOVERED(board, index)) {
+    return;
+  }
+  if (!CELL_FLAGGED(board, index)) {
+    CELL_SET_FLAGGED(board, index);
+    board->num_flags--;
+  } else {
+    CELL_CLEAR_FLAGGED(board, index);
+    board->num_flags++;
+  }
+  CELL_CHANGED(board, index);
+}
+
+/**
+ * Uncovers every covered, unflagged neighbor of a number whose flags are all placed. Returns a bomb it hit, if any.
+ * Sets *failed if an opening could not be revealed
+ */
+static unsigned int chord_cell(GameBoard_T *board, unsigned int index, int *failed) {
+  unsigned int exploded_index = INVALID_INDEX;
+  if (!CELL_UNCOVERED(board, index) || CELL_HASBOMB(board, index) || !CELL_NUMBOMBS(board, index) ||
+      surrounding_cells_with(board, index, CELL_FLAGGED_BIT) != CELL_NUMBOMBS(board, index)) {
+    return exploded_index;
+  }
+
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  unsigned int num_neighbors = topology_neighbors(&board->topology, index, neighbors);
+  for (unsigned int n = 0; n < num_neighbors; n++) {
+    unsigned int next_index = neighbors[n];
+    if (CELL_UNCOVERED(board, next_index) || CELL_FLAGGED(board, next_index)) {
+      continue;
+    }
+    *failed |= uncover_cell_block(board, next_index);
+    if (CELL_HASBOMB(board, next_index) && CELL_UNCOVERED(board, next_index)) {
+      exploded_index = next_index;
+    }
+  }
+  return exploded_index;
+}
+
+/**
+ * Applies ops in order, moving curr_index to each op's cell, then evaluates the game once for the whole batch into
+ * game_state. Stops early once a bomb is uncovered or the player exits. Ops off the board are ignored. Returns 1, after
+ * stopping at that op, if an opening could not be revealed for want of memory.
+ */
+int apply_cell_actions(GameBoard_T *board, const CellOp_T *ops, size_t count) {
+  unsigned int exploded_index = INVALID_INDEX;
+  int filling = 0, failed = 0;
+
+  for (size_t ii = 0; ii < count && exploded_index == INVALID_INDEX && board->game_state != QUIT && !failed; ii++) {
+    unsigned int index = ops[ii].index;
+    if (!INDEX_ON_BOARD(board, index)) {
+      continue;
+    }
+    board->curr_index = index;
+
+    switch (ops[ii].action) {
+    case UNCOVER:
+      // Bombs are placed around the first uncovered cell, so this has to
+      // happen before the explode check
+      if (board->is_first_turn) {
+        perf_begin(PERF_PHASE_GENERATE);
+        generate_bombs(board, board->num_bombs);
+        perf_end(PERF_PHASE_GENERATE);
+        board->is_first_turn = 0;
+      }
+      /* Fall through */
+    case CHORD:
+      /* One flood fill phase covers every uncover in the batch */
+      if (!filling) {
+        perf_begin(PERF_PHASE_FLOOD_FILL);
+        filling = 1;
+      }
+      if (ops[ii].action == CHORD) {
+        exploded_index = chord_cell(board, index, &failed);
+      } else {
+        failed = uncover_cell_block(board, index);
+        if (CELL_HASBOMB(board, index) && CELL_UNCOVERED(board, index)) {
+          exploded_index = index;
+        }
+      }
+      break;
+
+    case FLAG:
+      flag_cell(board, index);
+      break;
+
+    case EXIT:
+      board->game_state = QUIT;
+      break;
+
+    case MOVE:
+    case NONE:
+    default:
+      break;
+    }
+  }
+  if (filling) {
+    perf_end(PERF_PHASE_FLOOD_FILL);
+  }
+
+  board->game_state =
+      update_game_condition(board, (exploded_index != INVALID_INDEX) ? exploded_index : board->curr_index);
+  return failed;
+}
+
+int apply_cell_action(GameBoard_T *board, CellAction_T action) {
+  CellOp_T op = {.action = action, .index = board->curr_index};
+  return apply_cell_actions(board, &op, 1);
+}
@@ -0,0 +1,259 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bot.h"
+#include "bytes.h"
+#include "game_pool.h"
+#include "protocol.h"
+
+static const char *BotStateStr[] = {"init", "init", "init", "turns", "explode", "quit", "timeout", "win", "cleanup"};
+
+typedef struct BotCommand {
+  const char *name;
+  ProtoOpcode_T opcode;
+  ProtoOp_T op;
+  unsigned int min_args;
+  unsigned int max_args;
+} BotCommand_T;
+
+static const BotCommand_T BOT_COMMANDS[] = {
+    {"new", PROTO_NEW, PROTO_OP_MOVE, 3, 4},
+    {"uncover", PROTO_ACTIONS, PROTO_OP_UNCOVER, 1, 1},
+    {"flag", PROTO_ACTIONS, PROTO_OP_FLAG, 1, 1},
+    {"chord", PROTO_ACTIONS, PROTO_OP_CHORD, 1, 1},
+    {"state", PROTO_STATE, PROTO_OP_MOVE, 0, 0},
+};
+#define BOT_NUM_COMMANDS (sizeof(BOT_COMMANDS) / sizeof(BOT_COMMANDS[0]))
+#define BOT_MAX_WORDS 6
+
+/* The bot has no one to hand a failed reply to, so running out of memory ends it */
+static uint8_t *bot_reserve(ProtoBuf_T *buf, size_t len) {
+  uint8_t *p = proto_buf_reserve(buf, len);
+  if (!p) {
+    fprintf(stderr, "Out of memory, stopping\n");
+    exit(1);
+  }
+  return p;
+}
+
+static uint8_t *bot_frame(ProtoBuf_T *frames, uint8_t opcode, size_t body_len) {
+  uint8_t *p = bot_reserve(frames, PROTO_FRAME_HEADER + body_len);
+  put_u32(p, 1 + body_len);
+  p[4] = opcode;
+  return p + PROTO_FRAME_HEADER;
+}
+
+/* Returns 1 if word is not a whole number that fits in 32 bits */
+static int bot_parse_u32(const char *word, uint32_t *value) {
+  char *end;
+  errno = 0;
+  unsigned long long v = strtoull(word, &end, 10);
+  if (*word == '-' || *end || errno || v > UINT32_MAX) {
+    return 1;
+  }
+  *value = v;
+  return 0;
+}
+
+/**
+ * Turns one command line into a request frame. A line that is not a valid command becomes a frame the session
+ * rejects, so its error still comes back in order. Blank lines are skipped.
+ */
+static void bot_encode_line(char *line, ProtoBuf_T *frames) {
+  char *words[BOT_MAX_WORDS], *save = NULL;
+  unsigned int num_words = 0;
+  for (char *w = strtok_r(line, " \t\r", &save); w && num_words < BOT_MAX_WORDS; w = strtok_r(NULL, " \t\r", &save)) {
+    words[num_words++] = w;
+  }
+  if (!num_words) {
+    return;
+  }
+
+  const BotCommand_T *cmd = NULL;
+  for (unsigned int c = 0; c < BOT_NUM_COMMANDS; c++) {
+    if (!strcmp(words[0], BOT_COMMANDS[c].name)) {
+      cmd = &BOT_COMMANDS[c];
+    }
+  }
+  uint32_t args[BOT_MAX_WORDS - 1] = {0, 0, 0, DEFAULT_SEED};
+  unsigned int num_args = num_words - 1;
+  int valid = cmd && num_args >= cmd->min_args && num_args <= cmd->max_args;
+  for (unsigned int a = 0; valid && a < num_args; a++) {
+    valid = !bot_parse_u32(words[a + 1], &args[a]);
+  }
+  if (!valid) {
+    bot_frame(frames, 0, 0);
+    return;
+  }
+
+  uint8_t *body;
+  switch (cmd->opcode) {
+  case PROTO_NEW:
+    body = bot_frame(frames, PROTO_NEW, 16);
+    for (unsigned int a = 0; a < 4; a++) {
+      put_u32(body + 4 * a, args[a]);
+    }
+    break;
+
+  case PROTO_ACTIONS:
+    body = bot_frame(frames, PROTO_ACTIONS, PROTO_OP_SIZE);
+    body[0] = cmd->op;
+    put_u32(body + 1, args[0]);
+    break;
+
+  default:
+    bot_frame(frames, cmd->opcode, 0);
+    break;
+  }
+}
+
+static void bot_put_str(ProtoBuf_T *out, const char *s) {
+  size_t len = strlen(s);
+  memcpy(bot_reserve(out, len), s, len);
+}
+
+static void bot_put_uint(ProtoBuf_T *out, uint32_t v) {
+  char digits[10];
+  unsigned int len = 0;
+  do {
+    digits[len++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  uint8_t *p = bot_reserve(out, len);
+  while (len) {
+    *p++ = digits[--len];
+  }
+}
+
+static char bot_cell_char(uint8_t cell) {
+  if (cell & CELL_UNCOVERED_BIT) {
+    return (cell & CELL_HASBOMB_BIT) ? '*' : '0' + (cell & CELL_NUMBOMBS_BITS);
+  }
+  return (cell & CELL_FLAGGED_BIT) ? 'F' : '.';
+}
+
+/* Writes one binary reply frame out as a line */
+static void bot_put_reply(const uint8_t *frame, ProtoBuf_T *out) {
+  size_t body_len = get_u32(frame) - 1;
+  const uint8_t *body = frame + PROTO_FRAME_HEADER;
+  if (frame[4] != PROTO_DIFF) {
+    bot_put_str(out, "error ");
+    bot_put_uint(out, body_len ? body[0] : PROTO_ERR_BAD_REQUEST);
+    *bot_reserve(out, 1) = '\n';
+    return;
+  }
+
+  bot_put_str(out, (body[0] < sizeof(BotStateStr) / sizeof(BotStateStr[0])) ? BotStateStr[body[0]] : "unknown");
+  *bot_reserve(out, 1) = ' ';
+  bot_put_uint(out, get_u32(body + 1));
+  *bot_reserve(out, 1) = ' ';
+  bot_put_uint(out, get_u32(body + 5));
+  for (size_t pos = PROTO_DIFF_HEADER; pos + PROTO_DIFF_ENTRY <= body_len; pos += PROTO_DIFF_ENTRY) {
+    *bot_reserve(out, 1) = ' ';
+    bot_put_uint(out, get_u32(body + pos));
+    uint8_t *p = bot_reserve(out, 2);
+    p[0] = ':';
+    p[1] = bot_cell_char(body[pos + 4]);
+  }
+  *bot_reserve(out, 1) = '\n';
+}
+
+/**
+ * Answers every complete line in `in`, plus an unterminated last one once the input has ended. The lines are
+ * encoded into frames and handed to the session in one go, then its replies are written out as lines.
+ */
+static void bot_feed_lines(ProtoSession_T *session, ProtoBuf_T *in, int eof, ProtoBuf_T *frames, ProtoBuf_T *replies,
+                           ProtoBuf_T *out) {
+  if (eof && in->len && in->data[in->len - 1] != '\n') {
+    *bot_reserve(in, 1) = '\n';
+  }
+
+  size_t pos = 0;
+  uint8_t *end;
+  frames->len = 0;
+  while ((end = (uint8_t *)memchr(in->data + pos, '\n', in->len - pos))) {
+    *end = '\0';
+    bot_encode_line((char *)in->data + pos, frames);
+    pos = end - in->data + 1;
+  }
+  proto_buf_consume(in, pos);
+
+  replies->len = 0;
+  /* The frames are well formed, so only running out of memory fails them */
+  if (proto_session_feed(session, frames->data, frames->len, replies, SIZE_MAX) < 0) {
+    fprintf(stderr, "Out of memory, stopping\n");
+    exit(1);
+  }
+  for (size_t r = 0; r < replies->len; r += 4 + get_u32(replies->data + r)) {
+    bot_put_reply(replies->data + r, out);
+  }
+}
+
+/* Returns non-zero if the bot has stopped reading */
+static int bot_flush(ProtoBuf_T *out) {
+  size_t written = 0;
+  while (written < out->len) {
+    ssize_t n = write(STDOUT_FILENO, out->data + written, out->len - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 1;
+    }
+    written += n;
+  }
+  out->len = 0;
+  return 0;
+}
+
+/* Plays until stdin ends. Returns non-zero if binary input stopped being valid framing */
+int bot_run(BotFraming_T framing) {
+  GamePool_T *pool = game_pool_init();
+  if (!pool) {
+    fprintf(stderr, "Out of memory, stopping\n");
+    return 1;
+  }
+  ProtoSession_T session;
+  proto_session_init(&session, pool);
+  ProtoBuf_T in = {0}, frames = {0}, replies = {0}, out = {0};
+  signal(SIGPIPE, SIG_IGN);
+
+  int eof = 0, status = 0;
+  while (!eof && !status) {
+    uint8_t *p = bot_reserve(&in, BOT_READ_CHUNK);
+    ssize_t n = read(STDIN_FILENO, p, BOT_READ_CHUNK);
+    in.len -= BOT_READ_CHUNK - (n > 0 ? n : 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    eof = n <= 0;
+
+    if (framing == BOT_FRAMING_BINARY) {
+      ssize_t used = proto_session_feed(&session, in.data, in.len, &out, SIZE_MAX);
+      if (used < 0) {
+        fprintf(stderr, "Bad frame on stdin or out of memory, stopping\n");
+        status = 1;
+      } else {
+        proto_buf_consume(&in, used);
+      }
+    } else {
+      bot_feed_lines(&session, &in, eof, &frames, &replies, &out);
+    }
+    if (bot_flush(&out)) {
+      break;
+    }
+  }
+
+  proto_session_exit(&session);
+  game_pool_exit(pool);
+  proto_buf_free(&in);
+  proto_buf_free(&frames);
+  proto_buf_free(&replies);
+  proto_buf_free(&out);
+  return status;
+}
@@ -0,0 +1,34 @@
+#ifndef BOT_H
+#define BOT_H
+
+/**
+ * Bot mode: plays games over stdin and stdout, so a bot process can be piped straight into the engine.
+ *
+ * Binary framing is the protocol in protocol.h, unchanged. Line framing carries the same requests as one command per
+ * line, and answers each with one line:
+ *
+ *   new <rows> <cols> <bombs> [seed]    ->  <state> <remaining open cells> <flags left>
+ *   uncover|flag|chord <index>          ->  <state> <remaining open cells> <flags left> [<index>:<cell>]...
+ *   state                               ->  the same, listing every cell
+ *                                       or  error <code> (PROTO_ERR_*)
+ *
+ * where state is turns, explode or win, and a cell is its count once uncovered, * for an uncovered mine, F for a flag
+ * and . for a covered cell. Only the cells a command changed are listed, and one may be listed twice; the last wins.
+ *
+ * Input is read in chunks as large as the pipe holds. Every complete command in a chunk is answered before the replies
+ * are written back with one write, so a bot that pipelines its commands pays one system call per batch each way.
+ */
+#define BOT_READ_CHUNK (64 * 1024)
+
+typedef enum BotFraming {
+  BOT_FRAMING_LINE,
+  BOT_FRAMING_BINARY,
+} BotFraming_T;
+
+/* Bot prototypes begin */
+
+int bot_run(BotFraming_T framing);
+
+/* Bot prototypes end */
+
+#endif /* BOT_H */
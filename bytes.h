@@ -0,0 +1,58 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Little endian encoding helpers shared by the on-disk and wire formats */
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+  put_u16(p, v);
+  put_u16(p + 2, v >> 16);
+}
+
+static inline void put_u64(uint8_t *p, uint64_t v) {
+  put_u32(p, v);
+  put_u32(p + 4, v >> 32);
+}
+
+static inline uint16_t get_u16(const uint8_t *p) { return p[0] | (uint16_t)p[1] << 8; }
+
+static inline uint32_t get_u32(const uint8_t *p) { return get_u16(p) | (uint32_t)get_u16(p + 2) << 16; }
+
+static inline uint64_t get_u64(const uint8_t *p) { return get_u32(p) | (uint64_t)get_u32(p + 4) << 32; }
+
+/* LEB128 varint, at most 10 bytes. Returns the number of bytes written */
+static inline size_t put_varint(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+/* Returns the number of bytes read, 0 on a truncated or overlong varint */
+static inline size_t get_varint(const uint8_t *p, size_t len, uint64_t *out) {
+  uint64_t v = 0;
+  for (size_t n = 0; n < len && n < 10; n++) {
+    v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+    if (!(p[n] & 0x80)) {
+      *out = v;
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+#endif /* BYTES_H */
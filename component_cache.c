@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "component_cache.h"
+#include "mem.h"
+
+static float *component_entry_results(ComponentEntry_T *entry) { return (float *)(entry + 1); }
+
+static uint8_t *component_entry_key(ComponentEntry_T *entry) {
+  return (uint8_t *)(component_entry_results(entry) + entry->num_cells);
+}
+
+void component_cache_init(ComponentCache_T *cache, unsigned int capacity) {
+  memset(cache, 0, sizeof(ComponentCache_T));
+  cache->capacity = capacity;
+  /* Twice as many buckets as entries, rounded up to a power of two */
+  cache->num_buckets = 1;
+  while (cache->num_buckets < 2 * capacity) {
+    cache->num_buckets *= 2;
+  }
+  cache->buckets = (ComponentEntry_T **)mem_calloc(MEM_SOLVER, cache->num_buckets, sizeof(ComponentEntry_T *));
+}
+
+/* FNV-1a */
+uint64_t component_cache_hash(const uint8_t *key, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t ii = 0; ii < len; ii++) {
+    hash = (hash ^ key[ii]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static void component_lru_unlink(ComponentCache_T *cache, ComponentEntry_T *entry) {
+  if (entry->prev_lru) {
+    entry->prev_lru->next_lru = entry->next_lru;
+  } else {
+    cache->lru_head = entry->next_lru;
+  }
+  if (entry->next_lru) {
+    entry->next_lru->prev_lru = entry->prev_lru;
+  } else {
+    cache->lru_tail = entry->prev_lru;
+  }
+}
+
+static void component_lru_push(ComponentCache_T *cache, ComponentEntry_T *entry) {
+  entry->prev_lru = NULL;
+  entry->next_lru = cache->lru_head;
+  if (cache->lru_head) {
+    cache->lru_head->prev_lru = entry;
+  } else {
+    cache->lru_tail = entry;
+  }
+  cache->lru_head = entry;
+}
+
+/* Returns the results stored for a key, or NULL. A hit becomes the most recently used entry */
+const float *component_cache_get(ComponentCache_T *cache, const uint8_t *key, size_t len, uint64_t hash) {
+  atomic_fetch_add_explicit(&cache->lookups, 1, memory_order_relaxed);
+  ComponentEntry_T *entry = cache->buckets[hash & (cache->num_buckets - 1)];
+  while (entry && (entry->hash != hash || entry->key_len != len || memcmp(component_entry_key(entry), key, len))) {
+    entry = entry->next_hash;
+  }
+  if (!entry) {
+    return NULL;
+  }
+  atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+  component_lru_unlink(cache, entry);
+  component_lru_push(cache, entry);
+  return component_entry_results(entry);
+}
+
+static void component_cache_evict(ComponentCache_T *cache) {
+  ComponentEntry_T *victim = cache->lru_tail;
+  ComponentEntry_T **link = &cache->buckets[victim->hash & (cache->num_buckets - 1)];
+  while (*link != victim) {
+    link = &(*link)->next_hash;
+  }
+  *link = victim->next_hash;
+  component_lru_unlink(cache, victim);
+  mem_free(victim);
+  cache->len--;
+  atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+}
+
+/* Adds a key that is not in the cache yet. Returns room for its num_cells results, for the caller to fill in */
+float *component_cache_put(ComponentCache_T *cache, const uint8_t *key, size_t len, uint64_t hash,
+                           unsigned int num_cells) {
+  if (cache->len == cache->capacity) {
+    component_cache_evict(cache);
+  }
+  ComponentEntry_T *entry =
+      (ComponentEntry_T *)mem_alloc(MEM_SOLVER, sizeof(ComponentEntry_T) + num_cells * sizeof(float) + len);
+  entry->hash = hash;
+  entry->key_len = len;
+  entry->num_cells = num_cells;
+  memcpy(component_entry_key(entry), key, len);
+
+  ComponentEntry_T **bucket = &cache->buckets[hash & (cache->num_buckets - 1)];
+  entry->next_hash = *bucket;
+  *bucket = entry;
+  component_lru_push(cache, entry);
+  cache->len++;
+  return component_entry_results(entry);
+}
+
+void component_cache_exit(ComponentCache_T *cache) {
+  while (cache->lru_head) {
+    ComponentEntry_T *entry = cache->lru_head;
+    cache->lru_head = entry->next_lru;
+    mem_free(entry);
+  }
+  mem_free(cache->buckets);
+  memset(cache, 0, sizeof(ComponentCache_T));
+}
@@ -0,0 +1,57 @@
+#ifndef COMPONENT_CACHE_H
+#define COMPONENT_CACHE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Transposition cache for solved frontier components.
+ *
+ * Maps the canonical form of a component (see analysis.c) to the share of its solutions that put a mine on each of
+ * its covered cells, in canonical order. The same component turns up again on every run until a move touches it, and
+ * small patterns recur all over a board and from game to game, so entries are kept across runs and games. Entries
+ * are found by hash and compared in full, and once the cache is full the least recently used one makes way.
+ *
+ * Owned by the analysis worker. The counters may be read from any thread.
+ */
+typedef struct ComponentEntry {
+  struct ComponentEntry *next_hash;
+  struct ComponentEntry *prev_lru;
+  struct ComponentEntry *next_lru;
+  uint64_t hash;
+  uint32_t key_len;
+  uint32_t num_cells;
+  /* Followed by num_cells floats, then key_len key bytes */
+} ComponentEntry_T;
+
+typedef struct ComponentCache {
+  ComponentEntry_T **buckets;
+  unsigned int num_buckets;
+  unsigned int capacity;
+  unsigned int len;
+  /* Most recently used first */
+  ComponentEntry_T *lru_head;
+  ComponentEntry_T *lru_tail;
+
+  atomic_ulong lookups;
+  atomic_ulong hits;
+  atomic_ulong evictions;
+} ComponentCache_T;
+
+/* Component cache prototypes begin */
+
+void component_cache_init(ComponentCache_T *cache, unsigned int capacity);
+
+uint64_t component_cache_hash(const uint8_t *key, size_t len);
+
+const float *component_cache_get(ComponentCache_T *cache, const uint8_t *key, size_t len, uint64_t hash);
+
+float *component_cache_put(ComponentCache_T *cache, const uint8_t *key, size_t len, uint64_t hash,
+                           unsigned int num_cells);
+
+void component_cache_exit(ComponentCache_T *cache);
+
+/* Component cache prototypes end */
+
+#endif /* COMPONENT_CACHE_H */
@@ -0,0 +1,40 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+/**
+ * Board dataset format written by minesweeper-gen (little endian)
+ *
+ *   Header (DATASET_HEADER_SIZE bytes)
+ *     0: magic "MSDS"
+ *     4: u16 format version
+ *     6: u16 generator version (BoardGenerator_T)
+ *     8: u32 height
+ *    12: u32 width
+ *    16: u32 bombs
+ *    20: u32 first click, a cell index. It and its neighbors never hold a mine
+ *    24: u32 seed of the first board
+ *    28: u32 number of boards
+ *    32: u32 flags (DATASET_FLAG_*)
+ *    36: u32 record size in bytes
+ *
+ *   Records, one per board. Board n was generated from seed (first seed + n)
+ *     u32     metadata, only with DATASET_FLAG_METADATA: 3BV in bits 0-30, bit 31 set when the board can be won from
+ *             the first click without guessing
+ *     bytes   mine mask, (height * width + 7) / 8 bytes. Bit (i % 8) of byte (i / 8) is set when cell i holds a mine
+ *
+ * The generator, size, bomb count, first click and seed are everything the game needs to deal the same board, so
+ * a record can be played with `minesweeper --generator banded --seed <seed>`.
+ */
+#define DATASET_MAGIC "MSDS"
+#define DATASET_VERSION 1
+#define DATASET_HEADER_SIZE 40
+
+#define DATASET_FLAG_METADATA (1 << 0)
+#define DATASET_SOLVABLE_BIT (1u << 31)
+
+/* Boards are generated and written in chunks of about this many bytes */
+#define DATASET_CHUNK_BYTES (1 << 20)
+/* Chunks in flight per worker thread, which bounds memory use to about DATASET_CHUNK_BYTES * this * threads */
+#define DATASET_CHUNKS_PER_WORKER 2
+
+#endif /* DATASET_H */
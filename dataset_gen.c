@@ -0,0 +1,313 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "analysis.h"
+#include "bytes.h"
+#include "dataset.h"
+#include "generator.h"
+#include "minesweeper.h"
+
+/**
+ * Board dataset generator.
+ *
+ * Deals a run of consecutive seeds with the banded generator and streams them out in the format described in
+ * dataset.h. Worker threads claim chunks of boards in order and fill them into a fixed ring of chunk buffers; the main
+ * thread writes the chunks out in order, each with a single write, and hands each buffer back as soon as it is
+ * written. A worker that gets a whole ring ahead of the writer waits for its buffer, so memory stays bounded however
+ * slow the output is.
+ */
+typedef struct DatasetChunk {
+  uint8_t *data;
+  size_t len;
+  /* Chunk this buffer holds or is waiting for, and whether it is filled */
+  uint64_t number;
+  int ready;
+} DatasetChunk_T;
+
+typedef struct DatasetJob {
+  unsigned int rows;
+  unsigned int cols;
+  unsigned int bombs;
+  unsigned int first_index;
+  unsigned int first_seed;
+  unsigned int count;
+  int metadata;
+  size_t record_size;
+  unsigned int boards_per_chunk;
+  uint64_t num_chunks;
+
+  DatasetChunk_T *slots;
+  unsigned int num_slots;
+  _Atomic uint64_t next_chunk;
+  atomic_int stopping;
+  atomic_ulong solvable;
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+  pthread_cond_t drained;
+} DatasetJob_T;
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+  while (len) {
+    ssize_t n = write(fd, buf, len);
+    if (n <= 0) {
+      return 1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+#define DATASET_PUSH_NEIGHBOR(board, n)                                                                                \
+  if ((n) != INVALID_INDEX && !seen[n]) {                                                                              \
+    seen[n] = 1;                                                                                                       \
+    if (!CELL_NUMBOMBS(board, n)) {                                                                                    \
+      stack[top++] = (n);                                                                                              \
+    }                                                                                                                  \
+  }
+
+/* Clicks needed to clear the board without flags or chords: one per opening plus one per number no opening reveals */
+static unsigned int board_3bv(GameBoard_T *board, uint8_t *seen, uint32_t *stack) {
+  unsigned int cells = board->height * board->width, clicks = 0;
+  memset(seen, 0, cells);
+  for (unsigned int index = 0; index < cells; index++) {
+    if (seen[index] || CELL_HASBOMB(board, index) || CELL_NUMBOMBS(board, index)) {
+      continue;
+    }
+    size_t top = 0;
+    seen[index] = 1;
+    stack[top++] = index;
+    while (top) {
+      unsigned int zero = stack[--top];
+      SURROUNDING_CELL_ACTION(board, zero, DATASET_PUSH_NEIGHBOR);
+    }
+    clicks++;
+  }
+  for (unsigned int index = 0; index < cells; index++) {
+    clicks += !seen[index] && !CELL_HASBOMB(board, index);
+  }
+  return clicks;
+}
+
+static void dataset_fill(DatasetJob_T *job, GameBoard_T *board, uint8_t *view, uint32_t *work, uint64_t chunk,
+                         DatasetChunk_T *slot) {
+  unsigned int cells = job->rows * job->cols;
+  uint64_t first = chunk * job->boards_per_chunk;
+  uint64_t boards = (job->count - first < job->boards_per_chunk) ? job->count - first : job->boards_per_chunk;
+  unsigned long solvable = 0;
+  uint8_t *p = slot->data;
+  for (uint64_t b = 0; b < boards; b++) {
+    reset_board(board, job->rows, job->cols);
+    board->num_bombs = job->bombs;
+    board->seed = job->first_seed + (unsigned int)(first + b);
+    board->generator = BOARD_GENERATOR_BANDED;
+    board->curr_index = job->first_index;
+    generate_bombs_banded(board, 1);
+
+    if (job->metadata) {
+      uint32_t meta = board_3bv(board, view, work);
+      if (analysis_solvable(board, job->first_index, view, work)) {
+        meta |= DATASET_SOLVABLE_BIT;
+        solvable++;
+      }
+      put_u32(p, meta);
+      p += 4;
+    }
+    memset(p, 0, (cells + 7) / 8);
+    for (unsigned int index = 0; index < cells; index++) {
+      p[index / 8] |= (CELL_HASBOMB(board, index) != 0) << (index % 8);
+    }
+    p += (cells + 7) / 8;
+  }
+  slot->len = p - slot->data;
+  atomic_fetch_add(&job->solvable, solvable);
+}
+
+static void *dataset_worker(void *opaque) {
+  DatasetJob_T *job = (DatasetJob_T *)opaque;
+  unsigned int cells = job->rows * job->cols;
+  GameBoard_T *board = (GameBoard_T *)calloc(1, sizeof(GameBoard_T));
+  generate_board(board, job->rows, job->cols);
+  uint8_t *view = (uint8_t *)malloc(cells);
+  uint32_t *work = (uint32_t *)malloc(2 * (size_t)cells * sizeof(uint32_t));
+
+  uint64_t chunk;
+  while ((chunk = atomic_fetch_add(&job->next_chunk, 1)) < job->num_chunks) {
+    DatasetChunk_T *slot = &job->slots[chunk % job->num_slots];
+    pthread_mutex_lock(&job->lock);
+    while (slot->number != chunk && !atomic_load(&job->stopping)) {
+      pthread_cond_wait(&job->drained, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+    if (atomic_load(&job->stopping)) {
+      break;
+    }
+
+    dataset_fill(job, board, view, work, chunk, slot);
+    pthread_mutex_lock(&job->lock);
+    slot->ready = 1;
+    pthread_cond_broadcast(&job->filled);
+    pthread_mutex_unlock(&job->lock);
+  }
+
+  free(work);
+  free(view);
+  free_board(board);
+  free(board);
+  return NULL;
+}
+
+/* Writes the chunks out in order as workers fill them. Returns non-zero if the output failed */
+static int dataset_write(DatasetJob_T *job, int fd) {
+  for (uint64_t chunk = 0; chunk < job->num_chunks; chunk++) {
+    DatasetChunk_T *slot = &job->slots[chunk % job->num_slots];
+    pthread_mutex_lock(&job->lock);
+    while (!slot->ready) {
+      pthread_cond_wait(&job->filled, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    int err = write_all(fd, slot->data, slot->len);
+    pthread_mutex_lock(&job->lock);
+    slot->ready = 0;
+    slot->number = chunk + job->num_slots;
+    atomic_store(&job->stopping, err);
+    pthread_cond_broadcast(&job->drained);
+    pthread_mutex_unlock(&job->lock);
+    if (err) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [--threads <n>] [--metadata] [--output <file>] <rows> <cols> <bombs>[%%] <first seed> <count>\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  DatasetJob_T job = {0};
+  const char *output = NULL;
+  unsigned int threads = 0;
+  char *positional[5];
+  int num_positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--metadata")) {
+      job.metadata = 1;
+    } else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+      output = argv[++i];
+    } else if (num_positional < 5 && (argv[i][0] != '-' || !argv[i][1])) {
+      positional[num_positional++] = argv[i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (num_positional != 5) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /* A trailing % gives the bombs as a share of the cells */
+  char *end;
+  job.rows = strtoul(positional[0], NULL, 10);
+  job.cols = strtoul(positional[1], NULL, 10);
+  double bombs = strtod(positional[2], &end);
+  uint64_t cells = (uint64_t)job.rows * job.cols;
+  job.bombs = (*end == '%') ? (unsigned int)(bombs * cells / 100 + 0.5) : (unsigned int)bombs;
+  job.first_seed = strtoul(positional[3], NULL, 10);
+  job.count = strtoul(positional[4], NULL, 10);
+  if (!cells || cells > UINT32_MAX / 2 || bombs < 0 || job.bombs + 9 > cells) {
+    fprintf(stderr, "Board %ux%u cannot hold %u bombs\n", job.rows, job.cols, job.bombs);
+    return 1;
+  }
+  job.first_index = (job.rows / 2) * job.cols + job.cols / 2;
+
+  int fd = output ? open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+  if (fd < 0) {
+    fprintf(stderr, "Could not open %s\n", output);
+    return 1;
+  } else if (!output && isatty(fd)) {
+    fprintf(stderr, "Not writing a dataset to a terminal, use --output or a redirect\n");
+    return 1;
+  }
+
+  job.record_size = (job.metadata ? 4 : 0) + (cells + 7) / 8;
+  job.boards_per_chunk = (job.record_size < DATASET_CHUNK_BYTES) ? DATASET_CHUNK_BYTES / job.record_size : 1;
+  job.num_chunks = ((uint64_t)job.count + job.boards_per_chunk - 1) / job.boards_per_chunk;
+  if (!threads) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0) ? online : 1;
+  }
+  job.num_slots = threads * DATASET_CHUNKS_PER_WORKER;
+  job.slots = (DatasetChunk_T *)calloc(job.num_slots, sizeof(DatasetChunk_T));
+  for (unsigned int s = 0; s < job.num_slots; s++) {
+    job.slots[s].data = (uint8_t *)malloc(job.boards_per_chunk * job.record_size);
+    job.slots[s].number = s;
+  }
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.filled, NULL);
+  pthread_cond_init(&job.drained, NULL);
+
+  uint8_t header[DATASET_HEADER_SIZE] = {0};
+  memcpy(header, DATASET_MAGIC, 4);
+  put_u16(header + 4, DATASET_VERSION);
+  put_u16(header + 6, BOARD_GENERATOR_BANDED);
+  put_u32(header + 8, job.rows);
+  put_u32(header + 12, job.cols);
+  put_u32(header + 16, job.bombs);
+  put_u32(header + 20, job.first_index);
+  put_u32(header + 24, job.first_seed);
+  put_u32(header + 28, job.count);
+  put_u32(header + 32, job.metadata ? DATASET_FLAG_METADATA : 0);
+  put_u32(header + 36, job.record_size);
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int err = write_all(fd, header, sizeof(header));
+  pthread_t *workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  for (unsigned int t = 0; t < threads && !err; t++) {
+    pthread_create(&workers[t], NULL, dataset_worker, &job);
+  }
+  if (!err) {
+    err = dataset_write(&job, fd);
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_join(workers[t], NULL);
+    }
+  }
+  err |= output && close(fd);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  double secs = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  uint64_t bytes = DATASET_HEADER_SIZE + (uint64_t)job.count * job.record_size;
+  if (err) {
+    fprintf(stderr, "Could not write the dataset\n");
+  } else {
+    fprintf(stderr, "boards=%u %ux%u/%u threads=%u in %.3f s, %.0f boards/s, %.1f MB/s", job.count, job.rows,
+            job.cols, job.bombs, threads, secs, job.count / secs, bytes / secs / 1e6);
+    if (job.metadata) {
+      fprintf(stderr, ", %.1f%% solvable", job.count ? 100.0 * atomic_load(&job.solvable) / job.count : 0);
+    }
+    fprintf(stderr, "\n");
+  }
+
+  for (unsigned int s = 0; s < job.num_slots; s++) {
+    free(job.slots[s].data);
+  }
+  free(job.slots);
+  free(workers);
+  pthread_cond_destroy(&job.drained);
+  pthread_cond_destroy(&job.filled);
+  pthread_mutex_destroy(&job.lock);
+  return err;
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+
+#include "event_ring.h"
+#include "mem.h"
+
+EventRing_T *ev_ring_init(unsigned int capacity_log2) {
+  EventRing_T *ring = (EventRing_T *)mem_calloc(MEM_PANELS, 1, sizeof(EventRing_T));
+  ring->events = (CellEvent_T *)mem_calloc(MEM_PANELS, 1u << capacity_log2, sizeof(CellEvent_T));
+  ring->mask = (1u << capacity_log2) - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->overflowed, 0);
+  atomic_init(&ring->stopped, 0);
+  sem_init(&ring->ready, 0, 0);
+  return ring;
+}
+
+/* Producer side. Returns 1 if the event was dropped */
+int ev_ring_push(EventRing_T *ring, CellEventType_T type, uint32_t index, uint32_t value) {
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail > ring->mask) {
+    atomic_store_explicit(&ring->overflowed, 1, memory_order_release);
+    return 1;
+  }
+
+  CellEvent_T *ev = &ring->events[head & ring->mask];
+  ev->index = index;
+  ev->value = value;
+  ev->type = type;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  return 0;
+}
+
+/* Producer side. Wakes the consumer once for everything pushed since the last publish */
+void ev_ring_publish(EventRing_T *ring) { sem_post(&ring->ready); }
+
+/* Consumer side. Returns 0 when the ring is empty */
+int ev_ring_pop(EventRing_T *ring, CellEvent_T *ev) {
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+    return 0;
+  }
+  *ev = ring->events[tail & ring->mask];
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return 1;
+}
+
+/* Consumer side. Returns 1 (once) if events were dropped since the last call */
+int ev_ring_take_overflow(EventRing_T *ring) {
+  return atomic_exchange_explicit(&ring->overflowed, 0, memory_order_acq_rel);
+}
+
+/* Consumer side. Blocks until something was published, returns 0 once the ring is stopped */
+int ev_ring_wait(EventRing_T *ring) {
+  sem_wait(&ring->ready);
+  /* Coalesce publishes that arrived while the last batch was being presented */
+  while (!sem_trywait(&ring->ready)) {
+  }
+  return !atomic_load_explicit(&ring->stopped, memory_order_acquire);
+}
+
+void ev_ring_stop(EventRing_T *ring) {
+  atomic_store_explicit(&ring->stopped, 1, memory_order_release);
+  sem_post(&ring->ready);
+}
+
+/* Empties a stopped ring for reuse. Neither side may be running */
+void ev_ring_reset(EventRing_T *ring) {
+  atomic_store(&ring->head, 0);
+  atomic_store(&ring->tail, 0);
+  atomic_store(&ring->overflowed, 0);
+  atomic_store(&ring->stopped, 0);
+  while (!sem_trywait(&ring->ready)) {
+  }
+}
+
+void ev_ring_exit(EventRing_T *ring) {
+  sem_destroy(&ring->ready);
+  mem_free(ring->events);
+  mem_free(ring);
+}
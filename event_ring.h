@@ -0,0 +1,62 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Single-producer/single-consumer ring of board change events.
+ *
+ * The game-logic thread pushes events and publishes once per action; the render thread waits on the ring, drains
+ * it and presents the batch. Pushing never blocks: when the ring is full the event is dropped and the ring is marked
+ * overflowed, which tells the consumer to redraw everything from the board instead.
+ */
+typedef enum CellEventType {
+  EV_CELL,   /* index changed, value is the new cell byte */
+  EV_CURSOR, /* cursor moved to index */
+  EV_HEADER, /* index is num_flags, value is seconds_elapsed */
+  EV_REFRESH,
+} CellEventType_T;
+
+typedef struct CellEvent {
+  uint32_t index;
+  uint32_t value;
+  CellEventType_T type;
+} CellEvent_T;
+
+typedef struct EventRing {
+  CellEvent_T *events;
+  uint32_t mask;
+  /* Written by the producer only */
+  _Atomic uint64_t head;
+  /* Written by the consumer only */
+  _Atomic uint64_t tail;
+  atomic_int overflowed;
+  atomic_int stopped;
+  sem_t ready;
+} EventRing_T;
+
+/* Event ring prototypes begin */
+
+EventRing_T *ev_ring_init(unsigned int capacity_log2);
+
+int ev_ring_push(EventRing_T *ring, CellEventType_T type, uint32_t index, uint32_t value);
+
+void ev_ring_publish(EventRing_T *ring);
+
+int ev_ring_pop(EventRing_T *ring, CellEvent_T *ev);
+
+int ev_ring_take_overflow(EventRing_T *ring);
+
+int ev_ring_wait(EventRing_T *ring);
+
+void ev_ring_stop(EventRing_T *ring);
+
+void ev_ring_reset(EventRing_T *ring);
+
+void ev_ring_exit(EventRing_T *ring);
+
+/* Event ring prototypes end */
+
+#endif /* EVENT_RING_H */
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "game_pool.h"
+#include "mem.h"
+
+GamePool_T *game_pool_init(void) { return (GamePool_T *)mem_calloc(MEM_BOARD, 1, sizeof(GamePool_T)); }
+
+/* Returns 1, leaving the pool's chunks as they were, if there is no memory for another chunk */
+static int game_pool_grow(GamePool_T *pool) {
+  GameSlot_T **chunks =
+      (GameSlot_T **)mem_realloc(MEM_BOARD, pool->chunks, (pool->num_chunks + 1) * sizeof(GameSlot_T *));
+  if (!chunks) {
+    return 1;
+  }
+  pool->chunks = chunks;
+  GameSlot_T *chunk = (GameSlot_T *)mem_calloc(MEM_BOARD, GAME_POOL_CHUNK_SLOTS, sizeof(GameSlot_T));
+  if (!chunk) {
+    return 1;
+  }
+  pool->chunks[pool->num_chunks++] = chunk;
+
+  /* Thread the new slots onto the free list in address order */
+  for (int s = GAME_POOL_CHUNK_SLOTS - 1; s >= 0; s--) {
+    chunk[s].next_free = pool->free_list;
+    pool->free_list = &chunk[s];
+  }
+  return 0;
+}
+
+/* Returns NULL if there is no memory for the board. The slot it would have used then stays free, buffer and all */
+GameBoard_T *game_pool_acquire(GamePool_T *pool, unsigned int rows, unsigned int columns) {
+  if (!pool->free_list && game_pool_grow(pool)) {
+    return NULL;
+  }
+  GameSlot_T *slot = pool->free_list;
+  size_t cells = (size_t)rows * columns;
+  uint8_t *buffer = slot->board.board;
+  if (slot->capacity < cells) {
+    buffer = (uint8_t *)mem_alloc(MEM_BOARD, cells);
+    if (!buffer) {
+      return NULL;
+    }
+    mem_free(slot->board.board);
+    slot->capacity = cells;
+  }
+  pool->free_list = slot->next_free;
+  slot->next_free = NULL;
+  pool->live++;
+
+  FloodFill_T fill = {.stack = slot->board.fill.stack, .capacity = slot->board.fill.capacity};
+  Topology_T topology = slot->board.topology;
+  memset(&slot->board, 0, sizeof(GameBoard_T));
+  slot->board.board = buffer;
+  slot->board.fill = fill;
+  slot->board.topology = topology;
+  reset_board(&slot->board, rows, columns);
+  return &slot->board;
+}
+
+void game_pool_release(GamePool_T *pool, GameBoard_T *board) {
+  GameSlot_T *slot = (GameSlot_T *)board;
+  board->on_cell_change = NULL;
+  board->listener = NULL;
+  slot->next_free = pool->free_list;
+  pool->free_list = slot;
+  pool->live--;
+}
+
+void game_pool_exit(GamePool_T *pool) {
+  for (unsigned int c = 0; c < pool->num_chunks; c++) {
+    for (int s = 0; s < GAME_POOL_CHUNK_SLOTS; s++) {
+      mem_free(pool->chunks[c][s].board.board);
+      mem_free(pool->chunks[c][s].board.fill.stack);
+      topology_exit(&pool->chunks[c][s].board.topology);
+    }
+    mem_free(pool->chunks[c]);
+  }
+  mem_free(pool->chunks);
+  mem_free(pool);
+}
@@ -0,0 +1,43 @@
+#ifndef GAME_POOL_H
+#define GAME_POOL_H
+
+#include <stddef.h>
+
+#include "minesweeper.h"
+
+/**
+ * Arena of game boards for hosting many games in one process.
+ *
+ * Boards are carved out of fixed-size chunks, so a board never moves while it is in use, and released boards go on a
+ * free list. A released board keeps its cell buffer, flood fill stack and topology tables, which the next game on that
+ * slot reuses, so steady state play does no allocation at all.
+ */
+#define GAME_POOL_CHUNK_SLOTS 1024
+
+typedef struct GameSlot {
+  /* Must stay first, pool boards are handed out as &slot->board */
+  GameBoard_T board;
+  size_t capacity;
+  struct GameSlot *next_free;
+} GameSlot_T;
+
+typedef struct GamePool {
+  GameSlot_T **chunks;
+  unsigned int num_chunks;
+  GameSlot_T *free_list;
+  unsigned int live;
+} GamePool_T;
+
+/* Game pool prototypes begin */
+
+GamePool_T *game_pool_init(void);
+
+GameBoard_T *game_pool_acquire(GamePool_T *pool, unsigned int rows, unsigned int columns);
+
+void game_pool_release(GamePool_T *pool, GameBoard_T *board);
+
+void game_pool_exit(GamePool_T *pool);
+
+/* Game pool prototypes end */
+
+#endif /* GAME_POOL_H */
@@ -0,0 +1,302 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "generator.h"
+#include "mem.h"
+#include "minesweeper.h"
+
+typedef struct BandedGen {
+  GameBoard_T *board;
+  unsigned int bands;
+  /* Mines placed before band b, bands + 1 entries */
+  uint64_t *first_bomb;
+  /* Bomb bits of each band's top and bottom rows */
+  uint64_t *halo;
+  size_t halo_words;
+  /* Bomb bits of every cell by index, for boards that are not square. Bands start on a word, as
+   * GENERATOR_BAND_ROWS is a multiple of 64 */
+  uint64_t *bombs;
+  /* The first uncovered cell and its neighbors never get a mine */
+  unsigned int num_safe;
+  uint32_t safe[TOPOLOGY_MAX_NEIGHBORS + 1];
+
+  atomic_uint next_place;
+  atomic_uint next_count;
+  pthread_barrier_t barrier;
+} BandedGen_T;
+
+static unsigned int band_first_row(BandedGen_T *gen, unsigned int band) { return band * GENERATOR_BAND_ROWS; }
+
+static unsigned int band_end_row(BandedGen_T *gen, unsigned int band) {
+  unsigned int end = (band + 1) * GENERATOR_BAND_ROWS;
+  return (end < gen->board->height) ? end : gen->board->height;
+}
+
+/* Reserves the first uncovered cell and its neighbors in the board's topology, each once */
+static void reserve_safe_cells(BandedGen_T *gen) {
+  GameBoard_T *board = gen->board;
+  if (!INDEX_ON_BOARD(board, board->curr_index)) {
+    return;
+  }
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  unsigned int num_neighbors = topology_neighbors(&board->topology, board->curr_index, neighbors);
+  gen->safe[gen->num_safe++] = board->curr_index;
+  for (unsigned int n = 0; n < num_neighbors; n++) {
+    unsigned int seen = 0;
+    while (seen < gen->num_safe && gen->safe[seen] != neighbors[n]) {
+      seen++;
+    }
+    if (seen == gen->num_safe) {
+      gen->safe[gen->num_safe++] = neighbors[n];
+    }
+  }
+}
+
+static int is_safe(BandedGen_T *gen, uint64_t index) {
+  for (unsigned int ii = 0; ii < gen->num_safe; ii++) {
+    if (gen->safe[ii] == index) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static uint64_t band_available(BandedGen_T *gen, unsigned int band) {
+  uint64_t first = (uint64_t)band_first_row(gen, band) * gen->board->width;
+  uint64_t end = (uint64_t)band_end_row(gen, band) * gen->board->width;
+  uint64_t available = end - first;
+  for (unsigned int ii = 0; ii < gen->num_safe; ii++) {
+    available -= gen->safe[ii] >= first && gen->safe[ii] < end;
+  }
+  return available;
+}
+
+static void halo_store(BandedGen_T *gen, uint64_t *halo, unsigned int row) {
+  GameBoard_T *board = gen->board;
+  memset(halo, 0, gen->halo_words * sizeof(uint64_t));
+  for (unsigned int col = 0, len; col < board->width; col += len) {
+    const uint8_t *cells = board->board + layout_row_run(&board->layout, row, col, &len);
+    for (unsigned int k = 0; k < len; k++) {
+      halo[(col + k) / 64] |= (uint64_t)((cells[k] & CELL_HASBOMB_BIT) != 0) << ((col + k) % 64);
+    }
+  }
+}
+
+/* Copies a band's bomb bits into gen->bombs, whose words it shares with no other band */
+static void bombs_store(BandedGen_T *gen, unsigned int band) {
+  GameBoard_T *board = gen->board;
+  unsigned int r0 = band_first_row(gen, band), r1 = band_end_row(gen, band);
+  uint64_t at = (uint64_t)r0 * board->width;
+  memset(gen->bombs + at / 64, 0, GENERATOR_BAND_ROWS / 64 * board->width * sizeof(uint64_t));
+  for (unsigned int row = r0; row < r1; row++) {
+    for (unsigned int col = 0, len; col < board->width; col += len) {
+      const uint8_t *cells = board->board + layout_row_run(&board->layout, row, col, &len);
+      for (unsigned int k = 0; k < len; k++, at++) {
+        gen->bombs[at / 64] |= (uint64_t)((cells[k] & CELL_HASBOMB_BIT) != 0) << (at % 64);
+      }
+    }
+  }
+}
+
+static void place_band(BandedGen_T *gen, unsigned int band) {
+  GameBoard_T *board = gen->board;
+  unsigned int r0 = band_first_row(gen, band), r1 = band_end_row(gen, band);
+  unsigned int first = r0 * board->width;
+  uint64_t size = (uint64_t)(r1 - r0) * board->width;
+  uint64_t available = band_available(gen, band);
+  uint64_t bombs = gen->first_bomb[band + 1] - gen->first_bomb[band];
+  CtrRng_T rng = ctr_rng_stream(board->seed, band);
+
+  /* Dense bands are filled and then thinned out, so rejection never waits on a nearly full band */
+  if (bombs * 2 <= available) {
+    for (uint64_t placed = 0; placed < bombs;) {
+      uint64_t u = ctr_rng_below(&rng, size);
+      if (!CELL_HASBOMB(board, first + u) && !is_safe(gen, first + u)) {
+        CELL_SET_HASBOMB(board, first + u);
+        placed++;
+      }
+    }
+  } else {
+    for (uint64_t u = 0; u < size; u++) {
+      if (!is_safe(gen, first + u)) {
+        CELL_SET_HASBOMB(board, first + u);
+      }
+    }
+    for (uint64_t removed = 0; removed < available - bombs;) {
+      uint64_t u = ctr_rng_below(&rng, size);
+      if (CELL_HASBOMB(board, first + u)) {
+        CELL_CLEAR_HASBOMB(board, first + u);
+        removed++;
+      }
+    }
+  }
+
+  if (gen->bombs) {
+    bombs_store(gen, band);
+    return;
+  }
+  halo_store(gen, gen->halo + (size_t)band * 2 * gen->halo_words, r0);
+  halo_store(gen, gen->halo + ((size_t)band * 2 + 1) * gen->halo_words, r1 - 1);
+}
+
+/* Fills out[1..width] with the bomb bits of a row as seen from a band, with a zero column on either side */
+static void load_row(BandedGen_T *gen, unsigned int band, int row, uint8_t *out) {
+  GameBoard_T *board = gen->board;
+  unsigned int r0 = band_first_row(gen, band), r1 = band_end_row(gen, band);
+  memset(out, 0, board->width + 2);
+  if (row < 0 || row >= (int)board->height) {
+    return;
+  }
+  if ((unsigned int)row >= r0 && (unsigned int)row < r1) {
+    for (unsigned int col = 0, len; col < board->width; col += len) {
+      const uint8_t *cells = board->board + layout_row_run(&board->layout, row, col, &len);
+      for (unsigned int k = 0; k < len; k++) {
+        out[col + k + 1] = (cells[k] & CELL_HASBOMB_BIT) >> 4;
+      }
+    }
+    return;
+  }
+  /* The row above is the previous band's bottom halo, the row below the next band's top halo */
+  const uint64_t *halo = gen->halo + (((unsigned int)row < r0) ? (size_t)(band - 1) * 2 + 1 : (size_t)(band + 1) * 2) *
+                                         gen->halo_words;
+  for (unsigned int col = 0; col < board->width; col++) {
+    out[col + 1] = (halo[col / 64] >> (col % 64)) & 1;
+  }
+}
+
+static void count_band(BandedGen_T *gen, unsigned int band, uint8_t *rows) {
+  GameBoard_T *board = gen->board;
+  unsigned int width = board->width;
+  uint8_t *prev = rows, *cur = rows + (width + 2), *next = rows + 2 * (width + 2), *sums = rows + 3 * (width + 2);
+  int r0 = band_first_row(gen, band), r1 = band_end_row(gen, band);
+
+  load_row(gen, band, r0 - 1, prev);
+  load_row(gen, band, r0, cur);
+  for (int row = r0; row < r1; row++) {
+    load_row(gen, band, row + 1, next);
+    for (unsigned int col = 0; col < width + 2; col++) {
+      sums[col] = prev[col] + cur[col] + next[col];
+    }
+    for (unsigned int col = 0, len; col < width; col += len) {
+      uint8_t *cells = board->board + layout_row_run(&board->layout, row, col, &len);
+      for (unsigned int k = 0, c = col; k < len; k++, c++) {
+        uint8_t count = sums[c] + sums[c + 1] + sums[c + 2] - cur[c + 1];
+        cells[k] = (cells[k] & ~CELL_NUMBOMBS_BITS) | CELL_COUNTED_BIT | count;
+      }
+    }
+    uint8_t *recycled = prev;
+    prev = cur;
+    cur = next;
+    next = recycled;
+  }
+}
+
+/* Counts a band of a board that is not square through its topology, reading other bands only through gen->bombs */
+static void count_band_topology(BandedGen_T *gen, unsigned int band) {
+  GameBoard_T *board = gen->board;
+  unsigned int r0 = band_first_row(gen, band), r1 = band_end_row(gen, band);
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  for (unsigned int row = r0; row < r1; row++) {
+    for (unsigned int col = 0, len; col < board->width; col += len) {
+      uint8_t *cells = board->board + layout_row_run(&board->layout, row, col, &len);
+      for (unsigned int k = 0, index = row * board->width + col; k < len; k++, index++) {
+        unsigned int num_neighbors = topology_neighbors(&board->topology, index, neighbors), count = 0;
+        for (unsigned int n = 0; n < num_neighbors; n++) {
+          count += (gen->bombs[neighbors[n] / 64] >> (neighbors[n] % 64)) & 1;
+        }
+        cells[k] = (cells[k] & ~CELL_NUMBOMBS_BITS) | CELL_COUNTED_BIT | count;
+      }
+    }
+  }
+}
+
+static void *banded_worker(void *opaque) {
+  BandedGen_T *gen = (BandedGen_T *)opaque;
+  unsigned int band;
+  while ((band = atomic_fetch_add(&gen->next_place, 1)) < gen->bands) {
+    place_band(gen, band);
+  }
+  /* Every thread sees the same flag, so either all of them wait at the barrier or none do */
+  if (gen->board->lazy_counts) {
+    return NULL;
+  }
+  pthread_barrier_wait(&gen->barrier);
+
+  if (gen->bombs) {
+    while ((band = atomic_fetch_add(&gen->next_count, 1)) < gen->bands) {
+      count_band_topology(gen, band);
+    }
+    return NULL;
+  }
+  uint8_t *rows = (uint8_t *)mem_alloc(MEM_BOARD, 4 * (gen->board->width + 2));
+  while ((band = atomic_fetch_add(&gen->next_count, 1)) < gen->bands) {
+    count_band(gen, band, rows);
+  }
+  mem_free(rows);
+  return NULL;
+}
+
+/**
+ * Places board->num_bombs mines and, unless the board is lazily counted, sets every cell's count. Uses one thread per
+ * online CPU when threads is 0. Places no more mines than fit outside the first uncovered cell and its neighbors, and
+ * lowers board->num_bombs to match.
+ */
+void generate_bombs_banded(GameBoard_T *board, unsigned int threads) {
+  BandedGen_T gen = {.board = board};
+  gen.bands = (board->height + GENERATOR_BAND_ROWS - 1) / GENERATOR_BAND_ROWS;
+  if (!gen.bands || !board->width) {
+    return;
+  }
+  gen.halo_words = (board->width + 63) / 64;
+  reserve_safe_cells(&gen);
+
+  /* Split the mines by each band's share of the available cells, rounding so the shares add up exactly */
+  uint64_t total = 0;
+  for (unsigned int band = 0; band < gen.bands; band++) {
+    total += band_available(&gen, band);
+  }
+  uint64_t bombs = (board->num_bombs < total) ? board->num_bombs : total;
+  board->num_bombs = bombs;
+  gen.first_bomb = (uint64_t *)mem_alloc(MEM_BOARD, (gen.bands + 1) * sizeof(uint64_t));
+  uint64_t before = 0;
+  for (unsigned int band = 0; band <= gen.bands; band++) {
+    gen.first_bomb[band] = total ? (uint64_t)((unsigned __int128)bombs * before / total) : 0;
+    if (band < gen.bands) {
+      before += band_available(&gen, band);
+    }
+  }
+  if (board->topology.kind == TOPOLOGY_SQUARE) {
+    gen.halo = (uint64_t *)mem_alloc(MEM_BOARD, (size_t)gen.bands * 2 * gen.halo_words * sizeof(uint64_t));
+  } else {
+    gen.bombs = (uint64_t *)mem_alloc(MEM_BOARD,
+                                      (size_t)gen.bands * GENERATOR_BAND_ROWS / 64 * board->width * sizeof(uint64_t));
+  }
+
+  if (!threads) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0) ? online : 1;
+  }
+  threads = (threads < gen.bands) ? threads : gen.bands;
+  /* Without memory for the workers, the calling thread does every band itself */
+  pthread_t *workers = (pthread_t *)mem_alloc(MEM_BOARD, threads * sizeof(pthread_t));
+  if (!workers) {
+    threads = 1;
+  }
+  pthread_barrier_init(&gen.barrier, NULL, threads);
+  for (unsigned int t = 1; t < threads; t++) {
+    pthread_create(&workers[t], NULL, banded_worker, &gen);
+  }
+  banded_worker(&gen);
+  for (unsigned int t = 1; t < threads; t++) {
+    pthread_join(workers[t], NULL);
+  }
+
+  pthread_barrier_destroy(&gen.barrier);
+  mem_free(workers);
+  mem_free(gen.halo);
+  mem_free(gen.bombs);
+  mem_free(gen.first_bomb);
+}
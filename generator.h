@@ -0,0 +1,53 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+
+/**
+ * Banded parallel board generator (BOARD_GENERATOR_BANDED).
+ *
+ * The board is cut into bands of GENERATOR_BAND_ROWS rows. Each band gets its share of the mines in proportion to
+ * the cells it may hold them in, and places them with its own counter-based random stream, so a seed always gives the
+ * same board however many threads build it. Threads take bands from a shared counter in two passes. The first places
+ * mines and copies each band's top and bottom rows into bit-packed halo rows. The second computes counts, reading
+ * across band edges only through the halo rows, so no thread ever reads cells another thread is writing. Boards that
+ * are not square copy every row into a bitmap of the whole board instead, and count through its topology. Lazily
+ * counted boards stop after the first pass.
+ */
+struct GameBoard;
+
+#define GENERATOR_BAND_ROWS 64
+
+/* Counter-based random stream: value n of a stream is a pure function of its key and n */
+typedef struct CtrRng {
+  uint64_t key;
+  uint64_t counter;
+} CtrRng_T;
+
+static inline uint64_t ctr_rng_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline CtrRng_T ctr_rng_stream(uint64_t seed, uint64_t stream) {
+  CtrRng_T rng = {.key = ctr_rng_mix(ctr_rng_mix(seed) ^ (stream * 0x9e3779b97f4a7c15ull)), .counter = 0};
+  return rng;
+}
+
+static inline uint64_t ctr_rng_next(CtrRng_T *rng) {
+  return ctr_rng_mix(rng->key + ++rng->counter * 0x9e3779b97f4a7c15ull);
+}
+
+/* Uniform in [0, n) */
+static inline uint64_t ctr_rng_below(CtrRng_T *rng, uint64_t n) {
+  return (uint64_t)(((unsigned __int128)ctr_rng_next(rng) * n) >> 64);
+}
+
+/* Generator prototypes begin */
+
+void generate_bombs_banded(struct GameBoard *board, unsigned int threads);
+
+/* Generator prototypes end */
+
+#endif /* GENERATOR_H */
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "journal.h"
+#include "mem.h"
+#include "minesweeper.h"
+
+void journal_init(Journal_T *journal) { memset(journal, 0, sizeof(Journal_T)); }
+
+/* Forgets every action but keeps the memory for the next game */
+void journal_reset(Journal_T *journal) {
+  journal->len = 0;
+  journal->num_actions = 0;
+  journal->applied = 0;
+  journal->recording = 0;
+}
+
+/* Opens a new action. Anything that could still be redone is dropped */
+void journal_begin(Journal_T *journal, GameBoard_T *board) {
+  if (journal->applied < journal->num_actions) {
+    journal->len = journal->actions[journal->applied].first;
+    journal->num_actions = journal->applied;
+  }
+  if (journal->num_actions == journal->actions_capacity) {
+    journal->actions_capacity = journal->actions_capacity ? journal->actions_capacity * 2 : 64;
+    journal->actions = (JournalAction_T *)mem_realloc(MEM_JOURNAL, journal->actions,
+                                                      journal->actions_capacity * sizeof(JournalAction_T));
+  }
+
+  JournalAction_T *action = &journal->actions[journal->num_actions];
+  action->first = journal->len;
+  action->index = board->curr_index;
+  action->state_before = board->game_state;
+  journal->start_flags = board->num_flags;
+  journal->start_open = board->remaining_open_cells;
+  journal->start_first_turn = board->is_first_turn;
+  journal->recording = 1;
+}
+
+void journal_record(Journal_T *journal, GameBoard_T *board, unsigned int index) {
+  if (!journal->recording) {
+    return;
+  }
+  if (journal->len == journal->capacity) {
+    journal->capacity = journal->capacity ? journal->capacity * 2 : 4096;
+    journal->indices = (uint32_t *)mem_realloc(MEM_JOURNAL, journal->indices, journal->capacity * sizeof(uint32_t));
+    journal->bytes = (uint8_t *)mem_realloc(MEM_JOURNAL, journal->bytes, journal->capacity);
+  }
+
+  /* Uncovering only sets the uncovered bit, flagging only toggles the flag bit of a covered cell. A count cached on
+   * the way to uncovering it stays with the covered cell, where it is just as true */
+  uint8_t cell = CELL_KNOWN(board, index);
+  journal->indices[journal->len] = index;
+  journal->bytes[journal->len] =
+      (cell & CELL_UNCOVERED_BIT) ? (cell & ~CELL_UNCOVERED_BIT) : (cell ^ CELL_FLAGGED_BIT);
+  journal->len++;
+}
+
+/* Closes the action opened by journal_begin(). Actions that changed nothing are not kept */
+void journal_end(Journal_T *journal, GameBoard_T *board) {
+  JournalAction_T *action = &journal->actions[journal->num_actions];
+  journal->recording = 0;
+  if (journal->len == action->first) {
+    return;
+  }
+  /* The first uncover also generated the board, which is kept on undo, so measure from the generated counters */
+  if (journal->start_first_turn && !board->is_first_turn) {
+    journal->start_flags = board->num_bombs;
+    journal->start_open = board->height * board->width - board->num_bombs;
+  }
+  action->flags_delta = (int)board->num_flags - (int)journal->start_flags;
+  action->open_delta = (int)board->remaining_open_cells - (int)journal->start_open;
+  action->state_after = board->game_state;
+  journal->num_actions++;
+  journal->applied = journal->num_actions;
+}
+
+static void journal_swap(Journal_T *journal, GameBoard_T *board, size_t ii) {
+  unsigned int index = journal->indices[ii];
+  uint8_t cell = CELL_KNOWN(board, index);
+  CELL_KNOWN(board, index) = journal->bytes[ii];
+  journal->bytes[ii] = cell;
+  CELL_CHANGED(board, index);
+}
+
+static size_t journal_action_end(Journal_T *journal, size_t a) {
+  return (a + 1 < journal->num_actions) ? journal->actions[a + 1].first : journal->len;
+}
+
+/* Returns 0 if there is nothing to undo */
+int journal_undo(Journal_T *journal, GameBoard_T *board) {
+  if (!journal->applied) {
+    return 0;
+  }
+  JournalAction_T *action = &journal->actions[--journal->applied];
+  for (size_t ii = journal_action_end(journal, journal->applied); ii-- > action->first;) {
+    journal_swap(journal, board, ii);
+  }
+  board->num_flags -= action->flags_delta;
+  board->remaining_open_cells -= action->open_delta;
+  board->game_state = action->state_before;
+  board->curr_index = action->index;
+  return 1;
+}
+
+/* Returns 0 if there is nothing to redo */
+int journal_redo(Journal_T *journal, GameBoard_T *board) {
+  if (journal->applied == journal->num_actions) {
+    return 0;
+  }
+  JournalAction_T *action = &journal->actions[journal->applied];
+  for (size_t ii = action->first; ii < journal_action_end(journal, journal->applied); ii++) {
+    journal_swap(journal, board, ii);
+  }
+  journal->applied++;
+  board->num_flags += action->flags_delta;
+  board->remaining_open_cells += action->open_delta;
+  board->game_state = action->state_after;
+  board->curr_index = action->index;
+  return 1;
+}
+
+void journal_exit(Journal_T *journal) {
+  mem_free(journal->indices);
+  mem_free(journal->bytes);
+  mem_free(journal->actions);
+  memset(journal, 0, sizeof(Journal_T));
+}
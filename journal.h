@@ -0,0 +1,72 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Undo/redo journal.
+ *
+ * Every action appends the cells it changed, as (index, previous byte) pairs, plus how it moved num_flags and
+ * remaining_open_cells. Undo swaps the stored bytes back into the board, which leaves the journal holding the newer
+ * bytes, so redo is the same swap run forwards. Both are a single pass over the action's cells, and memory grows with
+ * the number of changed cells rather than with the board.
+ *
+ * Cells reach the journal through the board's cell change listener, which only reports a cell once it holds its final
+ * value. An action only ever flips one bit of a cell (uncover or flag), so the previous byte is recovered from the
+ * final one.
+ *
+ * The mine layout is not journaled: undoing the first uncover keeps the board that it generated.
+ */
+struct GameBoard;
+
+/* Checkpoint for one undoable action. Its cells are entries [first, next action's first) */
+typedef struct JournalAction {
+  size_t first;
+  int flags_delta;
+  int open_delta;
+  unsigned int index;
+  int state_before;
+  int state_after;
+} JournalAction_T;
+
+typedef struct Journal {
+  /* Cell entries, split so an entry costs five bytes */
+  uint32_t *indices;
+  uint8_t *bytes;
+  size_t len;
+  size_t capacity;
+
+  JournalAction_T *actions;
+  size_t num_actions;
+  size_t actions_capacity;
+  /* Actions before this one are applied, the rest can be redone */
+  size_t applied;
+
+  int recording;
+  unsigned int start_flags;
+  unsigned int start_open;
+  int start_first_turn;
+} Journal_T;
+
+/* Journal prototypes begin */
+
+void journal_init(Journal_T *journal);
+
+void journal_reset(Journal_T *journal);
+
+void journal_begin(Journal_T *journal, struct GameBoard *board);
+
+void journal_record(Journal_T *journal, struct GameBoard *board, unsigned int index);
+
+void journal_end(Journal_T *journal, struct GameBoard *board);
+
+int journal_undo(Journal_T *journal, struct GameBoard *board);
+
+int journal_redo(Journal_T *journal, struct GameBoard *board);
+
+void journal_exit(Journal_T *journal);
+
+/* Journal prototypes end */
+
+#endif /* JOURNAL_H */
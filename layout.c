@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include "layout.h"
+#include "mem.h"
+
+static const char *LAYOUT_NAMES[NUM_LAYOUTS] = {"rows", "tiles"};
+
+/* Ranks the tiles inside the size x size square at (row, col) in Z-order, skipping those off the board */
+static uint32_t layout_rank_tiles(Layout_T *layout, unsigned int row, unsigned int col, unsigned int size,
+                                  uint32_t next) {
+  if (row >= layout->tiles_down || col >= layout->tiles_across) {
+    return next;
+  }
+  if (size == 1) {
+    layout->tile_rank[row * layout->tiles_across + col] = next;
+    return next + 1;
+  }
+  size /= 2;
+  next = layout_rank_tiles(layout, row, col, size, next);
+  next = layout_rank_tiles(layout, row, col + size, size, next);
+  next = layout_rank_tiles(layout, row + size, col, size, next);
+  return layout_rank_tiles(layout, row + size, col + size, size, next);
+}
+
+/**
+ * Sizes a layout for a board. A board a single column wide is stored as rows whatever its kind, as its vertical
+ * neighbors already sit next to each other. Tables are only built again when the size changes.
+ */
+void layout_init(Layout_T *layout, LayoutKind_T kind, unsigned int height, unsigned int width) {
+  if (layout->kind == kind && layout->height == height && layout->width == width) {
+    return;
+  }
+  layout_exit(layout);
+  layout->kind = kind;
+  layout->height = height;
+  layout->width = width;
+  if (kind == LAYOUT_ROWS || width < 2) {
+    return;
+  }
+
+  layout->width_recip = UINT64_MAX / width + 1;
+  layout->tiles_down = (height + LAYOUT_TILE_MASK) >> LAYOUT_TILE_LOG2;
+  layout->tiles_across = (width + LAYOUT_TILE_MASK) >> LAYOUT_TILE_LOG2;
+  layout->tile_rank =
+      (uint32_t *)mem_alloc(MEM_BOARD, (size_t)layout->tiles_down * layout->tiles_across * sizeof(uint32_t));
+  unsigned int side = 1;
+  while (side < layout->tiles_down || side < layout->tiles_across) {
+    side *= 2;
+  }
+  layout_rank_tiles(layout, 0, 0, side, 0);
+}
+
+/* Bytes to allocate for a board's cells, with room to move the first tile onto a cache line */
+size_t layout_bytes(const Layout_T *layout) {
+  if (!layout->tile_rank) {
+    return (size_t)layout->height * layout->width;
+  }
+  return (size_t)layout->tiles_down * layout->tiles_across * LAYOUT_TILE_CELLS + LAYOUT_ALIGN - 1;
+}
+
+/* Moves the first tile onto the first cache line in cells */
+void layout_align(Layout_T *layout, const uint8_t *cells) {
+  if (layout->tile_rank) {
+    layout->origin = -(uintptr_t)cells & (LAYOUT_ALIGN - 1);
+  }
+}
+
+/* Makes layout describe the same cells as from, with tables of its own */
+void layout_copy(Layout_T *layout, const Layout_T *from) {
+  layout_exit(layout);
+  *layout = *from;
+  if (from->tile_rank) {
+    size_t len = (size_t)from->tiles_down * from->tiles_across * sizeof(uint32_t);
+    layout->tile_rank = (uint32_t *)mem_alloc(MEM_BOARD, len);
+    memcpy(layout->tile_rank, from->tile_rank, len);
+  }
+}
+
+const char *layout_name(LayoutKind_T kind) {
+  return ((unsigned int)kind < NUM_LAYOUTS) ? LAYOUT_NAMES[kind] : "unknown";
+}
+
+/* Returns 1 if name is not a layout */
+int layout_parse(const char *name, LayoutKind_T *kind) {
+  for (unsigned int k = 0; k < NUM_LAYOUTS; k++) {
+    if (!strcmp(name, LAYOUT_NAMES[k])) {
+      *kind = (LayoutKind_T)k;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Frees the tables, keeping the kind for the next layout_init() */
+void layout_exit(Layout_T *layout) {
+  LayoutKind_T kind = layout->kind;
+  mem_free(layout->tile_rank);
+  memset(layout, 0, sizeof(Layout_T));
+  layout->kind = kind;
+}
@@ -0,0 +1,113 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Board layouts: where in memory a cell's byte lives.
+ *
+ *   rows   row-major, a cell's index is its offset
+ *   tiles  64x64 tiles, row-major inside, laid down in Z-order
+ *
+ * Cell indices are row-major whichever layout a board uses; only CELL_KNOWN() and the counting and flood fill loops,
+ * which have one loop per layout, look at the layout. With rows, the cells above and below a cell are a whole row
+ * away, so on wide boards every vertical step lands on another cache line and often another page. A tile is one 4 KiB
+ * page and each of its rows one 64-byte cache line, so all eight neighbors of a cell inside a tile are on its page,
+ * and the Z-order keeps most neighboring tiles close by as well. The edge tiles are padded out to full size, and the
+ * tiles start on a cache line.
+ *
+ * Finding a cell's tile takes its row and column, so the division of the index by the width is done as a multiply by
+ * a precomputed reciprocal (Lemire, Kaser and Kurz, "Faster Remainder by Direct Computation"), exact for every 32-bit
+ * index. Tile offsets come from a table built when the board is sized. Counting and flood fill skip even that for a
+ * square cell away from its tile's border, whose neighbors are at fixed steps from it (see layout_inner_offset()).
+ */
+#define LAYOUT_TILE_LOG2 6
+#define LAYOUT_TILE_SIDE (1u << LAYOUT_TILE_LOG2)
+#define LAYOUT_TILE_MASK (LAYOUT_TILE_SIDE - 1)
+#define LAYOUT_TILE_CELLS (LAYOUT_TILE_SIDE * LAYOUT_TILE_SIDE)
+#define LAYOUT_ALIGN 64
+
+typedef enum LayoutKind {
+  LAYOUT_ROWS = 0,
+  LAYOUT_TILES = 1,
+  NUM_LAYOUTS,
+} LayoutKind_T;
+
+typedef struct Layout {
+  LayoutKind_T kind;
+  unsigned int height;
+  unsigned int width;
+  /* 2^64 / width, rounded up */
+  uint64_t width_recip;
+  unsigned int tiles_across;
+  unsigned int tiles_down;
+  /* Position of each tile in Z-order, row-major by tile, or NULL when the cells are stored as rows. Tile t starts at
+   * origin + tile_rank[t] * LAYOUT_TILE_CELLS */
+  uint32_t *tile_rank;
+  /* Bytes from the start of the cells to the first tile, which lands on a cache line */
+  unsigned int origin;
+} Layout_T;
+
+static inline size_t layout_tile_offset(const Layout_T *layout, unsigned int row, unsigned int col) {
+  uint32_t rank = layout->tile_rank[(row >> LAYOUT_TILE_LOG2) * layout->tiles_across + (col >> LAYOUT_TILE_LOG2)];
+  return layout->origin + (size_t)rank * LAYOUT_TILE_CELLS + ((row & LAYOUT_TILE_MASK) << LAYOUT_TILE_LOG2) +
+         (col & LAYOUT_TILE_MASK);
+}
+
+/* Where a cell lives, in bytes from the start of the board's cells */
+static inline size_t layout_offset(const Layout_T *layout, unsigned int index) {
+  if (!layout->tile_rank) {
+    return index;
+  }
+  unsigned int row = (unsigned int)(((unsigned __int128)layout->width_recip * index) >> 64);
+  return layout_tile_offset(layout, row, index - row * layout->width);
+}
+
+/**
+ * Where a cell lives if it is off the border of its tile and of the board, so that the eight cells around it are all
+ * in its tile at fixed steps from it. SIZE_MAX otherwise, and always for boards stored as rows.
+ */
+static inline size_t layout_inner_offset(const Layout_T *layout, unsigned int index) {
+  if (!layout->tile_rank) {
+    return SIZE_MAX;
+  }
+  unsigned int row = (unsigned int)(((unsigned __int128)layout->width_recip * index) >> 64);
+  unsigned int col = index - row * layout->width;
+  if ((row & LAYOUT_TILE_MASK) - 1 < LAYOUT_TILE_SIDE - 2 && (col & LAYOUT_TILE_MASK) - 1 < LAYOUT_TILE_SIDE - 2 &&
+      row + 1 < layout->height && col + 1 < layout->width) {
+    return layout_tile_offset(layout, row, col);
+  }
+  return SIZE_MAX;
+}
+
+/* Where the cell at (row, col) lives, and in *len how many cells of its row from it on are stored one after another */
+static inline size_t layout_row_run(const Layout_T *layout, unsigned int row, unsigned int col, unsigned int *len) {
+  if (!layout->tile_rank) {
+    *len = layout->width - col;
+    return (size_t)row * layout->width + col;
+  }
+  *len = LAYOUT_TILE_SIDE - (col & LAYOUT_TILE_MASK);
+  *len = (*len < layout->width - col) ? *len : layout->width - col;
+  return layout_tile_offset(layout, row, col);
+}
+
+/* Layout prototypes begin */
+
+void layout_init(Layout_T *layout, LayoutKind_T kind, unsigned int height, unsigned int width);
+
+size_t layout_bytes(const Layout_T *layout);
+
+void layout_align(Layout_T *layout, const uint8_t *cells);
+
+void layout_copy(Layout_T *layout, const Layout_T *from);
+
+const char *layout_name(LayoutKind_T kind);
+
+int layout_parse(const char *name, LayoutKind_T *kind);
+
+void layout_exit(Layout_T *layout);
+
+/* Layout prototypes end */
+
+#endif /* LAYOUT_H */
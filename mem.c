@@ -0,0 +1,119 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+static const char *MemTagStr[NUM_MEM_TAGS] = {"board", "panels", "solver", "journal", "net"};
+
+/* Sized to keep the block after it aligned for any type */
+typedef union MemHeader {
+  struct {
+    size_t size;
+    MemTag_T tag;
+  };
+  max_align_t align;
+} MemHeader_T;
+
+/* One cache line per tag, so the solver thread and the game thread do not trade counters */
+typedef struct MemCounters {
+  alignas(64) atomic_size_t live;
+  atomic_size_t peak;
+  atomic_ulong allocs;
+  atomic_ulong frees;
+} MemCounters_T;
+
+static MemCounters_T mem_counters[NUM_MEM_TAGS];
+
+static void mem_add(MemTag_T tag, size_t size) {
+  MemCounters_T *c = &mem_counters[tag];
+  size_t live = atomic_fetch_add_explicit(&c->live, size, memory_order_relaxed) + size;
+  size_t peak = atomic_load_explicit(&c->peak, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&c->peak, &peak, live, memory_order_relaxed, memory_order_relaxed)) {
+  }
+}
+
+static void mem_sub(MemTag_T tag, size_t size) {
+  atomic_fetch_sub_explicit(&mem_counters[tag].live, size, memory_order_relaxed);
+}
+
+void *mem_alloc(MemTag_T tag, size_t size) {
+  MemHeader_T *h = (MemHeader_T *)malloc(sizeof(MemHeader_T) + size);
+  if (!h) {
+    return NULL;
+  }
+  h->size = size;
+  h->tag = tag;
+  mem_add(tag, size);
+  atomic_fetch_add_explicit(&mem_counters[tag].allocs, 1, memory_order_relaxed);
+  return h + 1;
+}
+
+void *mem_calloc(MemTag_T tag, size_t count, size_t size) {
+  void *p = mem_alloc(tag, count * size);
+  if (p) {
+    memset(p, 0, count * size);
+  }
+  return p;
+}
+
+/* A block keeps the tag it was first allocated with */
+void *mem_realloc(MemTag_T tag, void *ptr, size_t size) {
+  if (!ptr) {
+    return mem_alloc(tag, size);
+  }
+  MemHeader_T *h = (MemHeader_T *)ptr - 1;
+  size_t old_size = h->size;
+  tag = h->tag;
+  h = (MemHeader_T *)realloc(h, sizeof(MemHeader_T) + size);
+  if (!h) {
+    return NULL;
+  }
+  h->size = size;
+  if (size > old_size) {
+    mem_add(tag, size - old_size);
+  } else {
+    mem_sub(tag, old_size - size);
+  }
+  return h + 1;
+}
+
+void mem_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  MemHeader_T *h = (MemHeader_T *)ptr - 1;
+  mem_sub(h->tag, h->size);
+  atomic_fetch_add_explicit(&mem_counters[h->tag].frees, 1, memory_order_relaxed);
+  free(h);
+}
+
+void mem_get_stats(MemTag_T tag, MemStats_T *stats) {
+  MemCounters_T *c = &mem_counters[tag];
+  stats->live = atomic_load_explicit(&c->live, memory_order_relaxed);
+  stats->peak = atomic_load_explicit(&c->peak, memory_order_relaxed);
+  stats->allocs = atomic_load_explicit(&c->allocs, memory_order_relaxed);
+  stats->frees = atomic_load_explicit(&c->frees, memory_order_relaxed);
+}
+
+size_t mem_live_total(void) {
+  size_t total = 0;
+  for (int t = 0; t < NUM_MEM_TAGS; t++) {
+    total += atomic_load_explicit(&mem_counters[t].live, memory_order_relaxed);
+  }
+  return total;
+}
+
+const char *mem_tag_name(MemTag_T tag) { return MemTagStr[tag]; }
+
+void mem_report(FILE *out) {
+  fprintf(out, "%-10s %14s %14s %12s %12s\n", "subsystem", "live_bytes", "peak_bytes", "allocs", "frees");
+  for (int t = 0; t < NUM_MEM_TAGS; t++) {
+    MemStats_T stats;
+    mem_get_stats((MemTag_T)t, &stats);
+    fprintf(out, "%-10s %14zu %14zu %12lu %12lu\n", MemTagStr[t], stats.live, stats.peak, stats.allocs, stats.frees);
+  }
+  fprintf(out, "%-10s %14zu\n", "total", mem_live_total());
+}
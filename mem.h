@@ -0,0 +1,53 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Tagged allocator for memory accounting.
+ *
+ * Every block carries a small header with its size and the subsystem it was allocated for, so frees and reallocs
+ * settle the right counters without the caller knowing either. Each subsystem keeps its live bytes, the most it ever
+ * held at once, and how many blocks it allocated and freed. Counters are atomics, updated from whichever thread
+ * allocates.
+ *
+ * Blocks from mem_alloc() and friends must only be released with mem_free() or resized with mem_realloc().
+ */
+typedef enum MemTag {
+  MEM_BOARD,
+  MEM_PANELS,
+  MEM_SOLVER,
+  MEM_JOURNAL,
+  MEM_NET,
+  NUM_MEM_TAGS,
+} MemTag_T;
+
+typedef struct MemStats {
+  size_t live;
+  size_t peak;
+  unsigned long allocs;
+  unsigned long frees;
+} MemStats_T;
+
+/* Mem prototypes begin */
+
+void *mem_alloc(MemTag_T tag, size_t size);
+
+void *mem_calloc(MemTag_T tag, size_t count, size_t size);
+
+void *mem_realloc(MemTag_T tag, void *ptr, size_t size);
+
+void mem_free(void *ptr);
+
+void mem_get_stats(MemTag_T tag, MemStats_T *stats);
+
+size_t mem_live_total(void);
+
+const char *mem_tag_name(MemTag_T tag);
+
+void mem_report(FILE *out);
+
+/* Mem prototypes end */
+
+#endif /* MEM_H */
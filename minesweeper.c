@@ -10,17 +10,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
+#include <pthread.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "bot.h"
+#include "mem.h"
 #include "minesweeper.h"
+#include "perf.h"
+#include "render.h"
+#include "replay.h"
+#include "save.h"
+#include "server.h"
+#include "trace.h"
 
 const char *GameStateStr[] = {"Generating game...", "Creating board... ", "Placing bombs...  ",
                               "Make an action!   ", "Bomb exploded!    ", "Game exited       ",
                               "Timer expired     ", "Congratulations!  ", "Cleaning up...    "};
 
-move_cell_func MOVE_CELL_ACTIONS[8] = {_index_up,   _index_upleft,    _index_left,  _index_downleft,
-                                       _index_down, _index_downright, _index_right, _index_upright};
-
 // Num is assumed to be a uint8_t
 #define print_bits(num)                                                                                                \
   {                                                                                                                    \
@@ -66,15 +74,90 @@ str2int_errno str2int(unsigned int *out, char *s, int base) {
   return STR2INT_SUCCESS;
 }
 
-CellAction_T do_cell_action(GameBoard_T *board) {
-  CellAction_T action;
+static int read_byte(int timeout_ms) {
+  struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+  unsigned char c;
+  if (poll(&pfd, 1, timeout_ms) <= 0 || read(STDIN_FILENO, &c, 1) != 1) {
+    return ERR;
+  }
+  return c;
+}
+
+/**
+ * Curses is not thread safe and the render thread owns it while a game runs, so the logic thread reads the
+ * terminal itself. Decodes the cursor and keypad sequences the game uses (CSI and SS3 forms) into curses key codes.
+ * A lone ESC is told apart from a sequence by how quickly the next byte arrives.
+ */
+int read_key(int timeout_ms) {
+  int c = read_byte(timeout_ms);
+  if (c != 27) {
+    return c;
+  }
+
+  int intro = read_byte(KEY_ESCAPE_DELAY_MS);
+  if (intro != '[' && intro != 'O') {
+    return 27;
+  }
+
+  /* Modified keys carry a second parameter, 2 for shift as in ESC [ 1 ; 2 C */
+  int param = 0, modifier = 0;
+  while ((c = read_byte(KEY_ESCAPE_DELAY_MS)) != ERR && isdigit(c)) {
+    param = param * 10 + (c - '0');
+  }
+  if (c == ';') {
+    while ((c = read_byte(KEY_ESCAPE_DELAY_MS)) != ERR && isdigit(c)) {
+      modifier = modifier * 10 + (c - '0');
+    }
+  }
+  switch (c) {
+  case 'A':
+    return KEY_UP;
+  case 'B':
+    return KEY_DOWN;
+  case 'C':
+    return (modifier == 2) ? KEY_SRIGHT : KEY_RIGHT;
+  case 'D':
+    return (modifier == 2) ? KEY_SLEFT : KEY_LEFT;
+  case 'H':
+    return KEY_HOME;
+  case 'F':
+    return KEY_END;
+  case 'Z':
+    return KEY_BTAB;
+  case '~':
+    switch (param) {
+    case 1:
+    case 7:
+      return KEY_HOME;
+    case 4:
+    case 8:
+      return KEY_END;
+    case 5:
+      return KEY_PPAGE;
+    case 6:
+      return KEY_NPAGE;
+    default:
+      return ERR;
+    }
+  default:
+    return ERR;
+  }
+}
+
+/* Waits up to wait_ms for a key and turns it into an action */
+CellAction_T do_cell_action(GameBoard_T *board, int wait_ms) {
+  CellAction_T action = NONE;
   unsigned int pending_index = INVALID_INDEX;
   struct timespec start, stop;
 
   /* Get the start time and set the timeout for this action */
   clock_gettime(CLOCK_MONOTONIC_RAW, &start);
-  timeout(board->timeout);
-  switch (getch()) {
+  int key = read_key(wait_ms);
+  if (key != ERR) {
+    TRACE_INPUT();
+  }
+
+  switch (key) {
   /* Flag cell */
   case 'f':
   case 'F':
@@ -87,6 +170,48 @@ CellAction_T do_cell_action(GameBoard_T *board) {
     action = UNCOVER;
     break;
 
+  /* Uncover around a satisfied number */
+  case 'c':
+  case 'C':
+    action = CHORD;
+    break;
+
+  /* Take back or replay a move */
+  case 'z':
+  case 'Z':
+    action = UNDO;
+    break;
+
+  case 'y':
+  case 'Y':
+    action = REDO;
+    break;
+
+  /* Jump to a cell worth looking at */
+  case 'h':
+  case 'H':
+    pending_index = analysis_hint(&board->analysis, board->curr_index);
+    break;
+
+  /* Jump through the frontier, the covered cells or the numbers whose flags are off */
+  case '\t':
+    pending_index = nav_next(&board->nav, NAV_FRONTIER, board->curr_index);
+    break;
+
+  case KEY_BTAB:
+    pending_index = nav_prev(&board->nav, NAV_FRONTIER, board->curr_index);
+    break;
+
+  case 'n':
+  case 'N':
+    pending_index = nav_next(&board->nav, NAV_COVERED, board->curr_index);
+    break;
+
+  case 'm':
+  case 'M':
+    pending_index = nav_next(&board->nav, NAV_UNSATISFIED, board->curr_index);
+    break;
+
   /* Exit game (ESC) */
   case 27:
   case 'q':
@@ -114,6 +239,31 @@ CellAction_T do_cell_action(GameBoard_T *board) {
     pending_index = _index_left(board, board->curr_index);
     break;
 
+  /* Move a page at a time, or to either end of the row */
+  case KEY_PPAGE:
+    pending_index = nav_page(board, board->curr_index, -NAV_PAGE_ROWS, 0);
+    break;
+
+  case KEY_NPAGE:
+    pending_index = nav_page(board, board->curr_index, NAV_PAGE_ROWS, 0);
+    break;
+
+  case KEY_SLEFT:
+    pending_index = nav_page(board, board->curr_index, 0, -NAV_PAGE_COLS);
+    break;
+
+  case KEY_SRIGHT:
+    pending_index = nav_page(board, board->curr_index, 0, NAV_PAGE_COLS);
+    break;
+
+  case KEY_HOME:
+    pending_index = nav_page(board, board->curr_index, 0, -(int)board->width);
+    break;
+
+  case KEY_END:
+    pending_index = nav_page(board, board->curr_index, 0, board->width);
+    break;
+
   /* Do nothing */
   default:
     action = NONE;
@@ -133,417 +283,526 @@ CellAction_T do_cell_action(GameBoard_T *board) {
   return action;
 }
 
-void print_headers(struct PanelData *self, void *opaque) {
-  GameBoard_T *board = (GameBoard_T *)opaque;
-  WINDOW *win = panel_window(self->panel);
-  wmove(win, 1, 1);
-  // waddstr(win, GameStateStr[board->game_state]);
-  // waddstr(win, "   ");
-  wprintw(win, "%03d", board->num_flags);
-  wmove(win, 1, pm_panel_get_width(self) - 3);
-  wprintw(win, "%03d", board->seconds_elapsed);
-  wrefresh(win);
+/* Logic thread: every cell change goes to the undo journal, the jump index and the render thread */
+void game_cell_changed(GameBoard_T *board, unsigned int index) {
+  journal_record(&board->journal, board, index);
+  nav_cell_changed(&board->nav, board, index);
+  render_cell_changed(board, index);
 }
 
-void print_cell_contents(WINDOW *win, GameBoard_T *board, unsigned int index) {
-  if (CELL_UNCOVERED(board, index)) {
-    int bombs = CELL_NUMBOMBS(board, index);
-    if (CELL_HASBOMB(board, index)) {
-      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_HASBOMB_DISPLAY), waddstr(win, CELL_HASBOMB_STR));
-    } else if (board->curr_index == index) {
-      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_SELECTED_COVERED_DISPLAY) | A_BOLD,
-                            wprintw(win, CELL_SELECTED_STR, (bombs) ? bombs + '0' : ' '));
-    } else {
-      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(bombs + 10) | A_BOLD, wprintw(win, CELL_UNCOVERED_STR, bombs + '0'););
-    }
-  } else if (board->curr_index == index) {
-    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_SELECTED_UNCOVERED_DISPLAY), waddstr(win, CELL_COVERED_STR));
-  } else if (CELL_FLAGGED(board, index)) {
-    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_FLAGGED_DISPLAY), waddstr(win, CELL_FLAGGED_STR));
+int terminal_setup(GameBoard_T *board, unsigned int rows, unsigned int columns) {
+  setlocale(LC_ALL, "");
+  initscr();
+  cbreak();
+  noecho();
+  keypad(stdscr, TRUE);
 
-#ifdef DEBUG
-  } else if (CELL_HASBOMB(board, index)) {
-    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_HASBOMB_DISPLAY), waddstr(win, CELL_HASBOMB_STR));
-#endif
-  } else {
-    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_COVERED_DISPLAY), waddstr(win, CELL_COVERED_STR));
-  }
+  return render_setup(board, rows, columns);
 }
 
-void print_board(struct PanelData *self, void *opaque) {
-  GameBoard_T *board = (GameBoard_T *)opaque;
-  WINDOW *win = panel_window(self->panel);
-  wmove(win, 1, 1);
-  int curr_row = 1;
-  int curr_col = 1;
-  for (unsigned int index = 0; index < board->height * board->width; index++) {
-    if (!CELL_PRINTED(board, index) || board->refresh_board_print) {
-      wmove(win, curr_row, curr_col);
-      print_cell_contents(win, board, index);
-      CELL_SET_PRINTED(board, index);
-    }
-    curr_col += CELL_STR_LEN;
+void welcome_screen(void) {
+  /* https://patorjk.com/software/taag/#p=display&v=0&f=Sub-Zero&t=Minesweeper:
+   * Subzero, default width/height*/
+}
 
-    /* Move down to the next row to print */
-    if (!((index + 1) % board->width)) {
-      wmove(win, ++curr_row, 1);
-      curr_col = 1;
-      wrefresh(win);
-    }
-  }
+void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [--perf-stats] [--mem-stats] [--seed <n>] [--generator rand|banded] [--lazy-counts]\n"
+          "          [--topology square|torus|hex|knight] [--layout rows|tiles] [--record <file>] [--save <file>]\n"
+          "          [--broadcast <name>] <rows> <cols> <bombs>\n"
+          "       %s [--perf-stats] [--mem-stats] [--save <file>] [--broadcast <name>] --load <file>\n"
+          "       %s [--mem-stats] --server <socket>\n"
+          "       %s [--mem-stats] --bot line|binary\n"
+          "       %s --spectate <name>\n",
+          prog, prog, prog, prog, prog);
 }
 
-void print_debug_box(struct PanelData *self, void *opaque) {
-  GameBoard_T *board = (GameBoard_T *)opaque;
-  WINDOW *win = panel_window(self->panel);
-  wmove(win, 1, 1);
-  unsigned int index = board->curr_index;
-  wprintw(win, "Current index: %d [%d,%d]", index, CELL_ROW(board, index), CELL_COL(board, index));
-  wmove(win, 2, 1);
-  wprintw(win, "\tnum_bombs=%d\n\thas_bomb=%d\n\tuncovered=%d\n\tflagged=%d\n\tprinted=%d", CELL_NUMBOMBS(board, index),
-          CELL_HASBOMB(board, index) >> 4, CELL_UNCOVERED(board, index) >> 5, CELL_FLAGGED(board, index) >> 6,
-          CELL_PRINTED(board, index) >> 7);
-  wrefresh(win);
+uint64_t game_clock_ms(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
 }
 
-void uncover_cell_block(GameBoard_T *board, unsigned int index) {
-  unsigned int start_index = index;
-  unsigned int prev_index = index;
-  unsigned int next_index = -1;
+int parse_options(GameOptions_T *opts, int argc, char **argv) {
+  char *positional[3];
+  int num_positional = 0;
+
+  memset(opts, 0, sizeof(GameOptions_T));
+  opts->seed = DEFAULT_SEED;
+  opts->generator = BOARD_GENERATOR_RAND;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--perf-stats")) {
+      opts->perf_stats = 1;
+    } else if (!strcmp(argv[i], "--mem-stats")) {
+      opts->mem_stats = 1;
+    } else if (!strcmp(argv[i], "--lazy-counts")) {
+      opts->lazy_counts = 1;
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      if (str2int(&opts->seed, argv[++i], 10)) {
+        fprintf(stderr, "Specified seed %s cannot be converted into an integer\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--generator") && i + 1 < argc) {
+      i++;
+      if (!strcmp(argv[i], "rand")) {
+        opts->generator = BOARD_GENERATOR_RAND;
+      } else if (!strcmp(argv[i], "banded")) {
+        opts->generator = BOARD_GENERATOR_BANDED;
+      } else {
+        fprintf(stderr, "Unknown generator %s\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--topology") && i + 1 < argc) {
+      if (topology_parse(argv[++i], &opts->topology)) {
+        fprintf(stderr, "Unknown topology %s\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--layout") && i + 1 < argc) {
+      if (layout_parse(argv[++i], &opts->layout)) {
+        fprintf(stderr, "Unknown layout %s\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+      opts->record_path = argv[++i];
+    } else if (!strcmp(argv[i], "--save") && i + 1 < argc) {
+      opts->save_path = argv[++i];
+    } else if (!strcmp(argv[i], "--load") && i + 1 < argc) {
+      opts->load_path = argv[++i];
+    } else if (!strcmp(argv[i], "--server") && i + 1 < argc) {
+      opts->server_path = argv[++i];
+    } else if (!strcmp(argv[i], "--broadcast") && i + 1 < argc) {
+      opts->broadcast_name = argv[++i];
+    } else if (!strcmp(argv[i], "--bot") && i + 1 < argc) {
+      i++;
+      opts->bot = 1;
+      if (!strcmp(argv[i], "line")) {
+        opts->bot_framing = BOT_FRAMING_LINE;
+      } else if (!strcmp(argv[i], "binary")) {
+        opts->bot_framing = BOT_FRAMING_BINARY;
+      } else {
+        fprintf(stderr, "Unknown bot framing %s\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--spectate") && i + 1 < argc) {
+      opts->spectate_name = argv[++i];
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    } else if (num_positional < 3) {
+      positional[num_positional++] = argv[i];
+    } else {
+      return 1;
+    }
+  }
 
-  if (CELL_UNCOVERED(board, index)) {
-    return;
+  /* Server and bot games are sized by each client, spectators take the size of the game they watch */
+  if (opts->server_path || opts->spectate_name || opts->bot) {
+    return num_positional != 0 || opts->load_path || opts->record_path || opts->save_path || opts->broadcast_name ||
+           (!!opts->server_path + !!opts->spectate_name + opts->bot > 1);
   }
 
-  // Uncover only 1 cell if it has a bomb in it or adjacent to it
-  if (CELL_NUMBOMBS(board, index) || CELL_HASBOMB(board, index)) {
-    CELL_SET_UNCOVERED(board, index);
-    CELL_CLEAR_PRINTED(board, index);
-    board->remaining_open_cells--;
-    return;
+  /* A restored game takes its dimensions from the save, and its replay would not start from a fresh board */
+  if (opts->load_path) {
+    return num_positional != 0 || opts->record_path;
+  }
+  if (num_positional != 3) {
+    return 1;
   }
 
-  /* Traverse the open space and use the numbomb bits to keep track of where we
-   * came from */
-  do {
-    if (!CELL_UNCOVERED(board, index)) {
-      CELL_SET_UNCOVERED(board, index);
-      CELL_CLEAR_PRINTED(board, index);
-      board->remaining_open_cells--;
-    }
+  if (str2int(&opts->rows, positional[0], 10)) {
+    fprintf(stderr, "Specified rows %s cannot be converted into an integer\n", positional[0]);
+  }
 
-    /* Figure out which cells have a bomb around it */
-    int adjacent_bombs_bits = SURROUNDING_CELL_STATE(board, index, ADJACENTBOMB);
-    int surrounding_uncovered_bits = SURROUNDING_CELL_STATE(board, index, !CELL_UNCOVERED);
-
-    SURROUNDING_CELL_ACTION_STATEFUL(board, index, adjacent_bombs_bits, CELL_SET_UNCOVERED);
-    SURROUNDING_CELL_ACTION_STATEFUL(board, index, adjacent_bombs_bits, CELL_CLEAR_PRINTED);
-    board->remaining_open_cells -= COUNT_BITS(adjacent_bombs_bits & surrounding_uncovered_bits);
-
-    /* Go through each direction and see if we need to uncover that cell */
-    uint8_t dir = 0;
-    for (dir = 0; dir < NUM_DIRECTIONS; dir++) {
-      next_index = MOVE_CELL_ACTIONS[dir](board, index);
-      if (next_index != INVALID_INDEX && UNCOVER_BLOCK_CONDITION(board, next_index)) {
-        index = next_index;
-        uint8_t bt_dir = (dir + NUM_DIRECTIONS / 2) % NUM_DIRECTIONS;
-        SET_BACKTRACK_DIR(board, index, bt_dir);
-        break;
-      }
-    }
+  if (str2int(&opts->columns, positional[1], 10)) {
+    fprintf(stderr, "Specified columns %s cannot be converted into an integer\n", positional[1]);
+  }
 
-    /* Moving cells, do not backtrack yet */
-    if (dir != NUM_DIRECTIONS)
-      continue;
-
-    /* Backtrack */
-    if (index != start_index) {
-      prev_index = index;
-      index = MOVE_CELL_ACTIONS[BACKTRACK_DIR(board, index)](board, index);
-      int surrounding_bombs = SURROUNDING_CELL_STATE(board, prev_index, CELL_HASBOMB);
-      CELL_SET_NUMBOMBS(board, prev_index, COUNT_BITS(surrounding_bombs));
-      CELL_CLEAR_PRINTED(board, prev_index);
-    }
-  } while (index != start_index);
+  if (str2int(&opts->bombs, positional[2], 10)) {
+    fprintf(stderr, "Specified number of bombs %s cannot be converted into an integer\n", positional[2]);
+  }
+  return 0;
 }
 
-GameState_T update_game_condition(GameBoard_T *board, unsigned int index) {
-  if (board->game_state == QUIT) {
-    return QUIT;
-  } else if (CELL_UNCOVERED(board, index) && CELL_HASBOMB(board, index)) {
-    return EXPLODE;
-  } else if (board->remaining_open_cells == 0 && !board->is_first_turn) {
-    return WIN;
-  } else {
-    return TURNS;
+/* Reveals the rest of a sliced opening and closes the action that started it */
+void finish_fill(GameBoard_T *board) {
+  flood_fill_run(board, UINT64_MAX);
+  journal_end(&board->journal, board);
+  analysis_end_change(&board->analysis);
+  if (board->game_state == TURNS) {
+    board->game_state = update_game_condition(board, board->curr_index);
   }
 }
 
-void gameboard_scene_init(GameBoard_T *board, int rows, int columns) {
-  int yalign = getmaxy(stdscr) / 2 - rows / 2;
-  int xalign = getmaxx(stdscr) / 2 - (columns * CELL_STR_LEN) / 2;
-
-  PanelScene_T *ps = pm_scene_init(3);
-  pm_add_scene(board->pm, ps, GAMEBOARD_SCENE_ID);
+/* Plays one game until it ends, then leaves the final board on screen */
+void play_game(GameBoard_T *board, const GameOptions_T *opts, ReplayWriter_T *replay,
+               const struct timespec *game_start) {
+#ifndef AUTOSOLVE
+  board->game_state = TURNS;
+  CellAction_T next_action;
+
+  /* From here until the game ends the render thread owns curses */
+  pthread_t renderer;
+  nav_rebuild(&board->nav, board);
+  board->on_cell_change = game_cell_changed;
+  pthread_create(&renderer, NULL, render_thread, board);
+  ev_ring_publish(board->render.events);
+
+  unsigned int shown_flags = board->num_flags, shown_seconds = board->seconds_elapsed;
+  int filling = 0;
+  board->fill.sliced = 1;
+  while (board->game_state == TURNS) {
+    /* A big opening is revealed a slice per frame, with keys read in between */
+    if (filling) {
+      struct timespec start, stop;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      TRACE_SCOPE("flood_fill", filling = flood_fill_run(board, FLOOD_FILL_SLICE_NS));
+      clock_gettime(CLOCK_MONOTONIC, &stop);
+      board->timeout -= (stop.tv_sec - start.tv_sec) * 1000 + (stop.tv_nsec - start.tv_nsec) / 1000000;
+      if (!filling) {
+        finish_fill(board);
+      }
+      ev_ring_publish(board->render.events);
+      if (board->game_state != TURNS) {
+        break;
+      }
+    }
 
-  PanelData_T *pd;
-  pd = pm_panel_init(1, 1, 3, pm_panel_get_width(ps->background), print_headers, NULL, NULL, NULL);
-  pm_panel_add_border(pd, ' ', ' ', '*', '*', '*', '*', '*', '*');
-  pm_scene_add_panel(ps, pd, 0);
-  pd = pm_panel_init(yalign, xalign, rows + 2, columns * CELL_STR_LEN + 2, print_board, NULL, NULL, NULL);
-  pm_panel_add_border(pd, '#', '#', '#', '#', '#', '#', '#', '#');
-  pm_scene_add_panel(ps, pd, 1);
+    TRACE_SCOPE("do_cell_action", next_action = do_cell_action(board, filling ? 0 : board->timeout));
+    /* Anything but a cursor move waits for the opening, so actions still apply in the order they were made */
+    if (filling && next_action != NONE && next_action != MOVE) {
+      finish_fill(board);
+      filling = 0;
+      if (board->game_state != TURNS) {
+        break;
+      }
+    }
+    TRACE_BEGIN("update");
+    if (board->timeout <= 0) {
+      board->timeout = 1000;
+      board->seconds_elapsed++;
+    }
+    if (next_action != NONE && replay->fp) {
+      replay_write_action(replay, next_action, board->curr_index, game_clock_ms(game_start));
+    }
+    if (next_action != NONE && next_action != MOVE) {
+      analysis_begin_change(&board->analysis);
+    }
+    if (next_action == UNDO || next_action == REDO) {
+      int moved = (next_action == UNDO) ? journal_undo(&board->journal, board) : journal_redo(&board->journal, board);
+      if (moved) {
+        ev_ring_push(board->render.events, EV_CURSOR, board->curr_index, 0);
+      }
+    } else if (!filling) {
 #ifdef DEBUG
-  pd = pm_panel_init(yalign + rows + 2, xalign, 6, columns * CELL_STR_LEN + 2, print_debug_box, NULL, NULL, NULL);
+      int was_first_turn = board->is_first_turn;
 #endif
-  pm_scene_add_panel(ps, pd, 2);
-}
-
-void explode_scene_init(GameBoard_T *board) {
-  PanelScene_T *ps = pm_scene_init(1);
-  pm_add_scene(board->pm, ps, LOOSE_SCENE_ID);
+      journal_begin(&board->journal, board);
+      apply_cell_action(board, next_action);
+      /* The action stays open in the journal and the analysis until its opening is revealed */
+      filling = board->fill.len != 0;
+      if (!filling) {
+        journal_end(&board->journal, board);
+      }
+#ifdef DEBUG
+      /* Generation does not report cells, but the debug build shows covered bombs */
+      if (was_first_turn && !board->is_first_turn) {
+        ev_ring_push(board->render.events, EV_REFRESH, 0, 0);
+      }
+#endif
+    }
+    if (next_action != NONE && next_action != MOVE && !filling) {
+      analysis_end_change(&board->analysis);
+    }
 
-  PanelData_T *pd;
-  unsigned int yalign = pm_panel_get_height(ps->background) / 2 - EXPLODE_SCENE_HEIGHT / 2;
-  unsigned int xalign = pm_panel_get_width(ps->background) / 2 - EXPLODE_SCENE_WIDTH / 2;
-  pd = pm_panel_init(yalign, xalign, EXPLODE_SCENE_HEIGHT + 1, EXPLODE_SCENE_WIDTH + 1, print_explode_sequence, NULL,
-                     NULL, NULL);
-  pm_scene_add_panel(ps, pd, 0);
-}
+    if (next_action == MOVE) {
+      ev_ring_push(board->render.events, EV_CURSOR, board->curr_index, 0);
+    }
+    if (board->num_flags != shown_flags || board->seconds_elapsed != shown_seconds) {
+      shown_flags = board->num_flags;
+      shown_seconds = board->seconds_elapsed;
+      ev_ring_push(board->render.events, EV_HEADER, shown_flags, shown_seconds);
+    }
+    ev_ring_publish(board->render.events);
+    TRACE_END("update");
+  }
+  /* A chord that hit a bomb, or a win, can end the game with an opening still being revealed */
+  if (filling) {
+    finish_fill(board);
+  }
+  board->fill.sliced = 0;
 
-int terminal_setup(GameBoard_T *board, unsigned int rows, unsigned int columns) {
-  setlocale(LC_ALL, "");
-  initscr();
-  cbreak();
-  noecho();
-  keypad(stdscr, TRUE);
+  ev_ring_stop(board->render.events);
+  pthread_join(renderer, NULL);
+  board->on_cell_change = NULL;
+  render_drain(board);
+  spectate_frame(&board->render.broadcast, board, 1);
 
-  /* Use the stdscr as a base and validate we can fit the gameboard */
-  int maxy = getmaxy(stdscr);
-  int maxx = getmaxx(stdscr);
-  if (!maxx || !maxy || maxy < 5 + rows || maxx < 2 + columns) {
-    return 1;
+  /* Quitting keeps the game around for --load */
+  if (board->game_state == QUIT && opts->save_path && save_board(board, opts->save_path)) {
+    printw("Could not save the game to %s.\n", opts->save_path);
   }
 
-  /* Setup colors */
-  start_color();
-  init_color(CELL_COLOR_ZERO_SURROUNDING, 753, 753, 753);
-  init_color(CELL_COLOR_ONE_SURROUNDING, 4, 0, 996);
-  init_color(CELL_COLOR_TWO_SURROUNDING, 4, 498, 4);
-  init_color(CELL_COLOR_THREE_SURROUNDING, 996, 0, 0);
-  init_color(CELL_COLOR_FOUR_SURROUNDING, 4, 0, 502);
-  init_color(CELL_COLOR_FIVE_SURROUNDING, 506, 4, 8);
-  init_color(CELL_COLOR_SIX_SURROUNDING, 0, 502, 506);
-  init_color(CELL_COLOR_SEVEN_SURROUNDING, 0, 0, 0);
-  init_color(CELL_COLOR_EIGHT_SURROUNDING, 502, 502, 502);
-
-  init_color(CELL_COLOR_SELECTED_COVERED, 689, 980, 681);
-  init_color(CELL_COLOR_SELECTED_UNCOVERED, 689, 980, 681);
-  init_color(CELL_COLOR_COVERED, 502, 502, 502);
-  init_color(CELL_COLOR_FLAGGED, 626, 643, 113);
-  init_color(CELL_COLOR_UNCOVERED, 753, 753, 753);
-  init_color(CELL_COLOR_HASBOMB, 681, 68, 68);
-#ifdef DEBUG
-  // init_color(CELL_COLOR_BACKTRACKED, );
+#else
+  if (board->is_first_turn) {
+    generate_bombs(board, board->num_bombs);
+  }
+  for (unsigned int index = 0; index < board->height * board->width; index++) {
+    if (!CELL_HASBOMB(board, index)) {
+      cell_settle_count(board, index);
+      CELL_SET_UNCOVERED(board, index);
+    }
+  }
 #endif
 
-  init_pair(CELL_SELECTED_COVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_SELECTED_COVERED);
-  init_pair(CELL_SELECTED_UNCOVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_SELECTED_UNCOVERED);
-  init_pair(CELL_COVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_COVERED);
-  init_pair(CELL_FLAGGED_DISPLAY, COLOR_BLACK, CELL_COLOR_FLAGGED);
-  init_pair(CELL_HASBOMB_DISPLAY, COLOR_BLACK, CELL_COLOR_HASBOMB);
-#ifdef DEBUG
-  init_pair(CELL_BACKTRACKED_DISPLAY, COLOR_WHITE, COLOR_CYAN);
-#endif
+  switch (board->game_state) {
+  case EXPLODE:
+    board->active_scene = pm_switch_scene(board->pm, LOOSE_SCENE_ID);
+    pm_scene_draw_all(board->active_scene, NULL);
+    break;
+  }
 
-  init_pair(CELL_ZERO_SURROUNDING_DISPLAY, CELL_COLOR_UNCOVERED, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_ONE_SURROUNDING_DISPLAY, CELL_COLOR_ONE_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_TWO_SURROUNDING_DISPLAY, CELL_COLOR_TWO_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_THREE_SURROUNDING_DISPLAY, CELL_COLOR_THREE_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_FOUR_SURROUNDING_DISPLAY, CELL_COLOR_FOUR_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_FIVE_SURROUNDING_DISPLAY, CELL_COLOR_FIVE_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_SIX_SURROUNDING_DISPLAY, CELL_COLOR_SIX_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_SEVEN_SURROUNDING_DISPLAY, CELL_COLOR_SEVEN_SURROUNDING, CELL_COLOR_UNCOVERED);
-  init_pair(CELL_EIGHT_SURROUNDING_DISPLAY, CELL_COLOR_EIGHT_SURROUNDING, CELL_COLOR_UNCOVERED);
-
-  /* Create panel manager and scenes */
-  board->pm = pm_init(NUM_SCENES);
-  gameboard_scene_init(board, rows, columns);
-  explode_scene_init(board);
-
-  /* Switch to the gameboard scene first */
+  board->refresh_board_print = 1;
+  board->curr_index = INVALID_INDEX;
+  board->render.cursor = INVALID_INDEX;
   board->active_scene = pm_switch_scene(board->pm, GAMEBOARD_SCENE_ID);
-  return 0;
+  pm_scene_draw_all(board->active_scene, board);
+  board->refresh_board_print = 0;
 }
 
-void generate_board(GameBoard_T *board, unsigned int rows, unsigned int columns) {
-  /* Board data */
-  board->board = (uint8_t *)malloc(rows * columns * sizeof(uint8_t));
-  memset(board->board, DEFAULT_CELL, rows * columns);
-  board->height = rows;
-  board->width = columns;
-  board->num_bombs = 0;
-  board->num_flags = 0;
-  board->remaining_open_cells = 0;
-
-  /* User data */
-  board->curr_index = 0;
-
-  /* State data */
-  board->game_state = BOARD_GENERATION;
-  board->seconds_elapsed = 0;
-  board->timeout = 1000; /* 1000 ms */
-  board->is_first_turn = 1;
-  board->refresh_board_print = 0;
+/* Starts another game on the same board buffer, render state and scenes */
+void new_game(GameBoard_T *board, unsigned int bombs, unsigned int seed) {
+  analysis_begin_change(&board->analysis);
+  reset_board(board, board->height, board->width);
+  board->num_bombs = bombs;
+  board->seed = seed;
+  analysis_end_change(&board->analysis);
+  analysis_new_game(&board->analysis);
+  render_reset(board);
+  journal_reset(&board->journal);
 }
 
-void welcome_screen(void) {
-  /* https://patorjk.com/software/taag/#p=display&v=0&f=Sub-Zero&t=Minesweeper:
-   * Subzero, default width/height*/
+/* Starts the replay log for a new game when --record was given. Each game replaces the last one's log */
+void record_game(ReplayWriter_T *replay, const GameOptions_T *opts, GameBoard_T *board, struct timespec *game_start) {
+  replay_writer_close(replay);
+  clock_gettime(CLOCK_MONOTONIC, game_start);
+  if (opts->record_path) {
+    ReplayHeader_T header = {.generator = board->generator,
+                             .height = board->height,
+                             .width = board->width,
+                             .bombs = board->num_bombs,
+                             .seed = board->seed,
+                             .topology = board->topology.kind};
+    if (replay_writer_open(replay, opts->record_path, &header)) {
+      printw("Could not open %s for recording.\n", opts->record_path);
+    }
+  }
 }
 
-int generate_bombs(GameBoard_T *board, int bombs) {
-  // TODO: Should bomb generation be random or clustered?
-  board->game_state = BOMB_GENERATION;
-  board->num_bombs = bombs;
-  board->num_flags = bombs;
-  for (int b = 0; b < board->num_bombs; b++) {
-    int placement;
-    do {
-      placement = rand() % (board->width * board->height);
-    } while (!PLACE_BOMB_CONDITION(board, placement));
-    CELL_SET_HASBOMB(board, placement);
-#if defined(DEBUG) || defined(AUTOSOLVE)
-    CELL_CLEAR_PRINTED(board, placement);
-#endif
+/* Watches a game played with --broadcast, drawing it with the same scenes as the player */
+int spectate_game(const char *name) {
+  SpectateReader_T reader;
+  if (spectate_reader_open(&reader, name)) {
+    fprintf(stderr, "Nobody is broadcasting a game on %s\n", name);
+    return 1;
   }
+  GameBoard_T *board = (GameBoard_T *)mem_calloc(MEM_BOARD, 1, sizeof(GameBoard_T));
+  generate_board(board, reader.shm->height, reader.shm->width);
+  RenderState_T *rs = &board->render;
 
-  // Update the number of bombs around each cell
-  for (int i = 0; i < board->height * board->width; i++) {
-    int surrounding_bombs = SURROUNDING_CELL_STATE(board, i, CELL_HASBOMB);
-    CELL_SET_NUMBOMBS(board, i, COUNT_BITS(surrounding_bombs));
+  if (terminal_setup(board, board->height, board->width)) {
+    printw("Terminal initialization failed. Exiting.\n");
+    timeout(-1);
+    getch();
+  } else {
+    render_init(board);
+    int synced = 0, key = ERR;
+    while (key != 'q' && key != 'Q' && key != 27) {
+      /* Join at the newest keyframe, and again whenever the player gets a whole ring ahead */
+      if (!synced) {
+        SpectateView_T view;
+        spectate_reader_keyframe(&reader, board->board, &view);
+        rs->cursor = view.cursor;
+        rs->num_flags = view.num_flags;
+        rs->seconds_elapsed = view.seconds_elapsed;
+        board->game_state = view.game_state;
+        rs->full_refresh = 1;
+        synced = 1;
+      }
+
+      /* Anything published before the player left is read before giving up on it */
+      int closed = spectate_reader_closed(&reader);
+      SpectateRecord_T record;
+      int got, frames = 0;
+      while ((got = spectate_reader_next(&reader, &record)) > 0) {
+        switch (record.type) {
+        case SPECTATE_CELL:
+          if (INDEX_ON_BOARD(board, record.index)) {
+            CELL_KNOWN(board, record.index) = record.value;
+            render_batch_add(rs, record.index, record.value);
+          }
+          break;
+        case SPECTATE_CURSOR:
+          render_move_cursor(board, record.index);
+          break;
+        case SPECTATE_HEADER:
+          rs->num_flags = record.index;
+          rs->seconds_elapsed = record.value;
+          break;
+        case SPECTATE_STATE:
+          board->game_state = record.value;
+          break;
+        case SPECTATE_FRAME:
+          frames++;
+          break;
+        case SPECTATE_KEYFRAME:
+          got = -1;
+          break;
+        }
+        if (got < 0) {
+          break;
+        }
+      }
+      /* After a keyframe marker, or after being lapped, carry on from the newest keyframe */
+      if (got < 0) {
+        synced = 0;
+        continue;
+      }
+      if (frames || rs->full_refresh) {
+        pm_scene_draw_all(board->active_scene, board);
+      }
+      if (closed) {
+        timeout(-1);
+        getch();
+        break;
+      }
+      key = read_key(SPECTATE_POLL_MS);
+    }
   }
 
-  board->remaining_open_cells = (board->width * board->height) - bombs;
+  if (board->pm) {
+    pm_exit(board->pm);
+  }
+  endwin();
+  render_exit(board);
+  free_board(board);
+  mem_free(board);
+  spectate_reader_close(&reader);
   return 0;
 }
 
 int main(int argc, char **argv, char **envp) {
-  GameBoard_T *board = (GameBoard_T *)malloc(sizeof(GameBoard_T));
+  GameBoard_T *board = (GameBoard_T *)mem_calloc(MEM_BOARD, 1, sizeof(GameBoard_T));
   board->game_state = GAME_INIT;
 
-  unsigned int rows, cols, bombs;
-  if (argc != 4) {
-    fprintf(stderr, "Usage: %s <rows> <cols> <bombs>\n", argv[0]);
+  GameOptions_T opts;
+  if (parse_options(&opts, argc, argv)) {
+    usage(argv[0]);
     exit(1);
   }
-
-  srand(11);
-
-  if (str2int(&rows, argv[1], 10)) {
-    fprintf(stderr, "Specified rows %s cannot be converted into an integer\n", argv[1]);
+  if (opts.server_path || opts.bot) {
+    mem_free(board);
+    int status = opts.server_path ? server_run(opts.server_path) : bot_run(opts.bot_framing);
+    /* Everything is freed by now, so only the peaks tell what the sessions held */
+    if (opts.mem_stats) {
+      mem_report(stderr);
+    }
+    return status;
   }
-
-  if (str2int(&cols, argv[2], 10)) {
-    fprintf(stderr, "Specified columns %s cannot be converted into an integer\n", argv[2]);
+  if (opts.spectate_name) {
+    mem_free(board);
+    return spectate_game(opts.spectate_name);
   }
+  if (opts.load_path) {
+    if (load_board(board, opts.load_path)) {
+      fprintf(stderr, "Could not restore a game from %s\n", opts.load_path);
+      exit(1);
+    }
+    opts.rows = board->height;
+    opts.columns = board->width;
+    opts.bombs = board->num_bombs;
+  } else {
+    board->topology.kind = opts.topology;
+    board->layout.kind = opts.layout;
+  }
+  unsigned int rows = opts.rows, cols = opts.columns, bombs = opts.bombs;
 
-  if (str2int(&bombs, argv[3], 10)) {
-    fprintf(stderr, "Specified number of bombs %s cannot be converted into an integer\n", argv[3]);
+  if (opts.perf_stats && perf_open()) {
+    fprintf(stderr, "perf_event_open failed, --perf-stats will only report wall time\n");
   }
 
   if (terminal_setup(board, rows, cols)) {
     printw("Terminal initialization failed. Exiting.\n");
+    timeout(-1);
+    getch();
   } else {
-    generate_board(board, rows, cols);
-
-#ifndef AUTOSOLVE
-    board->game_state = TURNS;
-    CellAction_T next_action;
-
-    while (board->game_state == TURNS) {
-      pm_scene_draw_all(board->active_scene, (void *)board);
-      CELL_CLEAR_PRINTED(board, board->curr_index);
-      next_action = do_cell_action(board);
-      if (board->timeout <= 0) {
-        board->timeout = 1000;
-        board->seconds_elapsed++;
-      }
-      switch (next_action) {
-      case UNCOVER:
-        // We have to check for a explode condition before win condition due to
-        // this logic
-        if (board->is_first_turn) {
-          generate_bombs(board, bombs);
-          board->is_first_turn = 0;
-        }
-        uncover_cell_block(board, board->curr_index);
-        break;
+    if (!opts.load_path) {
+      generate_board(board, rows, cols);
+      board->num_bombs = bombs;
+      board->seed = opts.seed;
+      board->generator = opts.generator;
+      board->lazy_counts = opts.lazy_counts;
+    }
 
-      case FLAG:
-        if (board->num_flags == 0 || CELL_UNCOVERED(board, board->curr_index)) {
-          break;
-        }
-        if (!CELL_FLAGGED(board, board->curr_index)) {
-          CELL_SET_FLAGGED(board, board->curr_index);
-          board->num_flags--;
-        } else {
-          CELL_CLEAR_FLAGGED(board, board->curr_index);
-          board->num_flags++;
+    render_init(board);
+    if (opts.broadcast_name &&
+        spectate_writer_open(&board->render.broadcast, opts.broadcast_name, board->height, board->width)) {
+      printw("Could not broadcast to %s.\n", opts.broadcast_name);
+    }
+    journal_init(&board->journal);
+    nav_init(&board->nav, board->height * board->width);
+    analysis_init(&board->analysis, board);
+    ReplayWriter_T replay = {0};
+    struct timespec game_start;
+    record_game(&replay, &opts, board, &game_start);
+    for (unsigned int seed = board->seed;;) {
+      play_game(board, &opts, &replay, &game_start);
+
+      timeout(-1);
+      int key = getch();
+
+      /* A finished game can be taken back a move and played on */
+      if ((key == 'z' || key == 'Z') && (board->game_state == EXPLODE || board->game_state == WIN) &&
+          board->journal.applied) {
+        analysis_begin_change(&board->analysis);
+        journal_undo(&board->journal, board);
+        analysis_end_change(&board->analysis);
+        if (replay.fp) {
+          replay_write_action(&replay, UNDO, board->curr_index, game_clock_ms(&game_start));
         }
-        CELL_CLEAR_PRINTED(board, board->curr_index);
-        break;
-
-      case EXIT:
-        board->game_state = QUIT;
-        break;
-
-      case MOVE:
-        CELL_CLEAR_PRINTED(board, board->curr_index);
-        break;
-
-      case NONE:
-      default:
-        break;
+        render_reset(board);
+        continue;
       }
 
-      board->game_state = update_game_condition(board, board->curr_index);
-    }
-
-#else
-    generate_bombs(board, bombs);
-    for (unsigned int index = 0; index < board->height * board->width; index++) {
-      if (!CELL_HASBOMB(board, index)) {
-        CELL_SET_UNCOVERED(board, index);
-        CELL_CLEAR_PRINTED(board, index);
+      /* Each new game gets the next seed, so a session is reproducible from its first seed */
+      if (key != 'n' && key != 'N') {
+        break;
       }
+      new_game(board, bombs, ++seed);
+      record_game(&replay, &opts, board, &game_start);
     }
-#endif
+    replay_writer_close(&replay);
   }
 
-  switch (board->game_state) {
-  case EXPLODE:
-    board->active_scene = pm_switch_scene(board->pm, LOOSE_SCENE_ID);
-    pm_scene_draw_all(board->active_scene, NULL);
-    break;
-  }
-
-  board->refresh_board_print = 1;
-  board->curr_index = INVALID_INDEX;
-  board->active_scene = pm_switch_scene(board->pm, GAMEBOARD_SCENE_ID);
-  pm_scene_draw_all(board->active_scene, board);
-  board->refresh_board_print = 0;
-
-  // printw("Press any key to continue...");
-  timeout(-1);
-  getch();
-
   board->game_state = CLEANUP;
+  if (board->pm) {
+    pm_exit(board->pm);
+  }
   endwin();
-  if (board->board) {
-    free(board->board);
+  perf_report(stderr);
+  perf_close();
+  if (opts.perf_stats) {
+    analysis_report(&board->analysis, stderr);
+  }
+  /* Before teardown, so live bytes are what the last game held */
+  if (opts.mem_stats) {
+    mem_report(stderr);
   }
-  free(board);
+  analysis_exit(&board->analysis);
+  render_exit(board);
+  journal_exit(&board->journal);
+  nav_exit(&board->nav);
+  free_board(board);
+  mem_free(board);
 
   return 0;
 }
\ No newline at end of file
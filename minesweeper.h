@@ -1,6 +1,19 @@
+#ifndef MINESWEEPER_H
+#define MINESWEEPER_H
+
+#include <stddef.h>
 #include <stdint.h>
 
+#include "analysis.h"
+#include "bot.h"
+#include "event_ring.h"
+#include "journal.h"
+#include "layout.h"
+#include "minimap.h"
+#include "nav_index.h"
 #include "panel_manager.h"
+#include "spectate.h"
+#include "topology.h"
 
 /* Cell display macros */
 static const unsigned int CELL_SELECTED_COVERED_DISPLAY = 20;
@@ -77,46 +90,110 @@ typedef enum CellAction {
   UNCOVER,
   FLAG,
   EXIT,
+  CHORD,
+  UNDO,
+  REDO,
 } CellAction_T;
 
+/* One entry of a batched action, see apply_cell_actions() */
+typedef struct CellOp {
+  CellAction_T action;
+  unsigned int index;
+} CellOp_T;
+
+/* Bomb placement algorithms. Recorded in replays so a seed always reproduces the same board */
+typedef enum BoardGenerator {
+  BOARD_GENERATOR_NONE = 0,
+  BOARD_GENERATOR_RAND = 1,
+  BOARD_GENERATOR_BANDED = 2,
+} BoardGenerator_T;
+
 typedef enum PrintAction { CELL_UPDATE = 1, HEADER_UPDATE, BOARD_REFRESH } PrintAction_T;
 
 /* board (uint8_t) bitfields
   +------------+---+---+---+---+
   | 7 | 6 | 5 | 4 |    3-0     |
   +------------+---+---+---+---+
-  7: Cell updates printed (0 means need print)
+  7: Counted, bits 3-0 hold the count. Uncovered cells are always counted
   6: Flagged
   5: Uncovered
   4: Has bomb
   3-0: Number of surrounding bombs (0-8)
-     : When backtracking: Incoming direction
-        0 = _index_up
-        1 = UP_RIGHT
-        2 = _index_right
-        3 = DOWN_RIGHT
-        4 = _index_down
-        5 = DOWN_LEFT
-        6 = _index_left
-        7 = UP_LEFT
 */
-#define CELL_PRINTED_BIT (1 << 7)
+#define CELL_COUNTED_BIT (1 << 7)
 #define CELL_FLAGGED_BIT (1 << 6)
 #define CELL_UNCOVERED_BIT (1 << 5)
 #define CELL_HASBOMB_BIT (1 << 4)
 #define CELL_NUMBOMBS_BITS (0x0f)
-#define CELL_BACKTRACK_BITS (0x0f)
+
+/* Forward declaration */
+struct GameBoard;
+
+typedef void (*cell_change_cb)(struct GameBoard *board, unsigned int index);
+
+/**
+ * Flood fill work, kept out of the cells so they always hold their final values. Every cell on the stack is an
+ * uncovered zero whose neighbors are still to be uncovered. A sliced fill only starts when a zero is uncovered and is
+ * then run in slices by flood_fill_run(); otherwise uncover_cell_block() finishes it before returning.
+ */
+typedef struct FloodFill {
+  uint32_t *stack;
+  size_t len;
+  size_t capacity;
+  int sliced;
+} FloodFill_T;
+
+/* Time a sliced flood fill may take per frame, and how many cells it handles between clock reads */
+#define FLOOD_FILL_SLICE_NS 4000000
+#define FLOOD_FILL_CLOCK_STRIDE 1024
+
+/* Render thread queue sizes. A full ring or batch falls back to redrawing the whole board */
+#define RENDER_RING_CAPACITY_LOG2 16
+#define RENDER_BATCH_CAPACITY (1 << 16)
+
+/* How long to wait for the rest of an escape sequence before treating ESC as a key press */
+#define KEY_ESCAPE_DELAY_MS 25
+
+/**
+ * Render-side view of the game, owned by the render thread while a game is running.
+ * Cell changes arrive through the event ring and are presented in batches.
+ */
+typedef struct RenderState {
+  EventRing_T *events;
+  CellEvent_T *batch;
+  unsigned int batch_len;
+  unsigned int batch_capacity;
+  unsigned int cursor;
+  unsigned int num_flags;
+  unsigned int seconds_elapsed;
+  int full_refresh;
+  MiniMap_T minimap;
+  SpectateWriter_T broadcast;
+} RenderState_T;
 
 typedef struct GameBoard {
   /* Display data */
   PanelManager_T *pm;
   PanelScene_T *active_scene;
   PrintAction_T print_action;
+  RenderState_T render;
+  Journal_T journal;
+  Analysis_T analysis;
+  NavIndex_T nav;
+  FloodFill_T fill;
+
+  /* Cell change listener, called once a cell reaches its final value for an action */
+  cell_change_cb on_cell_change;
+  void *listener;
 
-  /* Board data */
+  /* Board data. When mapping is set the cells live inside it (see load_board) instead of the heap */
   uint8_t *board;
+  void *mapping;
+  size_t mapping_len;
   unsigned int height;
   unsigned int width;
+  Layout_T layout;
+  Topology_T topology;
   unsigned int num_bombs;
   unsigned int num_flags;
   unsigned int remaining_open_cells;
@@ -124,6 +201,12 @@ typedef struct GameBoard {
   /* Player data */
   unsigned int curr_index;
 
+  /* Generation data. The seed is kept across generate_board() calls */
+  unsigned int seed;
+  BoardGenerator_T generator;
+  /* Only place the mines, and count cells as they are uncovered */
+  int lazy_counts;
+
   /* State data */
   GameState_T game_state;
   unsigned int seconds_elapsed;
@@ -156,7 +239,7 @@ typedef enum {
 // #define INDEX(board, row, col)          ((row*board->width)+col)
 
 /* Default cell
-  7: Printed: 0
+  7: Counted: 0
   6: Flagged: 0
   5: Uncovered: 0
   4: Has bomb: 0
@@ -173,7 +256,9 @@ static const unsigned int INVALID_INDEX = -1;
 #define CELL_COL(board, index) (index % board->width)
 
 #define CELL_ROW_CURSOR(board, index) (CELL_ROW(board, index))
-#define CELL_COL_CURSOR(board, index) (CELL_COL(board, index) * CELL_STR_LEN)
+// Odd rows of a hex board sit half a cell to the right
+#define CELL_COL_CURSOR(board, index)                                                                                  \
+  (CELL_COL(board, index) * CELL_STR_LEN + (board->topology.kind == TOPOLOGY_HEX && (CELL_ROW(board, index) & 1)))
 
 // Checks if a cell index is within the bounds of the gameboard.
 #define INDEX_ON_BOARD(board, index) ((unsigned int)(index < board->width * board->height))
@@ -181,103 +266,101 @@ static const unsigned int INVALID_INDEX = -1;
 #define COL_ON_BOARD(board, col) ((unsigned int)(col) < board->width)
 
 // Return a cell's contents if it's in the gameboard, default cell otherwise
-#define CELL_KNOWN(board, index) (*(board->board + (index)))
+#define CELL_KNOWN(board, index) (*(board->board + layout_offset(&board->layout, index)))
 #define CELL(board, index) (INDEX_ON_BOARD(board, index) ? CELL_KNOWN(board, index) : DEFAULT_CELL)
 
-/* Gameboard adjacent cell indexing macros */
-// Gets the surrounding indexes at the provided index if they exist, INVALID_INDEX otherwise
-static const unsigned int NUM_DIRECTIONS = 8;
-typedef unsigned int (*move_cell_func)(GameBoard_T *board, unsigned int index);
-
+/* Cursor movement */
+// Gets the index of the cell on the screen next to the provided index if it exists, INVALID_INDEX otherwise
 static inline unsigned int _index_up(GameBoard_T *board, unsigned int index) {
   unsigned int _row = CELL_ROW(board, index);
   return (ROW_ON_BOARD(board, (_row - 1))) ? (index - board->width) : INVALID_INDEX;
 }
 
-static inline unsigned int _index_upleft(GameBoard_T *board, unsigned int index) {
-  unsigned int _row = CELL_ROW(board, index);
-  unsigned int _col = CELL_COL(board, index);
-  return (ROW_ON_BOARD(board, (_row - 1)) && COL_ON_BOARD(board, (_col - 1))) ? (index - board->width - 1)
-                                                                              : INVALID_INDEX;
-}
-
 static inline unsigned int _index_left(GameBoard_T *board, unsigned int index) {
   unsigned int _col = CELL_COL(board, index);
   return (COL_ON_BOARD(board, (_col - 1))) ? (index - 1) : INVALID_INDEX;
 }
 
-static inline unsigned int _index_downleft(GameBoard_T *board, unsigned int index) {
-  unsigned int _row = CELL_ROW(board, index);
-  unsigned int _col = CELL_COL(board, index);
-  return (ROW_ON_BOARD(board, (_row + 1)) && COL_ON_BOARD(board, (_col - 1))) ? (index + board->width - 1)
-                                                                              : INVALID_INDEX;
-}
-
 static inline unsigned int _index_down(GameBoard_T *board, unsigned int index) {
   unsigned int _row = CELL_ROW(board, index);
   return (ROW_ON_BOARD(board, (_row + 1))) ? (index + board->width) : INVALID_INDEX;
 }
 
-static inline unsigned int _index_downright(GameBoard_T *board, unsigned int index) {
-  unsigned int _row = CELL_ROW(board, index);
-  unsigned int _col = CELL_COL(board, index);
-  return (ROW_ON_BOARD(board, (_row + 1)) && COL_ON_BOARD(board, (_col + 1))) ? (index + board->width + 1)
-                                                                              : INVALID_INDEX;
-}
-
 static inline unsigned int _index_right(GameBoard_T *board, unsigned int index) {
   unsigned int _col = CELL_COL(board, index);
   return (COL_ON_BOARD(board, (_col + 1))) ? (index + 1) : INVALID_INDEX;
 }
 
-static inline unsigned int _index_upright(GameBoard_T *board, unsigned int index) {
-  unsigned int _row = CELL_ROW(board, index);
-  unsigned int _col = CELL_COL(board, index);
-  return (ROW_ON_BOARD(board, (_row - 1)) && COL_ON_BOARD(board, (_col + 1))) ? (index - board->width + 1)
-                                                                              : INVALID_INDEX;
+/* Gameboard adjacent cell macros, in the board's topology (see topology.h) */
+#define CELL_IS_ADJACENT(board, src_index, index) topology_adjacent(&board->topology, src_index, index)
+
+// Spelled out, like the per-direction macros it replaces, so each direction keeps a branch of its own. ACTION skips
+// the INVALID_INDEX padding after the last neighbor
+#define SURROUNDING_CELL_ACTION(board, index, ACTION)                                                                  \
+  do {                                                                                                                 \
+    uint32_t _neighbors[TOPOLOGY_MAX_NEIGHBORS];                                                                       \
+    topology_neighbors(&board->topology, index, _neighbors);                                                           \
+    ACTION(board, _neighbors[0]);                                                                                      \
+    ACTION(board, _neighbors[1]);                                                                                      \
+    ACTION(board, _neighbors[2]);                                                                                      \
+    ACTION(board, _neighbors[3]);                                                                                      \
+    ACTION(board, _neighbors[4]);                                                                                      \
+    ACTION(board, _neighbors[5]);                                                                                      \
+    ACTION(board, _neighbors[6]);                                                                                      \
+    ACTION(board, _neighbors[7]);                                                                                      \
+  } while (0)
+
+// Steps from a cell to its eight neighbors within a tile, in the order topology_neighbors() lists a square cell's
+static const int TILE_SQUARE_STEPS[TOPOLOGY_MAX_NEIGHBORS] = {
+    -(int)LAYOUT_TILE_SIDE,    -(int)LAYOUT_TILE_SIDE - 1, -1, (int)LAYOUT_TILE_SIDE - 1,
+    (int)LAYOUT_TILE_SIDE,     (int)LAYOUT_TILE_SIDE + 1,  1,  -(int)LAYOUT_TILE_SIDE + 1,
+};
+
+// Where a cell lives if its neighbors are at TILE_SQUARE_STEPS from it, SIZE_MAX otherwise. Away from the edges a
+// torus has the same neighbors as a square board
+static inline size_t cell_inner_offset(GameBoard_T *board, unsigned int index) {
+  if (board->topology.kind != TOPOLOGY_SQUARE && board->topology.kind != TOPOLOGY_TORUS) {
+    return SIZE_MAX;
+  }
+  return layout_inner_offset(&board->layout, index);
 }
 
-#define CELL_IS_ADJACENT(board, src_index, index)                                                                      \
-  (_index_up(board, src_index) == index || _index_upleft(board, src_index) == index ||                                 \
-   _index_left(board, src_index) == index || _index_downleft(board, src_index) == index ||                             \
-   _index_down(board, src_index) == index || _index_downright(board, src_index) == index ||                            \
-   _index_right(board, src_index) == index || _index_upright(board, src_index) == index)
+// Counts the surrounding cells with any of the provided cell bits set, on a board stored as rows
+static inline unsigned int surrounding_cells_in_rows(GameBoard_T *board, unsigned int index, uint8_t bits) {
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  unsigned int num_neighbors = topology_neighbors(&board->topology, index, neighbors), count = 0;
+  for (unsigned int n = 0; n < num_neighbors; n++) {
+    count += (board->board[neighbors[n]] & bits) != 0;
+  }
+  return count;
+}
 
-#define SURROUNDING_CELL_ACTION(board, index, ACTION)                                                                  \
-  ACTION(board, _index_up(board, index));                                                                              \
-  ACTION(board, _index_upleft(board, index));                                                                          \
-  ACTION(board, _index_left(board, index));                                                                            \
-  ACTION(board, _index_downleft(board, index));                                                                        \
-  ACTION(board, _index_down(board, index));                                                                            \
-  ACTION(board, _index_downright(board, index));                                                                       \
-  ACTION(board, _index_right(board, index));                                                                           \
-  ACTION(board, _index_upright(board, index))
-
-// TODO: Switch if statements with (ACTION & (state & position))
-#define SURROUNDING_CELL_ACTION_STATEFUL(board, index, state, ACTION)                                                  \
-  if (state & 0x80)                                                                                                    \
-    ACTION(board, _index_up(board, index));                                                                            \
-  if (state & 0x40)                                                                                                    \
-    ACTION(board, _index_upleft(board, index));                                                                        \
-  if (state & 0x20)                                                                                                    \
-    ACTION(board, _index_left(board, index));                                                                          \
-  if (state & 0x10)                                                                                                    \
-    ACTION(board, _index_downleft(board, index));                                                                      \
-  if (state & 0x08)                                                                                                    \
-    ACTION(board, _index_down(board, index));                                                                          \
-  if (state & 0x04)                                                                                                    \
-    ACTION(board, _index_downright(board, index));                                                                     \
-  if (state & 0x02)                                                                                                    \
-    ACTION(board, _index_right(board, index));                                                                         \
-  if (state & 0x01)                                                                                                    \
-  ACTION(board, _index_upright(board, index))
-
-// Checks the surrounding cells for a provided state
-#define SURROUNDING_CELL_STATE(board, index, STATE)                                                                    \
-  (STATE(board, _index_up(board, index)) << 7 | STATE(board, _index_upleft(board, index)) << 6 |                       \
-   STATE(board, _index_left(board, index)) << 5 | STATE(board, _index_downleft(board, index)) << 4 |                   \
-   STATE(board, _index_down(board, index)) << 3 | STATE(board, _index_downright(board, index)) << 2 |                  \
-   STATE(board, _index_right(board, index)) << 1 | STATE(board, _index_upright(board, index)))
+// The same on a board stored as tiles
+static inline unsigned int surrounding_cells_in_tiles(GameBoard_T *board, unsigned int index, uint8_t bits) {
+  size_t at = cell_inner_offset(board, index);
+  if (at != SIZE_MAX) {
+    const uint8_t *cell = board->board + at;
+    unsigned int count = 0;
+    for (unsigned int n = 0; n < TOPOLOGY_MAX_NEIGHBORS; n++) {
+      count += (cell[TILE_SQUARE_STEPS[n]] & bits) != 0;
+    }
+    return count;
+  }
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  unsigned int num_neighbors = topology_neighbors(&board->topology, index, neighbors), count = 0;
+  for (unsigned int n = 0; n < num_neighbors; n++) {
+    count += (CELL_KNOWN(board, neighbors[n]) & bits) != 0;
+  }
+  return count;
+}
+
+// Counts the surrounding cells with any of the provided cell bits set
+static inline unsigned int surrounding_cells_with(GameBoard_T *board, unsigned int index, uint8_t bits) {
+  if (!board->layout.tile_rank) {
+    return surrounding_cells_in_rows(board, index, bits);
+  }
+  return surrounding_cells_in_tiles(board, index, bits);
+}
 
 // TODO: Check how portable this is
 #define COUNT_BITS(x) __builtin_popcount((unsigned int)x)
@@ -286,8 +369,10 @@ static inline unsigned int _index_upright(GameBoard_T *board, unsigned int index
 #define CELL_NUMBOMBS(board, index) (CELL(board, index) & CELL_NUMBOMBS_BITS)
 #define CELL_CLEAR_NUMBOMBS(board, index) (CELL_KNOWN(board, index) &= ~CELL_NUMBOMBS_BITS)
 #define CELL_SET_NUMBOMBS(board, index, num)                                                                           \
-  CELL_CLEAR_NUMBOMBS(board, index);                                                                                   \
-  CELL_KNOWN(board, index) |= (num)
+  do {                                                                                                                 \
+    uint8_t *_cell = &CELL_KNOWN(board, index);                                                                        \
+    *_cell = (*_cell & ~CELL_NUMBOMBS_BITS) | CELL_COUNTED_BIT | (num);                                                \
+  } while (0)
 #define ADJACENTBOMB(board, index) ((CELL(board, index) & CELL_NUMBOMBS_BITS) > 0)
 
 #define CELL_HASBOMB(board, index) ((CELL(board, index) & CELL_HASBOMB_BIT))
@@ -302,25 +387,94 @@ static inline unsigned int _index_upright(GameBoard_T *board, unsigned int index
 #define CELL_SET_FLAGGED(board, index) (CELL_KNOWN(board, index) |= CELL_FLAGGED_BIT)
 #define CELL_FLAGGED(board, index) ((CELL(board, index) & CELL_FLAGGED_BIT))
 
-#define CELL_CLEAR_PRINTED(board, index) (CELL_KNOWN(board, index) &= ~CELL_PRINTED_BIT)
-#define CELL_SET_PRINTED(board, index) (CELL_KNOWN(board, index) |= CELL_PRINTED_BIT)
-#define CELL_PRINTED(board, index) (CELL(board, index) & CELL_PRINTED_BIT)
-
-#define SET_BACKTRACK_DIR(board, index, val)                                                                           \
-  CLEAR_BACKTRACK_DIR(board, index);                                                                                   \
-  CELL_KNOWN(board, index) |= (val & 0x0f)
-#define CLEAR_BACKTRACK_DIR(board, index) (CELL_KNOWN(board, index) &= ~0x0f)
-#define BACKTRACK_DIR(board, index) ((CELL(board, index) & 0x0f))
-#define BT_UP 0
-#define BT_DOWN 1
-#define BT_RIGHT 2
-#define BT_LEFT 3
-
-#define UNCOVER_BLOCK_CONDITION(board, index) (!CELL_NUMBOMBS(board, index) && !CELL_UNCOVERED(board, index))
+/* Counts a cell that has no count yet. Called on every cell about to be uncovered */
+static inline void cell_settle_count(GameBoard_T *board, unsigned int index) {
+  if (!(CELL_KNOWN(board, index) & CELL_COUNTED_BIT)) {
+    CELL_SET_NUMBOMBS(board, index, surrounding_cells_with(board, index, CELL_HASBOMB_BIT));
+  }
+}
+
+/* A cell's count, worked out from its neighbors if it has none yet. Leaves the board untouched */
+static inline unsigned int cell_mine_count(GameBoard_T *board, unsigned int index) {
+  uint8_t cell = CELL_KNOWN(board, index);
+  if (cell & CELL_COUNTED_BIT) {
+    return cell & CELL_NUMBOMBS_BITS;
+  }
+  return surrounding_cells_with(board, index, CELL_HASBOMB_BIT);
+}
+
+// Tells the board's listener (if any) that a cell reached its new value
+#define CELL_CHANGED(board, index)                                                                                     \
+  do {                                                                                                                 \
+    if (board->on_cell_change) {                                                                                       \
+      board->on_cell_change(board, index);                                                                             \
+    }                                                                                                                  \
+  } while (0)
+
 #define PLACE_BOMB_CONDITION(board, index)                                                                             \
   (index != board->curr_index && !CELL_HASBOMB(board, index) && !CELL_IS_ADJACENT(board, board->curr_index, index))
 
+/* Command line options */
+#define DEFAULT_SEED 11
+
+typedef struct GameOptions {
+  unsigned int rows;
+  unsigned int columns;
+  unsigned int bombs;
+  unsigned int seed;
+  int perf_stats;
+  int mem_stats;
+  int lazy_counts;
+  const char *record_path;
+  const char *save_path;
+  const char *load_path;
+  const char *server_path;
+  const char *broadcast_name;
+  const char *spectate_name;
+  int bot;
+  BotFraming_T bot_framing;
+  BoardGenerator_T generator;
+  TopologyKind_T topology;
+  LayoutKind_T layout;
+} GameOptions_T;
+
+/* Board prototypes begin */
+
+void generate_board(GameBoard_T *board, unsigned int rows, unsigned int columns);
+
+void reset_board(GameBoard_T *board, unsigned int rows, unsigned int columns);
+
+void free_board(GameBoard_T *board);
+
+void count_bombs(GameBoard_T *board);
+
+int generate_bombs(GameBoard_T *board, int bombs);
+
+int uncover_cell_block(GameBoard_T *board, unsigned int index);
+
+int flood_fill_run(GameBoard_T *board, uint64_t budget_ns);
+
+GameState_T update_game_condition(GameBoard_T *board, unsigned int index);
+
+int apply_cell_action(GameBoard_T *board, CellAction_T action);
+
+int apply_cell_actions(GameBoard_T *board, const CellOp_T *ops, size_t count);
+
+/* Board prototypes end */
+
+/* Shown in the header once a game is over */
+#define GAME_OVER_HINT "n: new game, z: undo, any other key: exit"
+
+/* Debug box */
+#ifdef TRACE
+#define DEBUG_BOX_HEIGHT 11
+#else
+#define DEBUG_BOX_HEIGHT 9
+#endif
+
 /* Explode sequence */
 #define EXPLODE_SCENE_WIDTH 54
 #define EXPLODE_SCENE_HEIGHT 16
 void print_explode_sequence(PanelData_T *pd, void *opaque);
+
+#endif /* MINESWEEPER_H */
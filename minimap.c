@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "minesweeper.h"
+#include "minimap.h"
+
+/* What the minimap tracks of a cell */
+enum { MINIMAP_COVERED = 0, MINIMAP_FLAGGED = 1, MINIMAP_REVEALED = 2 };
+
+/* Braille dot bits, indexed by dot row then dot column */
+static const uint8_t MINIMAP_DOT_BITS[MINIMAP_DOT_ROWS][MINIMAP_DOT_COLS] = {
+    {0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
+static unsigned int div_ceil(unsigned int a, unsigned int b) { return (a + b - 1) / b; }
+
+static void minimap_mark(MiniMap_T *mm, unsigned int ch) {
+  if (!mm->is_dirty[ch]) {
+    mm->is_dirty[ch] = 1;
+    mm->dirty[mm->num_dirty++] = ch;
+  }
+}
+
+void minimap_init(MiniMap_T *mm, unsigned int height, unsigned int width) {
+  memset(mm, 0, sizeof(MiniMap_T));
+  mm->height = height;
+  mm->width = width;
+  mm->tile_rows = div_ceil(height, MINIMAP_MAX_ROWS * MINIMAP_DOT_ROWS);
+  mm->tile_cols = div_ceil(width, MINIMAP_MAX_COLS * MINIMAP_DOT_COLS);
+  mm->dot_rows = div_ceil(height, mm->tile_rows);
+  mm->dot_cols = div_ceil(width, mm->tile_cols);
+  mm->rows = div_ceil(mm->dot_rows, MINIMAP_DOT_ROWS);
+  mm->cols = div_ceil(mm->dot_cols, MINIMAP_DOT_COLS);
+
+  /* Every cell starts covered. Tiles on the bottom and right edges may be partial */
+  unsigned int tiles = mm->dot_rows * mm->dot_cols;
+  mm->covered = (uint32_t *)mem_alloc(MEM_PANELS, tiles * sizeof(uint32_t));
+  mm->flagged = (uint32_t *)mem_calloc(MEM_PANELS, tiles, sizeof(uint32_t));
+  for (unsigned int t = 0; t < tiles; t++) {
+    unsigned int r = t / mm->dot_cols, c = t % mm->dot_cols;
+    unsigned int tile_h = (r + 1 == mm->dot_rows) ? height - r * mm->tile_rows : mm->tile_rows;
+    unsigned int tile_w = (c + 1 == mm->dot_cols) ? width - c * mm->tile_cols : mm->tile_cols;
+    mm->covered[t] = tile_h * tile_w;
+  }
+  mm->seen = (uint8_t *)mem_calloc(MEM_PANELS, height * width, sizeof(uint8_t));
+
+  mm->dirty = (uint32_t *)mem_alloc(MEM_PANELS, mm->rows * mm->cols * sizeof(uint32_t));
+  mm->is_dirty = (uint8_t *)mem_calloc(MEM_PANELS, mm->rows * mm->cols, sizeof(uint8_t));
+  for (unsigned int ch = 0; ch < mm->rows * mm->cols; ch++) {
+    minimap_mark(mm, ch);
+  }
+  mm->cursor = INVALID_INDEX;
+}
+
+static unsigned int minimap_char_of(MiniMap_T *mm, unsigned int dot_row, unsigned int dot_col) {
+  return (dot_row / MINIMAP_DOT_ROWS) * mm->cols + dot_col / MINIMAP_DOT_COLS;
+}
+
+void minimap_cell_changed(MiniMap_T *mm, unsigned int index, uint8_t cell) {
+  uint8_t state = (cell & CELL_UNCOVERED_BIT) ? MINIMAP_REVEALED
+                  : (cell & CELL_FLAGGED_BIT) ? MINIMAP_FLAGGED
+                                              : MINIMAP_COVERED;
+  uint8_t old_state = mm->seen[index];
+  if (state == old_state) {
+    return;
+  }
+  mm->seen[index] = state;
+
+  unsigned int dot_row = (index / mm->width) / mm->tile_rows, dot_col = (index % mm->width) / mm->tile_cols;
+  unsigned int tile = dot_row * mm->dot_cols + dot_col;
+  int was_lit = mm->covered[tile] != 0, was_flagged = mm->flagged[tile] != 0;
+  mm->covered[tile] -= (old_state == MINIMAP_COVERED);
+  mm->flagged[tile] -= (old_state == MINIMAP_FLAGGED);
+  mm->covered[tile] += (state == MINIMAP_COVERED);
+  mm->flagged[tile] += (state == MINIMAP_FLAGGED);
+  if (was_lit != (mm->covered[tile] != 0) || was_flagged != (mm->flagged[tile] != 0)) {
+    minimap_mark(mm, minimap_char_of(mm, dot_row, dot_col));
+  }
+}
+
+void minimap_set_cursor(MiniMap_T *mm, unsigned int index) {
+  unsigned int ch = (index < mm->height * mm->width)
+                        ? minimap_char_of(mm, (index / mm->width) / mm->tile_rows, (index % mm->width) / mm->tile_cols)
+                        : INVALID_INDEX;
+  if (ch == mm->cursor) {
+    return;
+  }
+  if (mm->cursor != INVALID_INDEX) {
+    minimap_mark(mm, mm->cursor);
+  }
+  if (ch != INVALID_INDEX) {
+    minimap_mark(mm, ch);
+  }
+  mm->cursor = ch;
+}
+
+/* Returns the Braille dot pattern of a character, and whether any of its tiles holds a flag */
+uint8_t minimap_dots(MiniMap_T *mm, unsigned int ch, int *has_flags) {
+  unsigned int row = (ch / mm->cols) * MINIMAP_DOT_ROWS, col = (ch % mm->cols) * MINIMAP_DOT_COLS;
+  uint8_t dots = 0;
+  *has_flags = 0;
+  for (unsigned int dr = 0; dr < MINIMAP_DOT_ROWS && row + dr < mm->dot_rows; dr++) {
+    for (unsigned int dc = 0; dc < MINIMAP_DOT_COLS && col + dc < mm->dot_cols; dc++) {
+      unsigned int tile = (row + dr) * mm->dot_cols + col + dc;
+      if (mm->covered[tile]) {
+        dots |= MINIMAP_DOT_BITS[dr][dc];
+      }
+      *has_flags |= mm->flagged[tile] != 0;
+    }
+  }
+  return dots;
+}
+
+void minimap_exit(MiniMap_T *mm) {
+  mem_free(mm->covered);
+  mem_free(mm->flagged);
+  mem_free(mm->seen);
+  mem_free(mm->dirty);
+  mem_free(mm->is_dirty);
+  memset(mm, 0, sizeof(MiniMap_T));
+}
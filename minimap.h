@@ -0,0 +1,60 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <stdint.h>
+
+/**
+ * Board overview drawn in Braille characters.
+ *
+ * Every Braille dot stands for a tile of cells and is lit while the tile still has covered, unflagged cells, so a
+ * character covers 2x4 tiles. Each tile keeps counts of its covered and flagged cells, and the minimap keeps the last
+ * state it saw for every cell, so feeding it a cell costs O(1) whatever happened to the cell in between. Only
+ * characters whose dots or colour can have changed are queued for redrawing.
+ *
+ * Owned by the render thread.
+ */
+#define MINIMAP_MAX_ROWS 12
+#define MINIMAP_MAX_COLS 32
+
+#define MINIMAP_DOT_ROWS 4
+#define MINIMAP_DOT_COLS 2
+
+typedef struct MiniMap {
+  unsigned int height;
+  unsigned int width;
+  /* Cells per tile */
+  unsigned int tile_rows;
+  unsigned int tile_cols;
+  /* Tiles */
+  unsigned int dot_rows;
+  unsigned int dot_cols;
+  /* Braille characters */
+  unsigned int rows;
+  unsigned int cols;
+
+  uint32_t *covered;
+  uint32_t *flagged;
+  uint8_t *seen;
+
+  /* Characters waiting to be redrawn */
+  uint32_t *dirty;
+  unsigned int num_dirty;
+  uint8_t *is_dirty;
+  unsigned int cursor;
+} MiniMap_T;
+
+/* Minimap prototypes begin */
+
+void minimap_init(MiniMap_T *mm, unsigned int height, unsigned int width);
+
+void minimap_cell_changed(MiniMap_T *mm, unsigned int index, uint8_t cell);
+
+void minimap_set_cursor(MiniMap_T *mm, unsigned int index);
+
+uint8_t minimap_dots(MiniMap_T *mm, unsigned int ch, int *has_flags);
+
+void minimap_exit(MiniMap_T *mm);
+
+/* Minimap prototypes end */
+
+#endif /* MINIMAP_H */
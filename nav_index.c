@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "minesweeper.h"
+#include "nav_index.h"
+
+/* What the index tracks of a cell */
+enum { NAV_CELL_COVERED = 0, NAV_CELL_FLAGGED = 1, NAV_CELL_REVEALED = 2 };
+
+static void nav_bitmap_init(NavBitmap_T *bm, unsigned int bits) {
+  memset(bm, 0, sizeof(NavBitmap_T));
+  unsigned int len = bits;
+  do {
+    len = (len + 63) / 64;
+    bm->len[bm->num_levels] = len;
+    bm->words[bm->num_levels] = (uint64_t *)mem_calloc(MEM_BOARD, len, sizeof(uint64_t));
+    bm->num_levels++;
+  } while (len > 1);
+}
+
+static void nav_bitmap_clear_all(NavBitmap_T *bm) {
+  for (unsigned int level = 0; level < bm->num_levels; level++) {
+    memset(bm->words[level], 0, bm->len[level] * sizeof(uint64_t));
+  }
+}
+
+/* A word's bit in the level above only changes when the word becomes empty or stops being empty */
+static void nav_bitmap_set(NavBitmap_T *bm, unsigned int pos) {
+  for (unsigned int level = 0; level < bm->num_levels; level++) {
+    uint64_t *word = &bm->words[level][pos / 64];
+    int was_empty = !*word;
+    *word |= 1ull << (pos % 64);
+    if (!was_empty) {
+      return;
+    }
+    pos /= 64;
+  }
+}
+
+static void nav_bitmap_clear(NavBitmap_T *bm, unsigned int pos) {
+  for (unsigned int level = 0; level < bm->num_levels; level++) {
+    uint64_t *word = &bm->words[level][pos / 64];
+    *word &= ~(1ull << (pos % 64));
+    if (*word) {
+      return;
+    }
+    pos /= 64;
+  }
+}
+
+/* First member at or after pos. Climbs until a later bit turns up, then follows the lowest bits back down */
+static unsigned int nav_bitmap_next(const NavBitmap_T *bm, unsigned int pos) {
+  unsigned int level = 0;
+  for (;;) {
+    if (level == bm->num_levels) {
+      return INVALID_INDEX;
+    }
+    unsigned int word = pos / 64;
+    if (word < bm->len[level]) {
+      uint64_t bits = bm->words[level][word] & (~0ull << (pos % 64));
+      if (bits) {
+        pos = word * 64 + __builtin_ctzll(bits);
+        break;
+      }
+    }
+    pos = word + 1;
+    level++;
+  }
+  while (level--) {
+    pos = pos * 64 + __builtin_ctzll(bm->words[level][pos]);
+  }
+  return pos;
+}
+
+/* Last member at or before pos */
+static unsigned int nav_bitmap_prev(const NavBitmap_T *bm, unsigned int pos) {
+  unsigned int level = 0;
+  for (;;) {
+    if (level == bm->num_levels) {
+      return INVALID_INDEX;
+    }
+    unsigned int word = pos / 64;
+    uint64_t bits = bm->words[level][word] & (~0ull >> (63 - pos % 64));
+    if (bits) {
+      pos = word * 64 + 63 - __builtin_clzll(bits);
+      break;
+    }
+    if (!word) {
+      return INVALID_INDEX;
+    }
+    pos = word - 1;
+    level++;
+  }
+  while (level--) {
+    pos = pos * 64 + 63 - __builtin_clzll(bm->words[level][pos]);
+  }
+  return pos;
+}
+
+static void nav_bitmap_assign(NavBitmap_T *bm, unsigned int pos, int member) {
+  if (member) {
+    nav_bitmap_set(bm, pos);
+  } else {
+    nav_bitmap_clear(bm, pos);
+  }
+}
+
+static void nav_bitmap_exit(NavBitmap_T *bm) {
+  for (unsigned int level = 0; level < bm->num_levels; level++) {
+    mem_free(bm->words[level]);
+  }
+  memset(bm, 0, sizeof(NavBitmap_T));
+}
+
+void nav_init(NavIndex_T *nav, unsigned int num_cells) {
+  memset(nav, 0, sizeof(NavIndex_T));
+  nav->num_cells = num_cells;
+  for (unsigned int set = 0; set < NAV_NUM_SETS; set++) {
+    nav_bitmap_init(&nav->sets[set], num_cells);
+  }
+  nav->seen = (uint8_t *)mem_alloc(MEM_BOARD, num_cells);
+  nav->open_around = (uint8_t *)mem_alloc(MEM_BOARD, num_cells);
+  nav->flags_around = (uint8_t *)mem_alloc(MEM_BOARD, num_cells);
+}
+
+/* Works out which sets a cell belongs in from its state and its neighbor counts */
+static void nav_update(NavIndex_T *nav, GameBoard_T *board, unsigned int index) {
+  uint8_t state = nav->seen[index];
+  unsigned int count = CELL_NUMBOMBS(board, index);
+  nav_bitmap_assign(&nav->sets[NAV_COVERED], index, state == NAV_CELL_COVERED);
+  nav_bitmap_assign(&nav->sets[NAV_FRONTIER], index, state == NAV_CELL_COVERED && nav->open_around[index]);
+  nav_bitmap_assign(&nav->sets[NAV_UNSATISFIED], index,
+                    state == NAV_CELL_REVEALED && count && !CELL_HASBOMB(board, index) &&
+                        nav->flags_around[index] != count);
+}
+
+#define NAV_NEIGHBOR_CHANGED(board, n)                                                                                 \
+  if ((n) != INVALID_INDEX) {                                                                                          \
+    nav->open_around[n] += open_delta;                                                                                 \
+    nav->flags_around[n] += flag_delta;                                                                                \
+    nav_update(nav, board, n);                                                                                         \
+  }
+
+void nav_cell_changed(NavIndex_T *nav, GameBoard_T *board, unsigned int index) {
+  uint8_t cell = CELL_KNOWN(board, index);
+  uint8_t state = (cell & CELL_UNCOVERED_BIT) ? NAV_CELL_REVEALED
+                  : (cell & CELL_FLAGGED_BIT) ? NAV_CELL_FLAGGED
+                                              : NAV_CELL_COVERED;
+  uint8_t old_state = nav->seen[index];
+  if (state == old_state) {
+    return;
+  }
+  nav->seen[index] = state;
+  nav_update(nav, board, index);
+
+  int open_delta = (state == NAV_CELL_REVEALED) - (old_state == NAV_CELL_REVEALED);
+  int flag_delta = (state == NAV_CELL_FLAGGED) - (old_state == NAV_CELL_FLAGGED);
+  SURROUNDING_CELL_ACTION(board, index, NAV_NEIGHBOR_CHANGED);
+}
+
+/* Starts over from the board as it is, for a new or restored game */
+void nav_rebuild(NavIndex_T *nav, GameBoard_T *board) {
+  for (unsigned int set = 0; set < NAV_NUM_SETS; set++) {
+    nav_bitmap_clear_all(&nav->sets[set]);
+  }
+  memset(nav->seen, NAV_CELL_COVERED, nav->num_cells);
+  memset(nav->open_around, 0, nav->num_cells);
+  memset(nav->flags_around, 0, nav->num_cells);
+  for (unsigned int index = 0; index < nav->num_cells; index++) {
+    nav_bitmap_set(&nav->sets[NAV_COVERED], index);
+  }
+  for (unsigned int index = 0; index < nav->num_cells; index++) {
+    nav_cell_changed(nav, board, index);
+  }
+}
+
+/* The first member of a set after from, wrapping around at the end of the board */
+unsigned int nav_next(NavIndex_T *nav, NavSet_T set, unsigned int from) {
+  unsigned int found = INVALID_INDEX;
+  if (from + 1 < nav->num_cells) {
+    found = nav_bitmap_next(&nav->sets[set], from + 1);
+  }
+  return (found == INVALID_INDEX) ? nav_bitmap_next(&nav->sets[set], 0) : found;
+}
+
+/* The last member of a set before from, wrapping around at the start of the board */
+unsigned int nav_prev(NavIndex_T *nav, NavSet_T set, unsigned int from) {
+  unsigned int found = INVALID_INDEX;
+  if (!nav->num_cells) {
+    return found;
+  }
+  if (from != 0 && from < nav->num_cells) {
+    found = nav_bitmap_prev(&nav->sets[set], from - 1);
+  }
+  return (found == INVALID_INDEX) ? nav_bitmap_prev(&nav->sets[set], nav->num_cells - 1) : found;
+}
+
+/* Moves by whole pages, stopping at the edges of the board. Like the arrow keys, INVALID_INDEX if already there */
+unsigned int nav_page(GameBoard_T *board, unsigned int index, int rows, int cols) {
+  if (!INDEX_ON_BOARD(board, index)) {
+    return INVALID_INDEX;
+  }
+  long row = (long)CELL_ROW(board, index) + rows;
+  long col = (long)CELL_COL(board, index) + cols;
+  row = (row < 0) ? 0 : (row >= board->height) ? board->height - 1 : row;
+  col = (col < 0) ? 0 : (col >= board->width) ? board->width - 1 : col;
+  unsigned int moved = CELL_INDEX(board, (unsigned int)row, (unsigned int)col);
+  return (moved == index) ? INVALID_INDEX : moved;
+}
+
+void nav_exit(NavIndex_T *nav) {
+  for (unsigned int set = 0; set < NAV_NUM_SETS; set++) {
+    nav_bitmap_exit(&nav->sets[set]);
+  }
+  mem_free(nav->seen);
+  mem_free(nav->open_around);
+  mem_free(nav->flags_around);
+  memset(nav, 0, sizeof(NavIndex_T));
+}
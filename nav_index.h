@@ -0,0 +1,66 @@
+#ifndef NAV_INDEX_H
+#define NAV_INDEX_H
+
+#include <stdint.h>
+
+/**
+ * Cursor jump index.
+ *
+ * Keeps the cells the jump keys look for in ordered sets: covered cells, covered cells on the frontier (next to an
+ * uncovered cell) and uncovered numbers whose flags do not match them. Each set is a bitmap with a summary level of
+ * one bit per non-empty word above it, and so on up to a single word, so the next or previous member from any cell is
+ * found in a handful of word scans, O(log64 n), however far away it is.
+ *
+ * Like the minimap it keeps the last state it saw for every cell, along with how many of each cell's neighbors are
+ * uncovered and flagged, so feeding it a cell costs O(1) whatever happened to the cell in between.
+ *
+ * Owned by the logic thread.
+ */
+struct GameBoard;
+
+/* Enough summary levels for any board with an unsigned int cell index */
+#define NAV_MAX_LEVELS 6
+/* Cells moved by the page keys */
+#define NAV_PAGE_ROWS 16
+#define NAV_PAGE_COLS 16
+
+typedef enum NavSet {
+  NAV_COVERED,
+  NAV_FRONTIER,
+  NAV_UNSATISFIED,
+  NAV_NUM_SETS,
+} NavSet_T;
+
+typedef struct NavBitmap {
+  uint64_t *words[NAV_MAX_LEVELS];
+  unsigned int len[NAV_MAX_LEVELS];
+  unsigned int num_levels;
+} NavBitmap_T;
+
+typedef struct NavIndex {
+  unsigned int num_cells;
+  NavBitmap_T sets[NAV_NUM_SETS];
+  uint8_t *seen;
+  uint8_t *open_around;
+  uint8_t *flags_around;
+} NavIndex_T;
+
+/* Nav index prototypes begin */
+
+void nav_init(NavIndex_T *nav, unsigned int num_cells);
+
+void nav_rebuild(NavIndex_T *nav, struct GameBoard *board);
+
+void nav_cell_changed(NavIndex_T *nav, struct GameBoard *board, unsigned int index);
+
+unsigned int nav_next(NavIndex_T *nav, NavSet_T set, unsigned int from);
+
+unsigned int nav_prev(NavIndex_T *nav, NavSet_T set, unsigned int from);
+
+unsigned int nav_page(struct GameBoard *board, unsigned int index, int rows, int cols);
+
+void nav_exit(NavIndex_T *nav);
+
+/* Nav index prototypes end */
+
+#endif /* NAV_INDEX_H */
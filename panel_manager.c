@@ -4,13 +4,16 @@
 #include <panel.h>
 #include <stdlib.h>
 
+#include "mem.h"
+#include "trace.h"
+
 PanelManager_T *pm_init(unsigned int scenes) {
-  PanelManager_T *pm = (PanelManager_T *)calloc(1, sizeof(PanelManager_T));
+  PanelManager_T *pm = (PanelManager_T *)mem_calloc(MEM_PANELS, 1, sizeof(PanelManager_T));
   pm->scene_count = 0;
   pm->scene_capacity = scenes;
   pm->current_scene = 0;
   if (scenes) {
-    pm->scenes = (PanelScene_T **)calloc(scenes, sizeof(PanelScene_T *));
+    pm->scenes = (PanelScene_T **)pm_arena_alloc(pm, scenes * sizeof(PanelScene_T *));
   } else {
     pm->scenes = NULL;
   }
@@ -18,6 +21,22 @@ PanelManager_T *pm_init(unsigned int scenes) {
   return pm;
 }
 
+/* Zeroed memory that lives as long as the manager */
+void *pm_arena_alloc(PanelManager_T *pm, size_t size) {
+  size = (size + 15) & ~(size_t)15;
+  PanelArenaBlock_T *block = pm->arena;
+  if (!block || block->capacity - block->used < size) {
+    size_t capacity = (size > PM_ARENA_BLOCK_SIZE) ? size : PM_ARENA_BLOCK_SIZE;
+    block = (PanelArenaBlock_T *)mem_calloc(MEM_PANELS, 1, sizeof(PanelArenaBlock_T) + capacity);
+    block->capacity = capacity;
+    block->next = pm->arena;
+    pm->arena = block;
+  }
+  void *p = block->data + block->used;
+  block->used += size;
+  return p;
+}
+
 int pm_add_scene(PanelManager_T *pm, PanelScene_T *ps, PanelSceneID id) {
   if (id >= pm->scene_capacity || pm->scenes[id]) {
     return 1;
@@ -61,18 +80,23 @@ void pm_exit(PanelManager_T *pm) {
   /* Free all panels */
   PanelScene_T *scene;
   PM_FOR_EACH_SCENE(pm, scene, pm_scene_exit(scene))
-  free(pm->scenes);
-  pm->scenes = NULL;
-  free(pm);
+
+  PanelArenaBlock_T *block = pm->arena;
+  while (block) {
+    PanelArenaBlock_T *next = block->next;
+    mem_free(block);
+    block = next;
+  }
+  mem_free(pm);
   pm = NULL;
 }
 
-PanelScene_T *pm_scene_init(unsigned int panels) {
-  PanelScene_T *ps = (PanelScene_T *)calloc(1, sizeof(PanelScene_T));
+PanelScene_T *pm_scene_init(PanelManager_T *pm, unsigned int panels) {
+  PanelScene_T *ps = (PanelScene_T *)pm_arena_alloc(pm, sizeof(PanelScene_T));
   ps->panel_count = 0;
   ps->panel_capacity = panels;
   if (panels) {
-    ps->panels = (PanelData_T **)calloc(panels, sizeof(PanelData_T *));
+    ps->panels = (PanelData_T **)pm_arena_alloc(pm, panels * sizeof(PanelData_T *));
   } else {
     ps->panels = NULL;
   }
@@ -82,7 +106,7 @@ PanelScene_T *pm_scene_init(unsigned int panels) {
    * This panel is meant to be the "base" for the other panels in this scene.
    * All other panels will react according to how the background changes (ie: moving, re-sizing, etc)
    */
-  ps->background = pm_panel_init(0, 0, getmaxy(stdscr), getmaxx(stdscr), NULL, NULL, NULL, NULL);
+  ps->background = pm_panel_init(pm, 0, 0, getmaxy(stdscr), getmaxx(stdscr), NULL, NULL, NULL, NULL);
   pm_panel_add_box(ps->background, '|', '-');
   ps->update_stacking_order = 1;
   return ps;
@@ -128,21 +152,21 @@ void pm_scene_draw_all(PanelScene_T *ps, void *opaque) {
   PanelData_T *data;
   pm_scene_update_panel_order(ps);
   PM_FOR_EACH_PANEL(ps, data, pm_panel_draw(data, opaque));
-  doupdate();
+  TRACE_SCOPE("doupdate", doupdate());
 }
 
+/* Scene memory belongs to the manager's arena, this only releases the curses objects */
 void pm_scene_exit(PanelScene_T *ps) {
   PanelData_T *data;
   PM_FOR_EACH_PANEL(ps, data, pm_panel_exit(data));
-  free(ps->panels);
+  pm_panel_exit(ps->background);
   ps->panels = NULL;
-  free(ps);
-  ps = NULL;
+  ps->panel_count = 0;
 }
 
-PanelData_T *pm_panel_init(int y, int x, int height, int width, draw_handler draw, pm_panel_init_cb init_cb,
-                           pm_panel_exit_cb exit_cb, void *user_ptr) {
-  PanelData_T *pd = (PanelData_T *)calloc(1, sizeof(PanelData_T));
+PanelData_T *pm_panel_init(PanelManager_T *pm, int y, int x, int height, int width, draw_handler draw,
+                           pm_panel_init_cb init_cb, pm_panel_exit_cb exit_cb, void *user_ptr) {
+  PanelData_T *pd = (PanelData_T *)pm_arena_alloc(pm, sizeof(PanelData_T));
 
   /* Set the panel's strategies */
   // pd->align = align;
@@ -210,4 +234,17 @@ void pm_panel_add_box(PanelData_T *pd, chtype v, chtype h) {
 //   box_set(panel_window(pd->panel), v, h);
 // }
 
-void pm_panel_exit(PanelData_T *pd) {}
\ No newline at end of file
+/* Drops one scene's reference. The last one deletes the panel and its window */
+void pm_panel_exit(PanelData_T *pd) {
+  if (!pd->panel || --pd->ref_count > 0) {
+    return;
+  }
+
+  WINDOW *win = panel_window(pd->panel);
+  if (pd->exit_cb) {
+    pd->exit_cb((void *)panel_userptr(pd->panel));
+  }
+  del_panel(pd->panel);
+  delwin(win);
+  pd->panel = NULL;
+}
\ No newline at end of file
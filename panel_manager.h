@@ -1,3 +1,8 @@
+#ifndef PANEL_MANAGER_H
+#define PANEL_MANAGER_H
+
+#include <stddef.h>
+
 #include "panel.h"
 
 #define _PM_FOR_EACH(opaque, data, capacity_val, iterate_list, stmts)                                                  \
@@ -85,7 +90,18 @@ typedef struct PanelScene {
   int update_stacking_order;
 } PanelScene_T;
 
+/* Scenes and panels are bump-allocated from blocks owned by their manager and all freed by pm_exit() */
+#define PM_ARENA_BLOCK_SIZE 4096
+
+typedef struct PanelArenaBlock {
+  struct PanelArenaBlock *next;
+  size_t used;
+  size_t capacity;
+  _Alignas(16) unsigned char data[];
+} PanelArenaBlock_T;
+
 typedef struct PanelManager {
+  PanelArenaBlock_T *arena;
   PanelSceneID scene_capacity;
   PanelSceneID scene_count;
   PanelScene_T **scenes;
@@ -95,6 +111,8 @@ typedef struct PanelManager {
 /* Panel Manager prototypes begin */
 PanelManager_T *pm_init(unsigned int scenes);
 
+void *pm_arena_alloc(PanelManager_T *pm, size_t size);
+
 int pm_add_scene(PanelManager_T *pm, PanelScene_T *ps, PanelSceneID id);
 
 PanelScene_T *pm_get_scene(PanelManager_T *pm, PanelSceneID id);
@@ -111,7 +129,7 @@ void pm_exit(PanelManager_T *pm);
 
 /* Panel Scene prototypes begin */
 
-PanelScene_T *pm_scene_init(unsigned int panels);
+PanelScene_T *pm_scene_init(PanelManager_T *pm, unsigned int panels);
 
 int pm_scene_add_panel(PanelScene_T *ps, PanelData_T *pd, PanelDataID id);
 
@@ -129,8 +147,8 @@ void pm_scene_exit(PanelScene_T *pm);
 
 /* Panel Data prototypes begin */
 
-PanelData_T *pm_panel_init(int y, int x, int height, int width, draw_handler draw, pm_panel_init_cb init_cb,
-                           pm_panel_exit_cb exit_cb, void *user_ptr);
+PanelData_T *pm_panel_init(PanelManager_T *pm, int y, int x, int height, int width, draw_handler draw,
+                           pm_panel_init_cb init_cb, pm_panel_exit_cb exit_cb, void *user_ptr);
 
 int pm_panel_get_height(PanelData_T *pd);
 
@@ -153,3 +171,5 @@ void pm_panel_add_box_wide(PanelData_T *pd, chtype *v, chtype *h);
 void pm_panel_exit(PanelData_T *pd);
 
 /* Panel Data prototypes end */
+
+#endif /* PANEL_MANAGER_H */
@@ -0,0 +1,151 @@
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+static const char *PerfPhaseStr[] = {"generate", "flood_fill", "render", "what_if"};
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} PERF_EVENTS[NUM_PERF_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+/* Counters only count the thread that opened them, so each thread measuring a phase opens its own group */
+/* Group leader is fds[0]. -1 means the counter could not be opened */
+static __thread int perf_fds[NUM_PERF_COUNTERS] = {-1, -1, -1, -1, -1};
+static __thread int perf_counting = 0;
+static int perf_enabled = 0;
+static PerfPhaseStats_T perf_phases[NUM_PERF_PHASES];
+
+static uint64_t perf_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd) {
+  return syscall(SYS_perf_event_open, attr, 0 /* this thread */, -1 /* any cpu */, group_fd, 0);
+}
+
+int perf_open(void) {
+  perf_enabled = 1;
+  perf_reset();
+  return perf_open_thread();
+}
+
+int perf_open_thread(void) {
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENTS[c].type;
+    attr.config = PERF_EVENTS[c].config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = (c == 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    perf_fds[c] = perf_event_open(&attr, (c == 0) ? -1 : perf_fds[0]);
+    if (perf_fds[c] < 0) {
+      /* All or nothing: a partial group would give misleading ratios */
+      perf_close();
+      return 1;
+    }
+  }
+
+  ioctl(perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  perf_counting = 1;
+  return 0;
+}
+
+int perf_is_enabled(void) { return perf_enabled; }
+
+int perf_available(void) { return perf_counting; }
+
+static void perf_read(uint64_t *values) {
+  /* PERF_FORMAT_GROUP layout: { nr, values[nr] } */
+  uint64_t buf[1 + NUM_PERF_COUNTERS];
+  if (!perf_counting || read(perf_fds[0], buf, sizeof(buf)) != sizeof(buf)) {
+    memset(values, 0, NUM_PERF_COUNTERS * sizeof(uint64_t));
+    return;
+  }
+  memcpy(values, &buf[1], NUM_PERF_COUNTERS * sizeof(uint64_t));
+}
+
+void perf_begin(PerfPhase_T phase) {
+  if (!perf_enabled) {
+    return;
+  }
+  PerfPhaseStats_T *ps = &perf_phases[phase];
+  ps->start_ns = perf_now_ns();
+  perf_read(ps->start);
+}
+
+void perf_end(PerfPhase_T phase) {
+  if (!perf_enabled) {
+    return;
+  }
+  uint64_t now[NUM_PERF_COUNTERS];
+  perf_read(now);
+
+  PerfPhaseStats_T *ps = &perf_phases[phase];
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+    ps->counts[c] += now[c] - ps->start[c];
+  }
+  ps->wall_ns += perf_now_ns() - ps->start_ns;
+  ps->calls++;
+}
+
+const PerfPhaseStats_T *perf_get_phase(PerfPhase_T phase) { return &perf_phases[phase]; }
+
+void perf_reset(void) { memset(perf_phases, 0, sizeof(perf_phases)); }
+
+void perf_report(FILE *out) {
+  if (!perf_enabled) {
+    return;
+  }
+
+  if (!perf_counting) {
+    fprintf(out, "perf: hardware counters unavailable, reporting wall time only\n");
+  }
+  fprintf(out, "%-11s %8s %12s %14s %14s %6s %12s %12s %12s\n", "phase", "calls", "wall_ms", "cycles",
+          "instructions", "ipc", "br_miss/ki", "llc_miss/ki", "tlb_miss/ki");
+  for (int p = 0; p < NUM_PERF_PHASES; p++) {
+    const PerfPhaseStats_T *ps = &perf_phases[p];
+    if (!ps->calls) {
+      continue;
+    }
+
+    double kinstr = ps->counts[PERF_INSTRUCTIONS] / 1000.0;
+    fprintf(out, "%-11s %8lu %12.3f %14llu %14llu %6.2f %12.3f %12.3f %12.3f\n", PerfPhaseStr[p], ps->calls,
+            ps->wall_ns / 1e6, (unsigned long long)ps->counts[PERF_CYCLES],
+            (unsigned long long)ps->counts[PERF_INSTRUCTIONS],
+            ps->counts[PERF_CYCLES] ? (double)ps->counts[PERF_INSTRUCTIONS] / ps->counts[PERF_CYCLES] : 0.0,
+            kinstr ? ps->counts[PERF_BRANCH_MISSES] / kinstr : 0.0,
+            kinstr ? ps->counts[PERF_CACHE_MISSES] / kinstr : 0.0,
+            kinstr ? ps->counts[PERF_DTLB_MISSES] / kinstr : 0.0);
+  }
+}
+
+void perf_close(void) {
+  for (int c = NUM_PERF_COUNTERS - 1; c >= 0; c--) {
+    if (perf_fds[c] >= 0) {
+      close(perf_fds[c]);
+      perf_fds[c] = -1;
+    }
+  }
+  perf_counting = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Hardware performance counters per engine phase.
+ *
+ * The counters are opened once as a single perf_event group so one read() returns all of them, then read at the
+ * start and end of each phase. Phases accumulate across calls. When perf_event_open is not permitted (see
+ * /proc/sys/kernel/perf_event_paranoid) only wall-clock time is reported.
+ */
+typedef enum PerfCounter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_CACHE_MISSES,
+  PERF_DTLB_MISSES,
+  NUM_PERF_COUNTERS,
+} PerfCounter_T;
+
+typedef enum PerfPhase {
+  PERF_PHASE_GENERATE,
+  PERF_PHASE_FLOOD_FILL,
+  PERF_PHASE_RENDER,
+  PERF_PHASE_WHAT_IF,
+  NUM_PERF_PHASES,
+} PerfPhase_T;
+
+typedef struct PerfPhaseStats {
+  uint64_t counts[NUM_PERF_COUNTERS];
+  uint64_t start[NUM_PERF_COUNTERS];
+  uint64_t wall_ns;
+  uint64_t start_ns;
+  unsigned long calls;
+} PerfPhaseStats_T;
+
+/* Perf prototypes begin */
+
+int perf_open(void);
+
+int perf_open_thread(void);
+
+int perf_is_enabled(void);
+
+int perf_available(void);
+
+void perf_begin(PerfPhase_T phase);
+
+void perf_end(PerfPhase_T phase);
+
+const PerfPhaseStats_T *perf_get_phase(PerfPhase_T phase);
+
+void perf_reset(void);
+
+void perf_report(FILE *out);
+
+void perf_close(void);
+
+/* Perf prototypes end */
+
+#endif /* PERF_H */
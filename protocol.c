@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytes.h"
+#include "mem.h"
+#include "protocol.h"
+
+static const CellAction_T PROTO_ACTIONS_MAP[] = {MOVE, UNCOVER, FLAG, EXIT, CHORD};
+
+/* Appends len bytes to the buffer and returns where they start, or NULL if it cannot grow, leaving it as it was */
+uint8_t *proto_buf_reserve(ProtoBuf_T *buf, size_t len) {
+  if (buf->len + len > buf->capacity) {
+    size_t capacity = buf->capacity ? buf->capacity : 4096;
+    while (capacity < buf->len + len) {
+      capacity *= 2;
+    }
+    uint8_t *data = (uint8_t *)mem_realloc(MEM_NET, buf->data, capacity);
+    if (!data) {
+      return NULL;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+  }
+  uint8_t *p = buf->data + buf->len;
+  buf->len += len;
+  return p;
+}
+
+void proto_buf_consume(ProtoBuf_T *buf, size_t len) {
+  memmove(buf->data, buf->data + len, buf->len - len);
+  buf->len -= len;
+}
+
+void proto_buf_free(ProtoBuf_T *buf) {
+  mem_free(buf->data);
+  memset(buf, 0, sizeof(ProtoBuf_T));
+}
+
+/* Cell change listener, records which cells the next diff has to carry. A change that cannot be recorded makes the
+ * diff carry every cell */
+static void proto_cell_changed(GameBoard_T *board, unsigned int index) {
+  ProtoSession_T *session = (ProtoSession_T *)board->listener;
+  if (session->num_changed == session->changed_capacity) {
+    size_t capacity = session->changed_capacity ? session->changed_capacity * 2 : 256;
+    uint32_t *changed = (uint32_t *)mem_realloc(MEM_NET, session->changed, capacity * sizeof(uint32_t));
+    if (!changed) {
+      session->changes_lost = 1;
+      return;
+    }
+    session->changed = changed;
+    session->changed_capacity = capacity;
+  }
+  session->changed[session->num_changed++] = index;
+}
+
+void proto_session_init(ProtoSession_T *session, GamePool_T *pool) {
+  memset(session, 0, sizeof(ProtoSession_T));
+  session->pool = pool;
+}
+
+void proto_session_exit(ProtoSession_T *session) {
+  if (session->game) {
+    game_pool_release(session->pool, session->game);
+  }
+  mem_free(session->changed);
+  mem_free(session->ops);
+  memset(session, 0, sizeof(ProtoSession_T));
+}
+
+/* Returns where the reply's body goes, or NULL if out cannot hold it */
+static uint8_t *proto_reply(ProtoBuf_T *out, ProtoOpcode_T opcode, size_t body_len) {
+  uint8_t *p = proto_buf_reserve(out, PROTO_FRAME_HEADER + body_len);
+  if (!p) {
+    return NULL;
+  }
+  put_u32(p, 1 + body_len);
+  p[4] = opcode;
+  return p + PROTO_FRAME_HEADER;
+}
+
+/* Returns 1 if out cannot hold the reply */
+static int proto_reply_error(ProtoBuf_T *out, ProtoError_T error) {
+  uint8_t *p = proto_reply(out, PROTO_ERROR, 1);
+  if (!p) {
+    return 1;
+  }
+  *p = error;
+  return 0;
+}
+
+/* Replies with the listed cells, or with every cell when indices is NULL. Returns 1 if out cannot hold the reply */
+static int proto_reply_diff(GameBoard_T *board, const uint32_t *indices, size_t count, ProtoBuf_T *out) {
+  uint8_t *p = proto_reply(out, PROTO_DIFF, PROTO_DIFF_HEADER + count * PROTO_DIFF_ENTRY);
+  if (!p) {
+    return 1;
+  }
+  p[0] = board->game_state;
+  put_u32(p + 1, board->remaining_open_cells);
+  put_u32(p + 5, board->num_flags);
+  p += PROTO_DIFF_HEADER;
+  for (size_t ii = 0; ii < count; ii++, p += PROTO_DIFF_ENTRY) {
+    uint32_t index = indices ? indices[ii] : ii;
+    put_u32(p, index);
+    p[4] = proto_visible_cell(CELL_KNOWN(board, index));
+  }
+  return 0;
+}
+
+/* Handlers reply to one request each. They return 1 if out cannot hold the reply */
+static int proto_handle_new(ProtoSession_T *session, const uint8_t *body, size_t len, ProtoBuf_T *out) {
+  if (len != 16) {
+    return proto_reply_error(out, PROTO_ERR_BAD_REQUEST);
+  }
+  uint32_t rows = get_u32(body), columns = get_u32(body + 4), bombs = get_u32(body + 8);
+  uint64_t cells = (uint64_t)rows * columns;
+  if (!rows || !columns || cells > PROTO_MAX_CELLS || (uint64_t)bombs + 9 > cells) {
+    return proto_reply_error(out, PROTO_ERR_BAD_BOARD);
+  }
+
+  /* The old game is only given up once the new one has a board */
+  GameBoard_T *board = game_pool_acquire(session->pool, rows, columns);
+  if (!board) {
+    return proto_reply_error(out, PROTO_ERR_NO_MEMORY);
+  }
+  if (session->game) {
+    game_pool_release(session->pool, session->game);
+  }
+  board->num_bombs = bombs;
+  board->seed = get_u32(body + 12);
+  board->generator = BOARD_GENERATOR_RAND;
+  board->game_state = TURNS;
+  board->listener = session;
+  board->on_cell_change = proto_cell_changed;
+  session->game = board;
+  return proto_reply_diff(board, NULL, 0, out);
+}
+
+static int proto_handle_actions(ProtoSession_T *session, const uint8_t *body, size_t len, ProtoBuf_T *out) {
+  GameBoard_T *board = session->game;
+  if (!board) {
+    return proto_reply_error(out, PROTO_ERR_NO_GAME);
+  }
+  if (len % PROTO_OP_SIZE) {
+    return proto_reply_error(out, PROTO_ERR_BAD_REQUEST);
+  }
+
+  size_t count = len / PROTO_OP_SIZE;
+  if (count > session->ops_capacity) {
+    CellOp_T *ops = (CellOp_T *)mem_realloc(MEM_NET, session->ops, count * sizeof(CellOp_T));
+    if (!ops) {
+      return 1;
+    }
+    session->ops = ops;
+    session->ops_capacity = count;
+  }
+  for (size_t ii = 0; ii < count; ii++, body += PROTO_OP_SIZE) {
+    session->ops[ii].action = (body[0] <= PROTO_OP_CHORD) ? PROTO_ACTIONS_MAP[body[0]] : NONE;
+    session->ops[ii].index = get_u32(body + 1);
+  }
+
+  session->num_changed = 0;
+  session->changes_lost = 0;
+  /* A batch whose opening did not fit in memory leaves the game half revealed, so the client is dropped */
+  if (board->game_state == TURNS && apply_cell_actions(board, session->ops, count)) {
+    return 1;
+  }
+  if (session->changes_lost) {
+    return proto_reply_diff(board, NULL, board->height * board->width, out);
+  }
+  return proto_reply_diff(board, session->changed, session->num_changed, out);
+}
+
+/**
+ * Handles every complete frame in `in`, appending one reply per frame to `out`. Stops early once `out` holds
+ * out_limit bytes so a client that does not read cannot make the reply buffer grow without bound.
+ * Returns the number of bytes consumed, or -1 if the stream is not valid framing or a reply does not fit in memory, and
+ * the client should be dropped.
+ */
+ssize_t proto_session_feed(ProtoSession_T *session, const uint8_t *in, size_t len, ProtoBuf_T *out,
+                           size_t out_limit) {
+  size_t pos = 0;
+  while (len - pos >= PROTO_FRAME_HEADER && out->len < out_limit) {
+    uint32_t frame_len = get_u32(in + pos);
+    if (!frame_len || frame_len > PROTO_MAX_FRAME) {
+      return -1;
+    }
+    if (len - pos - 4 < frame_len) {
+      break;
+    }
+
+    const uint8_t *body = in + pos + PROTO_FRAME_HEADER;
+    size_t body_len = frame_len - 1;
+    int failed;
+    switch (in[pos + 4]) {
+    case PROTO_NEW:
+      failed = proto_handle_new(session, body, body_len, out);
+      break;
+
+    case PROTO_ACTIONS:
+      failed = proto_handle_actions(session, body, body_len, out);
+      break;
+
+    case PROTO_STATE:
+      if (session->game) {
+        failed = proto_reply_diff(session->game, NULL, session->game->height * session->game->width, out);
+      } else {
+        failed = proto_reply_error(out, PROTO_ERR_NO_GAME);
+      }
+      break;
+
+    default:
+      failed = proto_reply_error(out, PROTO_ERR_BAD_REQUEST);
+      break;
+    }
+    if (failed) {
+      return -1;
+    }
+    pos += 4 + frame_len;
+  }
+  return pos;
+}
@@ -0,0 +1,103 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "game_pool.h"
+#include "minesweeper.h"
+
+/**
+ * Binary game protocol (little endian), used by the game server.
+ *
+ *   Frame
+ *     u32 length of what follows (opcode + body)
+ *     u8  opcode
+ *     body
+ *
+ *   Requests
+ *     PROTO_NEW      u32 rows, u32 cols, u32 bombs, u32 seed. Replaces the session's game
+ *     PROTO_ACTIONS  repeated { u8 action (PROTO_OP_*), u32 cell index }, applied as one batch
+ *     PROTO_STATE    empty. Asks for every cell
+ *
+ *   Replies, one per request and in request order, so clients may pipeline
+ *     PROTO_DIFF     u8 game state (GameState_T), u32 remaining_open_cells, u32 num_flags,
+ *                    then repeated { u32 cell index, u8 cell } for the cells that changed
+ *     PROTO_ERROR    u8 error code (PROTO_ERR_*)
+ *
+ * Cells are sent as the player sees them: covered cells only carry the flag bit. A cell may appear more than once in
+ * a diff; the last entry wins.
+ */
+#define PROTO_MAX_FRAME (1u << 20)
+#define PROTO_MAX_CELLS (1u << 24)
+#define PROTO_FRAME_HEADER 5
+#define PROTO_OP_SIZE 5
+#define PROTO_DIFF_HEADER 9
+#define PROTO_DIFF_ENTRY 5
+
+typedef enum ProtoOpcode {
+  PROTO_NEW = 0x01,
+  PROTO_ACTIONS = 0x02,
+  PROTO_STATE = 0x03,
+  PROTO_DIFF = 0x81,
+  PROTO_ERROR = 0xff,
+} ProtoOpcode_T;
+
+typedef enum ProtoOp {
+  PROTO_OP_MOVE = 0,
+  PROTO_OP_UNCOVER = 1,
+  PROTO_OP_FLAG = 2,
+  PROTO_OP_EXIT = 3,
+  PROTO_OP_CHORD = 4,
+} ProtoOp_T;
+
+typedef enum ProtoError {
+  PROTO_ERR_NO_GAME = 1,
+  PROTO_ERR_BAD_BOARD = 2,
+  PROTO_ERR_BAD_REQUEST = 3,
+  PROTO_ERR_NO_MEMORY = 4,
+} ProtoError_T;
+
+typedef struct ProtoBuf {
+  uint8_t *data;
+  size_t len;
+  size_t capacity;
+} ProtoBuf_T;
+
+/* One client's game plus the scratch space used to answer it */
+typedef struct ProtoSession {
+  GamePool_T *pool;
+  GameBoard_T *game;
+  uint32_t *changed;
+  size_t num_changed;
+  size_t changed_capacity;
+  /* Set when a change could not be recorded, so the diff has to carry every cell */
+  int changes_lost;
+  CellOp_T *ops;
+  size_t ops_capacity;
+} ProtoSession_T;
+
+static inline uint8_t proto_visible_cell(uint8_t cell) {
+  return (cell & CELL_UNCOVERED_BIT) ? (cell & (CELL_UNCOVERED_BIT | CELL_HASBOMB_BIT | CELL_NUMBOMBS_BITS))
+                                     : (cell & CELL_FLAGGED_BIT);
+}
+
+/* Protocol prototypes begin */
+
+uint8_t *proto_buf_reserve(ProtoBuf_T *buf, size_t len);
+
+void proto_buf_consume(ProtoBuf_T *buf, size_t len);
+
+void proto_buf_free(ProtoBuf_T *buf);
+
+void proto_session_init(ProtoSession_T *session, GamePool_T *pool);
+
+void proto_session_exit(ProtoSession_T *session);
+
+ssize_t proto_session_feed(ProtoSession_T *session, const uint8_t *in, size_t len, ProtoBuf_T *out,
+                           size_t out_limit);
+
+/* Protocol prototypes end */
+
+#endif /* PROTOCOL_H */
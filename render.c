@@ -0,0 +1,373 @@
+#include <curses.h>
+#include <panel.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "minesweeper.h"
+#include "perf.h"
+#include "render.h"
+#include "trace.h"
+
+void print_headers(struct PanelData *self, void *opaque) {
+  GameBoard_T *board = (GameBoard_T *)opaque;
+  WINDOW *win = panel_window(self->panel);
+  wmove(win, 1, 1);
+  // waddstr(win, GameStateStr[board->game_state]);
+  // waddstr(win, "   ");
+  wprintw(win, "%03d", board->render.num_flags);
+
+  /* Between games the header says how to go on */
+  int hint_len = strlen(GAME_OVER_HINT);
+  wmove(win, 1, (pm_panel_get_width(self) - hint_len) / 2);
+  wprintw(win, "%-*s", hint_len, (board->game_state == TURNS) ? "" : GAME_OVER_HINT);
+
+  wmove(win, 1, pm_panel_get_width(self) - 3);
+  wprintw(win, "%03d", board->render.seconds_elapsed);
+  wrefresh(win);
+}
+
+void print_cell_contents(WINDOW *win, uint8_t cell, int selected) {
+  if (cell & CELL_UNCOVERED_BIT) {
+    int bombs = cell & CELL_NUMBOMBS_BITS;
+    if (cell & CELL_HASBOMB_BIT) {
+      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_HASBOMB_DISPLAY), waddstr(win, CELL_HASBOMB_STR));
+    } else if (selected) {
+      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_SELECTED_COVERED_DISPLAY) | A_BOLD,
+                            wprintw(win, CELL_SELECTED_STR, (bombs) ? bombs + '0' : ' '));
+    } else {
+      CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(bombs + 10) | A_BOLD, wprintw(win, CELL_UNCOVERED_STR, bombs + '0'););
+    }
+  } else if (selected) {
+    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_SELECTED_UNCOVERED_DISPLAY), waddstr(win, CELL_COVERED_STR));
+  } else if (cell & CELL_FLAGGED_BIT) {
+    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_FLAGGED_DISPLAY), waddstr(win, CELL_FLAGGED_STR));
+
+#ifdef DEBUG
+  } else if (cell & CELL_HASBOMB_BIT) {
+    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_HASBOMB_DISPLAY), waddstr(win, CELL_HASBOMB_STR));
+#endif
+  } else {
+    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(CELL_COVERED_DISPLAY), waddstr(win, CELL_COVERED_STR));
+  }
+}
+
+/* The logic thread may be writing the board, read cells that did not come with an event one byte at a time */
+static inline uint8_t render_read_cell(GameBoard_T *board, unsigned int index) {
+  return __atomic_load_n(&CELL_KNOWN(board, index), __ATOMIC_RELAXED);
+}
+
+static void print_cell_at(WINDOW *win, GameBoard_T *board, unsigned int index, uint8_t cell) {
+  wmove(win, CELL_ROW_CURSOR(board, index) + 1, CELL_COL_CURSOR(board, index) + 1);
+  print_cell_contents(win, cell, index == board->render.cursor);
+  minimap_cell_changed(&board->render.minimap, index, cell);
+}
+
+void print_board(struct PanelData *self, void *opaque) {
+  GameBoard_T *board = (GameBoard_T *)opaque;
+  RenderState_T *rs = &board->render;
+  WINDOW *win = panel_window(self->panel);
+  TRACE_BEGIN("print_board");
+  if (rs->full_refresh || board->refresh_board_print) {
+    for (unsigned int index = 0; index < board->height * board->width; index++) {
+      print_cell_at(win, board, index, render_read_cell(board, index));
+    }
+    rs->full_refresh = 0;
+  } else {
+    /* Events are in program order, so a cell changed twice in one batch ends up with its last value */
+    for (unsigned int ii = 0; ii < rs->batch_len; ii++) {
+      print_cell_at(win, board, rs->batch[ii].index, rs->batch[ii].value);
+    }
+  }
+  rs->batch_len = 0;
+  wnoutrefresh(win);
+  TRACE_END("print_board");
+}
+
+/* Redraws the minimap characters that print_board() changed, so it has to come after the board in the scene */
+void print_minimap(struct PanelData *self, void *opaque) {
+  GameBoard_T *board = (GameBoard_T *)opaque;
+  MiniMap_T *mm = &board->render.minimap;
+  WINDOW *win = panel_window(self->panel);
+  minimap_set_cursor(mm, board->render.cursor);
+  for (unsigned int ii = 0; ii < mm->num_dirty; ii++) {
+    unsigned int ch = mm->dirty[ii];
+    int has_flags;
+    uint8_t dots = minimap_dots(mm, ch, &has_flags);
+    /* U+2800 plus the dot pattern, in UTF-8 */
+    char glyph[4] = {(char)0xe2, (char)(0xa0 | dots >> 6), (char)(0x80 | (dots & 0x3f)), 0};
+    unsigned int pair = (ch == mm->cursor) ? CELL_SELECTED_COVERED_DISPLAY
+                        : has_flags        ? CELL_FLAGGED_DISPLAY
+                                           : CELL_COVERED_DISPLAY;
+    wmove(win, ch / mm->cols + 1, ch % mm->cols + 1);
+    CELL_PRINT_WITH_ATTRS(win, COLOR_PAIR(pair), waddstr(win, glyph));
+    mm->is_dirty[ch] = 0;
+  }
+  mm->num_dirty = 0;
+  wnoutrefresh(win);
+}
+
+void print_debug_box(struct PanelData *self, void *opaque) {
+  GameBoard_T *board = (GameBoard_T *)opaque;
+  WINDOW *win = panel_window(self->panel);
+  wmove(win, 1, 1);
+  unsigned int index = board->render.cursor;
+  uint8_t cell = INDEX_ON_BOARD(board, index) ? render_read_cell(board, index) : DEFAULT_CELL;
+  wprintw(win, "Current index: %d [%d,%d]", index, CELL_ROW(board, index), CELL_COL(board, index));
+  wmove(win, 2, 1);
+  wprintw(win, "\tnum_bombs=%d\n\thas_bomb=%d\n\tuncovered=%d\n\tflagged=%d", cell & CELL_NUMBOMBS_BITS,
+          (cell & CELL_HASBOMB_BIT) >> 4, (cell & CELL_UNCOVERED_BIT) >> 5, (cell & CELL_FLAGGED_BIT) >> 6);
+  ComponentCache_T *cache = &board->analysis.cache;
+  wmove(win, 6, 1);
+  wprintw(win, "component cache: %lu/%lu hits", atomic_load_explicit(&cache->hits, memory_order_relaxed),
+          atomic_load_explicit(&cache->lookups, memory_order_relaxed));
+  wmove(win, 7, 1);
+  wprintw(win, "live KiB:");
+  for (int t = 0; t < NUM_MEM_TAGS; t++) {
+    MemStats_T stats;
+    mem_get_stats((MemTag_T)t, &stats);
+    wprintw(win, " %s %zu", mem_tag_name((MemTag_T)t), (stats.live + 1023) / 1024);
+  }
+#ifdef TRACE
+  TraceSummary_T summary;
+  trace_summary(&summary);
+  wmove(win, 8, 1);
+  wprintw(win, "frame p50/p99: %.2f/%.2f ms", summary.frame_p50_ns / 1e6, summary.frame_p99_ns / 1e6);
+  wmove(win, 9, 1);
+  wprintw(win, "input p50/p99: %.2f/%.2f ms", summary.latency_p50_ns / 1e6, summary.latency_p99_ns / 1e6);
+#endif
+  wrefresh(win);
+}
+
+/* Logic thread: forwards engine cell changes to the render thread */
+void render_cell_changed(GameBoard_T *board, unsigned int index) {
+  ev_ring_push(board->render.events, EV_CELL, index, CELL_KNOWN(board, index));
+}
+
+void render_batch_add(RenderState_T *rs, uint32_t index, uint32_t value) {
+  if (rs->full_refresh) {
+    return;
+  }
+  if (rs->batch_len == rs->batch_capacity) {
+    rs->full_refresh = 1;
+    return;
+  }
+  CellEvent_T *ev = &rs->batch[rs->batch_len++];
+  ev->type = EV_CELL;
+  ev->index = index;
+  ev->value = value;
+}
+
+/* Repaints the old and new cursor cells with whatever they hold now */
+void render_move_cursor(GameBoard_T *board, unsigned int index) {
+  RenderState_T *rs = &board->render;
+  unsigned int old_cursor = rs->cursor;
+  rs->cursor = index;
+  if (INDEX_ON_BOARD(board, old_cursor)) {
+    render_batch_add(rs, old_cursor, render_read_cell(board, old_cursor));
+  }
+  if (INDEX_ON_BOARD(board, rs->cursor)) {
+    render_batch_add(rs, rs->cursor, render_read_cell(board, rs->cursor));
+  }
+}
+
+/**
+ * Moves everything published so far into the render state. A batch that outgrows its buffer, or a ring that
+ * dropped events, turns into a full redraw.
+ */
+void render_drain(GameBoard_T *board) {
+  RenderState_T *rs = &board->render;
+  CellEvent_T ev;
+  while (ev_ring_pop(rs->events, &ev)) {
+    switch (ev.type) {
+    case EV_CELL:
+      render_batch_add(rs, ev.index, ev.value);
+      break;
+
+    case EV_CURSOR:
+      render_move_cursor(board, ev.index);
+      break;
+
+    case EV_HEADER:
+      rs->num_flags = ev.index;
+      rs->seconds_elapsed = ev.value;
+      break;
+
+    case EV_REFRESH:
+    default:
+      rs->full_refresh = 1;
+      break;
+    }
+  }
+  if (ev_ring_take_overflow(rs->events)) {
+    rs->full_refresh = 1;
+  }
+}
+
+/* Presents everything published so far: one frame */
+void render_frame(GameBoard_T *board) {
+  RenderState_T *rs = &board->render;
+  render_drain(board);
+  spectate_frame(&rs->broadcast, board, rs->full_refresh);
+  TRACE_FRAME_BEGIN();
+  perf_begin(PERF_PHASE_RENDER);
+  TRACE_SCOPE("pm_scene_draw_all", pm_scene_draw_all(board->active_scene, (void *)board));
+  perf_end(PERF_PHASE_RENDER);
+  TRACE_FRAME_END();
+}
+
+void *render_thread(void *opaque) {
+  GameBoard_T *board = (GameBoard_T *)opaque;
+  RenderState_T *rs = &board->render;
+  if (perf_is_enabled()) {
+    perf_open_thread();
+  }
+
+  while (ev_ring_wait(rs->events)) {
+    render_frame(board);
+  }
+  perf_close();
+  return NULL;
+}
+
+/* Starts the render state over for a new game on the same board, reusing its buffers */
+void render_reset(GameBoard_T *board) {
+  RenderState_T *rs = &board->render;
+  ev_ring_reset(rs->events);
+  rs->batch_len = 0;
+  rs->cursor = board->curr_index;
+  rs->num_flags = board->num_flags;
+  rs->seconds_elapsed = board->seconds_elapsed;
+  rs->full_refresh = 1;
+}
+
+void render_init(GameBoard_T *board) {
+  RenderState_T *rs = &board->render;
+  rs->events = ev_ring_init(RENDER_RING_CAPACITY_LOG2);
+  rs->batch_capacity = RENDER_BATCH_CAPACITY;
+  rs->batch = (CellEvent_T *)mem_calloc(MEM_PANELS, rs->batch_capacity, sizeof(CellEvent_T));
+  render_reset(board);
+}
+
+void render_exit(GameBoard_T *board) {
+  RenderState_T *rs = &board->render;
+  if (!rs->events) {
+    return;
+  }
+  ev_ring_exit(rs->events);
+  mem_free(rs->batch);
+  minimap_exit(&rs->minimap);
+  spectate_writer_close(&rs->broadcast);
+  memset(rs, 0, sizeof(RenderState_T));
+}
+
+static void gameboard_scene_init(GameBoard_T *board, int rows, int columns) {
+  /* Odd rows of a hex board sit a character to the right, see CELL_COL_CURSOR */
+  int board_width = columns * CELL_STR_LEN + (board->topology.kind == TOPOLOGY_HEX);
+  int yalign = getmaxy(stdscr) / 2 - rows / 2;
+  int xalign = getmaxx(stdscr) / 2 - board_width / 2;
+
+  PanelScene_T *ps = pm_scene_init(board->pm, 4);
+  pm_add_scene(board->pm, ps, GAMEBOARD_SCENE_ID);
+
+  PanelData_T *pd;
+  pd = pm_panel_init(board->pm, 1, 1, 3, pm_panel_get_width(ps->background), print_headers, NULL, NULL, NULL);
+  pm_panel_add_border(pd, ' ', ' ', '*', '*', '*', '*', '*', '*');
+  pm_scene_add_panel(ps, pd, 0);
+  pd = pm_panel_init(board->pm, yalign, xalign, rows + 2, board_width + 2, print_board, NULL, NULL, NULL);
+  pm_panel_add_border(pd, '#', '#', '#', '#', '#', '#', '#', '#');
+  pm_scene_add_panel(ps, pd, 1);
+
+  /* The minimap goes beside the board, on the right if there is room, and is left out if it fits on neither side */
+  MiniMap_T *mm = &board->render.minimap;
+  minimap_init(mm, rows, columns);
+  int map_x = xalign + board_width + 3;
+  if (map_x + (int)mm->cols + 2 > getmaxx(stdscr)) {
+    map_x = xalign - (int)mm->cols - 3;
+  }
+  if (map_x >= 0) {
+    pd = pm_panel_init(board->pm, yalign, map_x, mm->rows + 2, mm->cols + 2, print_minimap, NULL, NULL, NULL);
+    pm_panel_add_border(pd, '#', '#', '#', '#', '#', '#', '#', '#');
+    pm_scene_add_panel(ps, pd, 2);
+  }
+#ifdef DEBUG
+  pd = pm_panel_init(board->pm, yalign + rows + 2, xalign, DEBUG_BOX_HEIGHT, board_width + 2,
+                     print_debug_box, NULL, NULL, NULL);
+  pm_scene_add_panel(ps, pd, 3);
+#endif
+}
+
+static void explode_scene_init(GameBoard_T *board) {
+  PanelScene_T *ps = pm_scene_init(board->pm, 1);
+  pm_add_scene(board->pm, ps, LOOSE_SCENE_ID);
+
+  PanelData_T *pd;
+  unsigned int yalign = pm_panel_get_height(ps->background) / 2 - EXPLODE_SCENE_HEIGHT / 2;
+  unsigned int xalign = pm_panel_get_width(ps->background) / 2 - EXPLODE_SCENE_WIDTH / 2;
+  pd = pm_panel_init(board->pm, yalign, xalign, EXPLODE_SCENE_HEIGHT + 1, EXPLODE_SCENE_WIDTH + 1,
+                     print_explode_sequence, NULL, NULL, NULL);
+  pm_scene_add_panel(ps, pd, 0);
+}
+
+/**
+ * Sets up colors and scenes on the current curses screen. Returns 1 if the screen is too small for the board.
+ */
+int render_setup(GameBoard_T *board, unsigned int rows, unsigned int columns) {
+  /* Use the stdscr as a base and validate we can fit the gameboard */
+  int maxy = getmaxy(stdscr);
+  int maxx = getmaxx(stdscr);
+  if (!maxx || !maxy || maxy < 5 + rows || maxx < 2 + columns) {
+    return 1;
+  }
+
+  /* Setup colors */
+  start_color();
+  init_color(CELL_COLOR_ZERO_SURROUNDING, 753, 753, 753);
+  init_color(CELL_COLOR_ONE_SURROUNDING, 4, 0, 996);
+  init_color(CELL_COLOR_TWO_SURROUNDING, 4, 498, 4);
+  init_color(CELL_COLOR_THREE_SURROUNDING, 996, 0, 0);
+  init_color(CELL_COLOR_FOUR_SURROUNDING, 4, 0, 502);
+  init_color(CELL_COLOR_FIVE_SURROUNDING, 506, 4, 8);
+  init_color(CELL_COLOR_SIX_SURROUNDING, 0, 502, 506);
+  init_color(CELL_COLOR_SEVEN_SURROUNDING, 0, 0, 0);
+  init_color(CELL_COLOR_EIGHT_SURROUNDING, 502, 502, 502);
+
+  init_color(CELL_COLOR_SELECTED_COVERED, 689, 980, 681);
+  init_color(CELL_COLOR_SELECTED_UNCOVERED, 689, 980, 681);
+  init_color(CELL_COLOR_COVERED, 502, 502, 502);
+  init_color(CELL_COLOR_FLAGGED, 626, 643, 113);
+  init_color(CELL_COLOR_UNCOVERED, 753, 753, 753);
+  init_color(CELL_COLOR_HASBOMB, 681, 68, 68);
+#ifdef DEBUG
+  // init_color(CELL_COLOR_BACKTRACKED, );
+#endif
+
+  init_pair(CELL_SELECTED_COVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_SELECTED_COVERED);
+  init_pair(CELL_SELECTED_UNCOVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_SELECTED_UNCOVERED);
+  init_pair(CELL_COVERED_DISPLAY, COLOR_BLACK, CELL_COLOR_COVERED);
+  init_pair(CELL_FLAGGED_DISPLAY, COLOR_BLACK, CELL_COLOR_FLAGGED);
+  init_pair(CELL_HASBOMB_DISPLAY, COLOR_BLACK, CELL_COLOR_HASBOMB);
+#ifdef DEBUG
+  init_pair(CELL_BACKTRACKED_DISPLAY, COLOR_WHITE, COLOR_CYAN);
+#endif
+
+  init_pair(CELL_ZERO_SURROUNDING_DISPLAY, CELL_COLOR_UNCOVERED, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_ONE_SURROUNDING_DISPLAY, CELL_COLOR_ONE_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_TWO_SURROUNDING_DISPLAY, CELL_COLOR_TWO_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_THREE_SURROUNDING_DISPLAY, CELL_COLOR_THREE_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_FOUR_SURROUNDING_DISPLAY, CELL_COLOR_FOUR_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_FIVE_SURROUNDING_DISPLAY, CELL_COLOR_FIVE_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_SIX_SURROUNDING_DISPLAY, CELL_COLOR_SIX_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_SEVEN_SURROUNDING_DISPLAY, CELL_COLOR_SEVEN_SURROUNDING, CELL_COLOR_UNCOVERED);
+  init_pair(CELL_EIGHT_SURROUNDING_DISPLAY, CELL_COLOR_EIGHT_SURROUNDING, CELL_COLOR_UNCOVERED);
+
+  /* Create panel manager and scenes */
+  board->pm = pm_init(NUM_SCENES);
+  gameboard_scene_init(board, rows, columns);
+  explode_scene_init(board);
+
+  /* Switch to the gameboard scene first */
+  board->active_scene = pm_switch_scene(board->pm, GAMEBOARD_SCENE_ID);
+  return 0;
+}
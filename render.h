@@ -0,0 +1,41 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+
+#include "minesweeper.h"
+
+/**
+ * Terminal rendering.
+ *
+ * While a game runs the render thread owns curses. The logic thread publishes cell, cursor and header changes on the
+ * event ring, and each frame drains them into a batch and redraws only the cells in it, or the whole board when the
+ * batch or the ring overflowed. Everything here also runs on its own, given a curses screen, which is how
+ * minesweeper-render-bench measures it.
+ */
+
+/* Render prototypes begin */
+
+int render_setup(GameBoard_T *board, unsigned int rows, unsigned int columns);
+
+void render_init(GameBoard_T *board);
+
+void render_reset(GameBoard_T *board);
+
+void render_exit(GameBoard_T *board);
+
+void render_cell_changed(GameBoard_T *board, unsigned int index);
+
+void render_batch_add(RenderState_T *rs, uint32_t index, uint32_t value);
+
+void render_move_cursor(GameBoard_T *board, unsigned int index);
+
+void render_drain(GameBoard_T *board);
+
+void render_frame(GameBoard_T *board);
+
+void *render_thread(void *opaque);
+
+/* Render prototypes end */
+
+#endif /* RENDER_H */
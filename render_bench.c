@@ -0,0 +1,294 @@
+#include <curses.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "minesweeper.h"
+#include "perf.h"
+#include "render.h"
+
+/**
+ * Headless render benchmark.
+ *
+ * Runs the game's renderer against a pseudo-terminal. Curses is started with newterm() on the slave side of an
+ * openpty() pair sized to fit the board, while a thread drains the master side the way a terminal emulator would.
+ * Each scenario plays a fixed script and presents a frame after every step with render_frame(), as the render thread
+ * does, recording the frame's CPU time and the write() calls and bytes it sent to the terminal.
+ *
+ *   sweep    the cursor visits every cell of an opened board, row by row and back
+ *   opening  a sparse board is opened from the center, revealed in the game's time slices
+ *   reveal   the whole board is uncovered and redrawn at once, as at the end of a game
+ */
+#define RENDER_BENCH_TERM "xterm-256color"
+#define RENDER_BENCH_REVEALS 16
+/* Board sizes measured when none are given */
+static const char *RENDER_BENCH_SIZES[] = {"9x9/10", "16x30/99", "50x100/1000", "100x200/4000"};
+
+typedef struct FrameStats {
+  uint64_t *cpu_ns;
+  uint64_t writes;
+  uint64_t bytes;
+  unsigned int len;
+  unsigned int capacity;
+} FrameStats_T;
+
+typedef struct BenchTerm {
+  int master;
+  int slave;
+  FILE *out;
+  FILE *in;
+  SCREEN *screen;
+  pthread_t drain;
+  /* This thread's counters in /proc/thread-self/io */
+  int io;
+} BenchTerm_T;
+
+static void *drain_master(void *opaque) {
+  BenchTerm_T *term = (BenchTerm_T *)opaque;
+  char buf[1 << 16];
+  while (read(term->master, buf, sizeof(buf)) > 0) {
+  }
+  return NULL;
+}
+
+static uint64_t thread_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* write() calls and bytes written by this thread so far */
+static void thread_io(BenchTerm_T *term, uint64_t *writes, uint64_t *bytes) {
+  char buf[512];
+  ssize_t len = pread(term->io, buf, sizeof(buf) - 1, 0);
+  *writes = *bytes = 0;
+  if (len <= 0) {
+    return;
+  }
+  buf[len] = 0;
+  char *field;
+  if ((field = strstr(buf, "syscw:"))) {
+    *writes = strtoull(field + 6, NULL, 10);
+  }
+  if ((field = strstr(buf, "wchar:"))) {
+    *bytes = strtoull(field + 6, NULL, 10);
+  }
+}
+
+static int term_open(BenchTerm_T *term, unsigned int rows, unsigned int cols, const char *type) {
+  /* Room for the header, the board and the minimap beside it */
+  struct winsize ws = {.ws_row = rows + 8, .ws_col = cols * CELL_STR_LEN + cols / 2 + 16};
+  memset(term, 0, sizeof(BenchTerm_T));
+  if (openpty(&term->master, &term->slave, NULL, NULL, &ws)) {
+    return 1;
+  }
+  term->out = fdopen(dup(term->slave), "w");
+  term->in = fdopen(dup(term->slave), "r");
+  term->io = open("/proc/thread-self/io", O_RDONLY);
+  pthread_create(&term->drain, NULL, drain_master, term);
+
+  /* The size comes from the pty, not from the environment of whoever runs the benchmark */
+  unsetenv("LINES");
+  unsetenv("COLUMNS");
+  term->screen = newterm(type, term->out, term->in);
+  if (!term->screen) {
+    return 1;
+  }
+  set_term(term->screen);
+  cbreak();
+  noecho();
+  return 0;
+}
+
+static void term_close(BenchTerm_T *term) {
+  if (term->screen) {
+    endwin();
+    delscreen(term->screen);
+  }
+  fclose(term->out);
+  fclose(term->in);
+  close(term->slave);
+  /* Reads on the master fail once the slave is gone, which ends the drain thread */
+  pthread_join(term->drain, NULL);
+  close(term->master);
+  if (term->io >= 0) {
+    close(term->io);
+  }
+}
+
+/* Publishes what the script did and presents it as one measured frame */
+static void bench_frame(BenchTerm_T *term, GameBoard_T *board, FrameStats_T *stats) {
+  uint64_t writes, bytes, end_writes, end_bytes;
+  ev_ring_publish(board->render.events);
+  thread_io(term, &writes, &bytes);
+  uint64_t start = thread_cpu_ns();
+  render_frame(board);
+  uint64_t cpu = thread_cpu_ns() - start;
+  thread_io(term, &end_writes, &end_bytes);
+
+  if (stats->len == stats->capacity) {
+    stats->capacity = stats->capacity ? stats->capacity * 2 : 1024;
+    stats->cpu_ns = (uint64_t *)realloc(stats->cpu_ns, stats->capacity * sizeof(uint64_t));
+  }
+  stats->cpu_ns[stats->len++] = cpu;
+  stats->writes += end_writes - writes;
+  stats->bytes += end_bytes - bytes;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void report(const char *scenario, FrameStats_T *stats) {
+  if (!stats->len) {
+    return;
+  }
+  uint64_t total = 0;
+  for (unsigned int ii = 0; ii < stats->len; ii++) {
+    total += stats->cpu_ns[ii];
+  }
+  qsort(stats->cpu_ns, stats->len, sizeof(uint64_t), compare_u64);
+  printf("%-8s %8u %10.1f %10.1f %10.1f %10.1f %10.2f %12.1f %12lu\n", scenario, stats->len,
+         total / 1e3 / stats->len, stats->cpu_ns[stats->len / 2] / 1e3, stats->cpu_ns[stats->len * 99 / 100] / 1e3,
+         stats->cpu_ns[stats->len - 1] / 1e3, (double)stats->writes / stats->len, (double)stats->bytes / stats->len,
+         (unsigned long)stats->bytes);
+  free(stats->cpu_ns);
+  memset(stats, 0, sizeof(FrameStats_T));
+}
+
+/* Publishes what the script did and presents it without measuring */
+static void bench_present(GameBoard_T *board) {
+  ev_ring_publish(board->render.events);
+  render_frame(board);
+}
+
+/* Deals a new board and opens it from the center. A sliced opening is left for the caller to reveal */
+static void bench_deal(GameBoard_T *board, unsigned int bombs, unsigned int seed, int sliced) {
+  reset_board(board, board->height, board->width);
+  board->num_bombs = bombs;
+  board->seed = seed;
+  board->game_state = TURNS;
+  render_reset(board);
+  bench_present(board);
+  board->curr_index = CELL_INDEX(board, board->height / 2, board->width / 2);
+  ev_ring_push(board->render.events, EV_CURSOR, board->curr_index, 0);
+  board->fill.sliced = sliced;
+  apply_cell_action(board, UNCOVER);
+  board->fill.sliced = 0;
+}
+
+static void bench_size(BenchTerm_T *term, GameBoard_T *board, unsigned int bombs, unsigned int seed) {
+  FrameStats_T stats = {0};
+  unsigned int cells = board->height * board->width;
+
+  /* The cursor walks every row, left to right and back, like holding down an arrow key */
+  bench_deal(board, bombs, seed, 0);
+  bench_present(board);
+  for (unsigned int row = 0; row < board->height; row++) {
+    for (unsigned int step = 0; step < board->width; step++) {
+      unsigned int col = (row % 2) ? board->width - 1 - step : step;
+      board->curr_index = CELL_INDEX(board, row, col);
+      ev_ring_push(board->render.events, EV_CURSOR, board->curr_index, 0);
+      bench_frame(term, board, &stats);
+    }
+  }
+  report("sweep", &stats);
+
+  /* Few enough mines that most of the board opens at once */
+  bench_deal(board, cells / 64 + 1, seed, 1);
+  do {
+    bench_frame(term, board, &stats);
+  } while (flood_fill_run(board, FLOOD_FILL_SLICE_NS));
+  bench_frame(term, board, &stats);
+  report("opening", &stats);
+
+  /* The end of a game redraws the whole board with the cursor gone. Covering it again in between is not measured */
+  bench_deal(board, bombs, seed, 0);
+  bench_present(board);
+  uint8_t *played = (uint8_t *)malloc(cells);
+  memcpy(played, board->board, cells);
+  for (unsigned int rep = 0; rep < RENDER_BENCH_REVEALS; rep++) {
+    for (unsigned int index = 0; index < cells; index++) {
+      CELL_KNOWN(board, index) |= CELL_UNCOVERED_BIT;
+    }
+    board->render.cursor = INVALID_INDEX;
+    board->refresh_board_print = 1;
+    bench_frame(term, board, &stats);
+    board->refresh_board_print = 0;
+
+    memcpy(board->board, played, cells);
+    board->render.full_refresh = 1;
+    bench_present(board);
+  }
+  free(played);
+  report("reveal", &stats);
+}
+
+int main(int argc, char **argv) {
+  unsigned int seed = 11;
+  const char *type = RENDER_BENCH_TERM;
+  const char **sizes = RENDER_BENCH_SIZES;
+  int num_sizes = sizeof(RENDER_BENCH_SIZES) / sizeof(RENDER_BENCH_SIZES[0]);
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; first++) {
+    if (!strcmp(argv[first], "--seed") && first + 1 < argc) {
+      seed = strtoul(argv[++first], NULL, 10);
+    } else if (!strcmp(argv[first], "--term") && first + 1 < argc) {
+      type = argv[++first];
+    } else {
+      fprintf(stderr, "Usage: %s [--seed n] [--term name] [<rows>x<cols>/<bombs> ...]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (first < argc) {
+    sizes = (const char **)argv + first;
+    num_sizes = argc - first;
+  }
+
+  setlocale(LC_ALL, "");
+  if (perf_open()) {
+    fprintf(stderr, "perf_event_open failed, reporting wall time only\n");
+  }
+
+  for (int ii = 0; ii < num_sizes; ii++) {
+    unsigned int rows, cols, bombs;
+    if (sscanf(sizes[ii], "%ux%u/%u", &rows, &cols, &bombs) != 3 || !rows || !cols || bombs + 9 > rows * cols) {
+      fprintf(stderr, "Bad board size %s, expected <rows>x<cols>/<bombs>\n", sizes[ii]);
+      return 1;
+    }
+
+    BenchTerm_T term;
+    GameBoard_T *board = (GameBoard_T *)calloc(1, sizeof(GameBoard_T));
+    generate_board(board, rows, cols);
+    board->generator = BOARD_GENERATOR_RAND;
+    if (term_open(&term, rows, cols, type) || render_setup(board, rows, cols)) {
+      fprintf(stderr, "Could not start curses on a pty as %s\n", type);
+      return 1;
+    }
+    render_init(board);
+    board->on_cell_change = render_cell_changed;
+    perf_reset();
+
+    printf("board %ux%u bombs=%u term=%s\n", rows, cols, bombs, type);
+    printf("%-8s %8s %10s %10s %10s %10s %10s %12s %12s\n", "scenario", "frames", "cpu_us", "p50_us", "p99_us",
+           "max_us", "writes/f", "bytes/f", "bytes");
+    bench_size(&term, board, bombs, seed);
+    perf_report(stdout);
+    printf("\n");
+
+    pm_exit(board->pm);
+    term_close(&term);
+    render_exit(board);
+    free_board(board);
+    free(board);
+  }
+  perf_close();
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "replay.h"
+
+int replay_writer_open(ReplayWriter_T *rw, const char *path, const ReplayHeader_T *header) {
+  uint8_t buf[REPLAY_HEADER_SIZE];
+  memcpy(buf, REPLAY_MAGIC, 4);
+  put_u16(buf + 4, REPLAY_VERSION);
+  put_u16(buf + 6, header->generator);
+  put_u32(buf + 8, header->height);
+  put_u32(buf + 12, header->width);
+  put_u32(buf + 16, header->bombs);
+  put_u32(buf + 20, header->seed);
+  put_u32(buf + 24, header->topology);
+
+  memset(rw, 0, sizeof(ReplayWriter_T));
+  rw->fp = fopen(path, "wb");
+  if (!rw->fp) {
+    return 1;
+  }
+  if (fwrite(buf, 1, sizeof(buf), rw->fp) != sizeof(buf)) {
+    replay_writer_close(rw);
+    return 1;
+  }
+  return 0;
+}
+
+int replay_write_action(ReplayWriter_T *rw, CellAction_T action, unsigned int index, uint64_t ms) {
+  ReplayActionCode_T code;
+  switch (action) {
+  case MOVE:
+    code = REPLAY_MOVE;
+    break;
+  case UNCOVER:
+    code = REPLAY_UNCOVER;
+    break;
+  case FLAG:
+    code = REPLAY_FLAG;
+    break;
+  case EXIT:
+    code = REPLAY_EXIT;
+    break;
+  case CHORD:
+    code = REPLAY_CHORD;
+    break;
+  case UNDO:
+    code = REPLAY_UNDO;
+    break;
+  case REDO:
+    code = REPLAY_REDO;
+    break;
+  default:
+    return 0;
+  }
+
+  uint8_t buf[20];
+  size_t n = put_varint(buf, ((ms - rw->last_ms) << REPLAY_CODE_BITS) | code);
+  n += put_varint(buf + n, zigzag((int64_t)index - (int64_t)rw->last_index));
+  rw->last_ms = ms;
+  rw->last_index = index;
+
+  /* Flush per record so a crashed game still leaves a playable log */
+  if (fwrite(buf, 1, n, rw->fp) != n || fflush(rw->fp)) {
+    return 1;
+  }
+  return 0;
+}
+
+void replay_writer_close(ReplayWriter_T *rw) {
+  if (rw->fp) {
+    fclose(rw->fp);
+    rw->fp = NULL;
+  }
+}
+
+int replay_reader_open(ReplayReader_T *rr, const char *path) {
+  memset(rr, 0, sizeof(ReplayReader_T));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < REPLAY_V2_HEADER_SIZE) {
+    close(fd);
+    return 1;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return 1;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  rr->data = (const uint8_t *)data;
+  rr->len = st.st_size;
+
+  uint16_t version = get_u16(rr->data + 4);
+  size_t header_size = (version < 3) ? REPLAY_V2_HEADER_SIZE : REPLAY_HEADER_SIZE;
+  if (memcmp(rr->data, REPLAY_MAGIC, 4) || version < 1 || version > REPLAY_VERSION || rr->len < header_size) {
+    replay_reader_close(rr);
+    return 1;
+  }
+  rr->code_bits = (version == 1) ? 2 : REPLAY_CODE_BITS;
+  rr->header.version = version;
+  rr->header.generator = get_u16(rr->data + 6);
+  rr->header.height = get_u32(rr->data + 8);
+  rr->header.width = get_u32(rr->data + 12);
+  rr->header.bombs = get_u32(rr->data + 16);
+  rr->header.seed = get_u32(rr->data + 20);
+  rr->header.topology = (version < 3) ? TOPOLOGY_SQUARE : get_u32(rr->data + 24);
+  rr->pos = header_size;
+  return 0;
+}
+
+/* Returns 1 when a record was read, 0 at the end of the stream */
+int replay_next(ReplayReader_T *rr, CellAction_T *action, unsigned int *index, uint64_t *ms) {
+  static const CellAction_T actions[] = {MOVE, UNCOVER, FLAG, EXIT, CHORD, UNDO, REDO, NONE};
+  uint64_t tag, delta;
+  size_t n, m;
+  if (!(n = get_varint(rr->data + rr->pos, rr->len - rr->pos, &tag)) ||
+      !(m = get_varint(rr->data + rr->pos + n, rr->len - rr->pos - n, &delta))) {
+    return 0;
+  }
+  rr->pos += n + m;
+
+  rr->last_ms += tag >> rr->code_bits;
+  rr->last_index += (unsigned int)unzigzag(delta);
+  *action = actions[tag & ((1u << rr->code_bits) - 1)];
+  *index = rr->last_index;
+  *ms = rr->last_ms;
+  return 1;
+}
+
+void replay_reader_close(ReplayReader_T *rr) {
+  if (rr->data) {
+    munmap((void *)rr->data, rr->len);
+    rr->data = NULL;
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "minesweeper.h"
+
+/**
+ * Replay log format (little endian)
+ *
+ *   Header (REPLAY_HEADER_SIZE bytes)
+ *     0: magic "MSRP"
+ *     4: u16 format version
+ *     6: u16 generator version (BoardGenerator_T)
+ *     8: u32 height
+ *    12: u32 width
+ *    16: u32 bombs
+ *    20: u32 seed
+ *    24: u32 topology (TopologyKind_T), from version 3
+ *
+ *   Records, until end of file
+ *     varint  (ms since previous record << 3) | action code
+ *     varint  zigzag(cell index - previous record's cell index)
+ *
+ * The first record's deltas are relative to 0 ms and cell 0. A truncated trailing record (the game crashed mid-write)
+ * ends the stream without error. Version 1 logs predate chording and use a 2-bit action code; they are still read.
+ * Logs before version 3 have a shorter header with no topology and were all played on square boards.
+ */
+#define REPLAY_MAGIC "MSRP"
+#define REPLAY_VERSION 3
+#define REPLAY_CODE_BITS 3
+#define REPLAY_HEADER_SIZE 28
+#define REPLAY_V2_HEADER_SIZE 24
+
+typedef enum ReplayActionCode {
+  REPLAY_MOVE = 0,
+  REPLAY_UNCOVER = 1,
+  REPLAY_FLAG = 2,
+  REPLAY_EXIT = 3,
+  REPLAY_CHORD = 4,
+  REPLAY_UNDO = 5,
+  REPLAY_REDO = 6,
+} ReplayActionCode_T;
+
+typedef struct ReplayHeader {
+  uint16_t version;
+  uint16_t generator;
+  uint32_t height;
+  uint32_t width;
+  uint32_t bombs;
+  uint32_t seed;
+  uint32_t topology;
+} ReplayHeader_T;
+
+typedef struct ReplayWriter {
+  FILE *fp;
+  unsigned int last_index;
+  uint64_t last_ms;
+} ReplayWriter_T;
+
+typedef struct ReplayReader {
+  ReplayHeader_T header;
+  const uint8_t *data;
+  size_t len;
+  size_t pos;
+  unsigned int code_bits;
+  unsigned int last_index;
+  uint64_t last_ms;
+} ReplayReader_T;
+
+/* Replay prototypes begin */
+
+int replay_writer_open(ReplayWriter_T *rw, const char *path, const ReplayHeader_T *header);
+
+int replay_write_action(ReplayWriter_T *rw, CellAction_T action, unsigned int index, uint64_t ms);
+
+void replay_writer_close(ReplayWriter_T *rw);
+
+int replay_reader_open(ReplayReader_T *rr, const char *path);
+
+int replay_next(ReplayReader_T *rr, CellAction_T *action, unsigned int *index, uint64_t *ms);
+
+void replay_reader_close(ReplayReader_T *rr);
+
+/* Replay prototypes end */
+
+#endif /* REPLAY_H */
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minesweeper.h"
+#include "replay.h"
+
+static const char *ResultStr[] = {"INIT", "INIT", "INIT", "UNFINISHED", "EXPLODE", "QUIT", "TIMEOUT", "WIN", "CLEANUP"};
+
+typedef struct ReplayResult {
+  GameState_T state;
+  unsigned long actions;
+  uint64_t last_ms;
+  unsigned int remaining_open_cells;
+  unsigned int flags_placed;
+} ReplayResult_T;
+
+static void replay_cell_changed(GameBoard_T *board, unsigned int index) {
+  journal_record(&board->journal, board, index);
+}
+
+/**
+ * Re-applies a replay through the engine. Returns non-zero if the log is invalid: an unknown generator, a cell off
+ * the board, or actions after the game already ended.
+ */
+static int replay_play(const char *path, ReplayResult_T *result) {
+  ReplayReader_T rr;
+  if (replay_reader_open(&rr, path)) {
+    fprintf(stderr, "%s: not a replay file\n", path);
+    return 1;
+  }
+
+  ReplayHeader_T *hdr = &rr.header;
+  if ((hdr->generator != BOARD_GENERATOR_RAND && hdr->generator != BOARD_GENERATOR_BANDED) ||
+      hdr->topology >= NUM_TOPOLOGIES || !hdr->height || !hdr->width ||
+      (uint64_t)hdr->bombs + 9 > (uint64_t)hdr->height * hdr->width) {
+    fprintf(stderr, "%s: unsupported generator %u, topology %u or board %ux%u/%u\n", path, hdr->generator,
+            hdr->topology, hdr->height, hdr->width, hdr->bombs);
+    replay_reader_close(&rr);
+    return 1;
+  }
+
+  GameBoard_T game = {0};
+  GameBoard_T *board = &game;
+  board->topology.kind = (TopologyKind_T)hdr->topology;
+  generate_board(board, hdr->height, hdr->width);
+  board->num_bombs = hdr->bombs;
+  board->seed = hdr->seed;
+  board->generator = hdr->generator;
+  board->game_state = TURNS;
+  journal_init(&board->journal);
+  board->on_cell_change = replay_cell_changed;
+
+  int err = 0;
+  CellAction_T action;
+  unsigned int index;
+  uint64_t ms = 0;
+  memset(result, 0, sizeof(ReplayResult_T));
+  while (replay_next(&rr, &action, &index, &ms)) {
+    /* A finished game may still be taken back */
+    if ((board->game_state != TURNS && action != UNDO) || !INDEX_ON_BOARD(board, index)) {
+      fprintf(stderr, "%s: invalid action %d at cell %u after %lu actions\n", path, action, index, result->actions);
+      err = 1;
+      break;
+    }
+    board->curr_index = index;
+    if (action == UNDO) {
+      journal_undo(&board->journal, board);
+    } else if (action == REDO) {
+      journal_redo(&board->journal, board);
+    } else {
+      journal_begin(&board->journal, board);
+      apply_cell_action(board, action);
+      journal_end(&board->journal, board);
+    }
+    result->actions++;
+  }
+
+  result->state = board->game_state;
+  result->last_ms = ms;
+  result->remaining_open_cells = board->remaining_open_cells;
+  result->flags_placed = board->num_bombs - board->num_flags;
+  journal_exit(&board->journal);
+  free_board(board);
+  replay_reader_close(&rr);
+  return err;
+}
+
+int main(int argc, char **argv) {
+  unsigned int repeat = 1;
+  int argi = 1;
+  if (argc > 2 && !strcmp(argv[1], "--repeat")) {
+    repeat = strtoul(argv[2], NULL, 10);
+    argi = 3;
+  }
+  if (argi != argc - 1 || !repeat) {
+    fprintf(stderr, "Usage: %s [--repeat <n>] <replay-file>\n", argv[0]);
+    return 1;
+  }
+
+  struct timespec start, stop;
+  ReplayResult_T result;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned int r = 0; r < repeat; r++) {
+    if (replay_play(argv[argi], &result)) {
+      return 1;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  double secs = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  printf("result=%s time_ms=%llu actions=%lu remaining_open_cells=%u flags=%u\n", ResultStr[result.state],
+         (unsigned long long)result.last_ms, result.actions, result.remaining_open_cells, result.flags_placed);
+  if (repeat > 1) {
+    printf("replayed %u times in %.3f s, %.0f actions/s\n", repeat, secs, result.actions * repeat / secs);
+  }
+  return 0;
+}
@@ -0,0 +1,479 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "sat.h"
+
+#define SAT_UNDEF 2
+#define SAT_NO_REASON UINT32_MAX
+#define SAT_VAR_DECAY 0.95
+
+static inline int sat_lit_value(const SatSolver_T *s, uint32_t lit) {
+  uint8_t v = s->value[SAT_VAR(lit)];
+  return (v == SAT_UNDEF) ? SAT_UNDEF : v ^ (lit & 1);
+}
+
+/* Activity heap */
+
+static void sat_heap_up(SatSolver_T *s, unsigned int i) {
+  uint32_t var = s->heap[i];
+  while (i && s->activity[s->heap[(i - 1) / 2]] < s->activity[var]) {
+    s->heap[i] = s->heap[(i - 1) / 2];
+    s->heap_index[s->heap[i]] = i;
+    i = (i - 1) / 2;
+  }
+  s->heap[i] = var;
+  s->heap_index[var] = i;
+}
+
+static void sat_heap_down(SatSolver_T *s, unsigned int i) {
+  uint32_t var = s->heap[i];
+  for (;;) {
+    unsigned int child = 2 * i + 1;
+    if (child >= s->heap_len) {
+      break;
+    }
+    if (child + 1 < s->heap_len && s->activity[s->heap[child + 1]] > s->activity[s->heap[child]]) {
+      child++;
+    }
+    if (s->activity[s->heap[child]] <= s->activity[var]) {
+      break;
+    }
+    s->heap[i] = s->heap[child];
+    s->heap_index[s->heap[i]] = i;
+    i = child;
+  }
+  s->heap[i] = var;
+  s->heap_index[var] = i;
+}
+
+static void sat_heap_insert(SatSolver_T *s, uint32_t var) {
+  if (s->heap_index[var] != UINT32_MAX) {
+    return;
+  }
+  s->heap[s->heap_len] = var;
+  sat_heap_up(s, s->heap_len++);
+}
+
+static uint32_t sat_heap_pop(SatSolver_T *s) {
+  uint32_t var = s->heap[0];
+  s->heap_index[var] = UINT32_MAX;
+  if (--s->heap_len) {
+    s->heap[0] = s->heap[s->heap_len];
+    sat_heap_down(s, 0);
+  }
+  return var;
+}
+
+static void sat_bump(SatSolver_T *s, uint32_t var) {
+  if ((s->activity[var] += s->var_inc) > 1e100) {
+    for (unsigned int v = 0; v < s->num_vars; v++) {
+      s->activity[v] *= 1e-100;
+    }
+    s->var_inc *= 1e-100;
+  }
+  if (s->heap_index[var] != UINT32_MAX) {
+    sat_heap_up(s, s->heap_index[var]);
+  }
+}
+
+/* Trail */
+
+static void sat_enqueue(SatSolver_T *s, uint32_t lit, uint32_t reason) {
+  uint32_t var = SAT_VAR(lit);
+  s->value[var] = !(lit & 1);
+  s->level[var] = s->num_levels;
+  s->reason[var] = reason;
+  s->trail[s->trail_len++] = lit;
+}
+
+static void sat_new_level(SatSolver_T *s) { s->trail_lim[s->num_levels++] = s->trail_len; }
+
+static void sat_cancel_until(SatSolver_T *s, unsigned int level) {
+  if (s->num_levels <= level) {
+    return;
+  }
+  for (unsigned int ii = s->trail_len; ii-- > s->trail_lim[level];) {
+    uint32_t var = SAT_VAR(s->trail[ii]);
+    s->phase[var] = s->value[var];
+    s->value[var] = SAT_UNDEF;
+    sat_heap_insert(s, var);
+  }
+  s->trail_len = s->qhead = s->trail_lim[level];
+  s->num_levels = level;
+}
+
+static void sat_watch(SatSolver_T *s, uint32_t lit, uint32_t ref) {
+  SatWatches_T *ws = &s->watches[lit];
+  if (ws->len == ws->capacity) {
+    ws->capacity = ws->capacity ? ws->capacity * 2 : 4;
+    ws->refs = (uint32_t *)mem_realloc(MEM_SOLVER, ws->refs, ws->capacity * sizeof(uint32_t));
+  }
+  ws->refs[ws->len++] = ref;
+}
+
+/* Stores a clause of two or more literals and watches its first two */
+static uint32_t sat_store(SatSolver_T *s, const uint32_t *lits, unsigned int len) {
+  if (s->arena_len + len + 1 > s->arena_capacity) {
+    s->arena_capacity = (s->arena_capacity + len + 1) * 2;
+    s->arena = (uint32_t *)mem_realloc(MEM_SOLVER, s->arena, s->arena_capacity * sizeof(uint32_t));
+  }
+  uint32_t ref = s->arena_len;
+  s->arena[s->arena_len++] = len;
+  memcpy(s->arena + s->arena_len, lits, len * sizeof(uint32_t));
+  s->arena_len += len;
+  sat_watch(s, lits[0], ref);
+  sat_watch(s, lits[1], ref);
+  return ref;
+}
+
+/* Returns a clause that became false, or SAT_NO_REASON */
+static uint32_t sat_propagate(SatSolver_T *s) {
+  while (s->qhead < s->trail_len) {
+    uint32_t false_lit = SAT_NOT(s->trail[s->qhead++]);
+    SatWatches_T *ws = &s->watches[false_lit];
+    uint32_t ii = 0, jj = 0;
+    while (ii < ws->len) {
+      uint32_t ref = ws->refs[ii++];
+      uint32_t len = s->arena[ref], *c = s->arena + ref + 1;
+      if (c[0] == false_lit) {
+        c[0] = c[1];
+        c[1] = false_lit;
+      }
+      if (sat_lit_value(s, c[0]) == 1) {
+        ws->refs[jj++] = ref;
+        continue;
+      }
+
+      /* Move the watch to a literal that is not false, if there is one */
+      uint32_t k = 2;
+      while (k < len && sat_lit_value(s, c[k]) == 0) {
+        k++;
+      }
+      if (k < len) {
+        c[1] = c[k];
+        c[k] = false_lit;
+        sat_watch(s, c[1], ref);
+        continue;
+      }
+
+      ws->refs[jj++] = ref;
+      if (sat_lit_value(s, c[0]) == 0) {
+        while (ii < ws->len) {
+          ws->refs[jj++] = ws->refs[ii++];
+        }
+        ws->len = jj;
+        s->qhead = s->trail_len;
+        return ref;
+      }
+      sat_enqueue(s, c[0], ref);
+    }
+    ws->len = jj;
+  }
+  return SAT_NO_REASON;
+}
+
+/* First-UIP learning. Leaves the learned clause in scratch, asserting literal first, and returns its length */
+static unsigned int sat_analyze(SatSolver_T *s, uint32_t conflict, unsigned int *backjump) {
+  unsigned int len = 1, paths = 0, index = s->trail_len;
+  uint32_t lit = SAT_NO_REASON;
+  do {
+    uint32_t size = s->arena[conflict], *c = s->arena + conflict + 1;
+    for (uint32_t k = (lit == SAT_NO_REASON) ? 0 : 1; k < size; k++) {
+      uint32_t var = SAT_VAR(c[k]);
+      if (s->seen[var] || !s->level[var]) {
+        continue;
+      }
+      s->seen[var] = 1;
+      sat_bump(s, var);
+      if (s->level[var] == s->num_levels) {
+        paths++;
+      } else {
+        s->scratch[len++] = c[k];
+      }
+    }
+    while (!s->seen[SAT_VAR(s->trail[--index])]) {
+    }
+    lit = s->trail[index];
+    conflict = s->reason[SAT_VAR(lit)];
+    s->seen[SAT_VAR(lit)] = 0;
+  } while (--paths);
+  s->scratch[0] = SAT_NOT(lit);
+
+  /* Backjump to the second highest level in the clause, whose literal is watched second */
+  *backjump = 0;
+  for (unsigned int ii = 1; ii < len; ii++) {
+    uint32_t var = SAT_VAR(s->scratch[ii]);
+    s->seen[var] = 0;
+    if (s->level[var] > *backjump) {
+      *backjump = s->level[var];
+      uint32_t swap = s->scratch[1];
+      s->scratch[1] = s->scratch[ii];
+      s->scratch[ii] = swap;
+    }
+  }
+  return len;
+}
+
+static unsigned int sat_luby(unsigned int x) {
+  unsigned int size = 1, seq = 0;
+  while (size < x + 1) {
+    size = 2 * size + 1;
+    seq++;
+  }
+  while (size - 1 != x) {
+    size = (size - 1) / 2;
+    seq--;
+    x %= size;
+  }
+  return 1u << seq;
+}
+
+void sat_init(SatSolver_T *s) {
+  memset(s, 0, sizeof(SatSolver_T));
+  s->ok = 1;
+  s->var_inc = 1;
+  uint32_t truth = SAT_LIT(sat_new_var(s));
+  sat_add_clause(s, &truth, 1);
+}
+
+void sat_free(SatSolver_T *s) {
+  for (unsigned int lit = 0; lit < 2 * s->num_vars; lit++) {
+    mem_free(s->watches[lit].refs);
+  }
+  mem_free(s->watches);
+  mem_free(s->value);
+  mem_free(s->model);
+  mem_free(s->phase);
+  mem_free(s->seen);
+  mem_free(s->level);
+  mem_free(s->reason);
+  mem_free(s->activity);
+  mem_free(s->heap_index);
+  mem_free(s->arena);
+  mem_free(s->trail);
+  mem_free(s->trail_lim);
+  mem_free(s->heap);
+  mem_free(s->scratch);
+  memset(s, 0, sizeof(SatSolver_T));
+}
+
+#define SAT_GROW(s, field, type)                                                                                       \
+  (s)->field = (type *)mem_realloc(MEM_SOLVER, (s)->field, (s)->var_capacity * sizeof(type))
+
+unsigned int sat_new_var(SatSolver_T *s) {
+  if (s->num_vars == s->var_capacity) {
+    unsigned int old = s->var_capacity;
+    s->var_capacity = old ? old * 2 : 64;
+    SAT_GROW(s, value, uint8_t);
+    SAT_GROW(s, model, uint8_t);
+    SAT_GROW(s, phase, uint8_t);
+    SAT_GROW(s, seen, uint8_t);
+    SAT_GROW(s, level, unsigned int);
+    SAT_GROW(s, reason, uint32_t);
+    SAT_GROW(s, activity, double);
+    SAT_GROW(s, heap_index, unsigned int);
+    SAT_GROW(s, trail, uint32_t);
+    SAT_GROW(s, trail_lim, unsigned int);
+    SAT_GROW(s, heap, uint32_t);
+    SAT_GROW(s, scratch, uint32_t);
+    s->watches = (SatWatches_T *)mem_realloc(MEM_SOLVER, s->watches, 2 * s->var_capacity * sizeof(SatWatches_T));
+    memset(s->watches + 2 * old, 0, 2 * (s->var_capacity - old) * sizeof(SatWatches_T));
+  }
+  unsigned int var = s->num_vars++;
+  s->value[var] = SAT_UNDEF;
+  s->model[var] = 0;
+  s->phase[var] = 0;
+  s->seen[var] = 0;
+  s->level[var] = 0;
+  s->reason[var] = SAT_NO_REASON;
+  s->activity[var] = 0;
+  s->heap_index[var] = UINT32_MAX;
+  sat_heap_insert(s, var);
+  return var;
+}
+
+/**
+ * Adds a clause, dropping literals already false and skipping it if one is already true. Returns 0 once the clauses
+ * can no longer all hold.
+ */
+int sat_add_clause(SatSolver_T *s, const uint32_t *lits, unsigned int len) {
+  if (!s->ok) {
+    return 0;
+  }
+  unsigned int kept = 0;
+  for (unsigned int ii = 0; ii < len; ii++) {
+    int value = sat_lit_value(s, lits[ii]);
+    if (value == 1) {
+      return 1;
+    } else if (value == 0) {
+      continue;
+    }
+    int duplicate = 0;
+    for (unsigned int jj = 0; jj < kept; jj++) {
+      if (s->scratch[jj] == SAT_NOT(lits[ii])) {
+        return 1;
+      }
+      duplicate |= s->scratch[jj] == lits[ii];
+    }
+    if (!duplicate) {
+      s->scratch[kept++] = lits[ii];
+    }
+  }
+
+  if (kept == 0) {
+    s->ok = 0;
+  } else if (kept == 1) {
+    sat_enqueue(s, s->scratch[0], SAT_NO_REASON);
+    s->ok = sat_propagate(s) == SAT_NO_REASON;
+  } else {
+    sat_store(s, s->scratch, kept);
+  }
+  return s->ok;
+}
+
+static void sat_clause3(SatSolver_T *s, uint32_t a, uint32_t b, uint32_t c) {
+  uint32_t lits[3] = {a, b, c};
+  sat_add_clause(s, lits, 3);
+}
+
+/**
+ * Requires between lo and hi of lits[0..n) to be true whenever guard is (SAT_TRUE for always). Small constraints are
+ * written out subset by subset, larger ones or ones whose counts are wanted go through a sequential counter. When
+ * at_least is given, at_least[j - lo] for j in lo..hi+1 is set to a literal that is true exactly when j or more of
+ * lits are.
+ */
+void sat_add_cardinality(SatSolver_T *s, const uint32_t *lits, unsigned int n, unsigned int lo, unsigned int hi,
+                         uint32_t guard, uint32_t *at_least) {
+  if (n <= SAT_DIRECT_MAX && !at_least) {
+    uint32_t clause[SAT_DIRECT_MAX + 1];
+    clause[0] = SAT_NOT(guard);
+    for (unsigned int mask = 0; mask < (1u << n); mask++) {
+      unsigned int ones = __builtin_popcount(mask), len = 1;
+      int at_most = ones == hi + 1, at_least_lo = lo && ones == n - lo + 1;
+      if (!at_most && !at_least_lo) {
+        continue;
+      }
+      for (unsigned int ii = 0; ii < n; ii++) {
+        if (mask & (1u << ii)) {
+          clause[len++] = at_most ? SAT_NOT(lits[ii]) : lits[ii];
+        }
+      }
+      sat_add_clause(s, clause, len);
+      if (at_most && at_least_lo) {
+        for (unsigned int ii = 1; ii < len; ii++) {
+          clause[ii] = SAT_NOT(clause[ii]);
+        }
+        sat_add_clause(s, clause, len);
+      }
+    }
+    return;
+  }
+
+  /* Row i holds "at least j of the first i" for the j that can still matter: no more than hi + 1, and no fewer than
+   * the lo - (n - i) that the remaining literals could still lift to lo */
+  uint32_t *prev = (uint32_t *)mem_alloc(MEM_SOLVER, (hi + 2) * sizeof(uint32_t));
+  uint32_t *cur = (uint32_t *)mem_alloc(MEM_SOLVER, (hi + 2) * sizeof(uint32_t));
+  for (unsigned int i = 1; i <= n; i++) {
+    uint32_t x = lits[i - 1];
+    unsigned int first = (lo > n - i + 1) ? lo - (n - i) : 1, last = (i < hi + 1) ? i : hi + 1;
+    for (unsigned int j = first; j <= last; j++) {
+      uint32_t without = (j <= i - 1) ? prev[j] : SAT_FALSE, before = (j == 1) ? SAT_TRUE : prev[j - 1];
+      if (without == SAT_FALSE && before == SAT_TRUE) {
+        cur[j] = x;
+        continue;
+      }
+      uint32_t count = SAT_LIT(sat_new_var(s));
+      sat_clause3(s, SAT_NOT(without), count, SAT_FALSE);
+      sat_clause3(s, SAT_NOT(before), SAT_NOT(x), count);
+      sat_clause3(s, SAT_NOT(count), without, x);
+      sat_clause3(s, SAT_NOT(count), without, before);
+      cur[j] = count;
+    }
+    uint32_t *swap = prev;
+    prev = cur;
+    cur = swap;
+  }
+
+  if (lo) {
+    uint32_t clause[2] = {SAT_NOT(guard), (lo <= n) ? prev[lo] : SAT_FALSE};
+    sat_add_clause(s, clause, 2);
+  }
+  if (hi + 1 <= n) {
+    uint32_t clause[2] = {SAT_NOT(guard), SAT_NOT(prev[hi + 1])};
+    sat_add_clause(s, clause, 2);
+  }
+  for (unsigned int j = lo; at_least && j <= hi + 1; j++) {
+    at_least[j - lo] = (j == 0) ? SAT_TRUE : (j > n) ? SAT_FALSE : prev[j];
+  }
+  mem_free(prev);
+  mem_free(cur);
+}
+
+/**
+ * Searches for an assignment satisfying every clause and the assumptions. Returns SAT_UNKNOWN if the cancel callback
+ * gave up first. The model of a satisfiable call is read with sat_model_true() until the next call.
+ */
+SatResult_T sat_solve(SatSolver_T *s, const uint32_t *assumptions, unsigned int num_assumptions) {
+  if (!s->ok) {
+    return SAT_UNSATISFIABLE;
+  }
+  unsigned int restarts = 0;
+  uint64_t restart_at = s->conflicts + SAT_RESTART_UNIT;
+  for (;;) {
+    uint32_t conflict = sat_propagate(s);
+    if (conflict != SAT_NO_REASON) {
+      s->conflicts++;
+      if (!s->num_levels) {
+        s->ok = 0;
+        return SAT_UNSATISFIABLE;
+      }
+      unsigned int backjump;
+      unsigned int len = sat_analyze(s, conflict, &backjump);
+      sat_cancel_until(s, backjump);
+      sat_enqueue(s, s->scratch[0], (len > 1) ? sat_store(s, s->scratch, len) : SAT_NO_REASON);
+      s->var_inc /= SAT_VAR_DECAY;
+
+      if (s->cancelled && s->conflicts % SAT_CANCEL_STRIDE == 0 && s->cancelled(s->opaque)) {
+        sat_cancel_until(s, 0);
+        return SAT_UNKNOWN;
+      }
+      if (s->conflicts >= restart_at) {
+        sat_cancel_until(s, 0);
+        restart_at = s->conflicts + (uint64_t)sat_luby(++restarts) * SAT_RESTART_UNIT;
+      }
+      continue;
+    }
+
+    /* Assumptions take the first decision levels, one each */
+    uint32_t next = SAT_NO_REASON;
+    while (s->num_levels < num_assumptions) {
+      uint32_t lit = assumptions[s->num_levels];
+      int value = sat_lit_value(s, lit);
+      if (value == 1) {
+        sat_new_level(s);
+      } else if (value == 0) {
+        sat_cancel_until(s, 0);
+        return SAT_UNSATISFIABLE;
+      } else {
+        next = lit;
+        break;
+      }
+    }
+    while (next == SAT_NO_REASON && s->heap_len) {
+      uint32_t var = sat_heap_pop(s);
+      if (s->value[var] == SAT_UNDEF) {
+        next = s->phase[var] ? SAT_LIT(var) : SAT_NOT(SAT_LIT(var));
+      }
+    }
+    if (next == SAT_NO_REASON) {
+      memcpy(s->model, s->value, s->num_vars);
+      sat_cancel_until(s, 0);
+      return SAT_SATISFIABLE;
+    }
+    sat_new_level(s);
+    sat_enqueue(s, next, SAT_NO_REASON);
+  }
+}
+
+int sat_model_true(const SatSolver_T *s, uint32_t lit) { return s->model[SAT_VAR(lit)] ^ (lit & 1); }
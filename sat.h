@@ -0,0 +1,103 @@
+#ifndef SAT_H
+#define SAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Small CDCL SAT solver.
+ *
+ * Two watched literals, first-UIP learning with backjumping, VSIDS decisions with saved phases and Luby restarts.
+ * Clauses are only ever added, so whatever one call learns speeds up the next, and sat_solve() takes assumptions that
+ * hold for that call only. Clauses may only be added between calls.
+ *
+ * Variable 0 is always true. A literal is 2 * var for the variable and 2 * var + 1 for its negation.
+ */
+#define SAT_LIT(var) ((uint32_t)(var) * 2)
+#define SAT_NOT(lit) ((lit) ^ 1)
+#define SAT_VAR(lit) ((lit) >> 1)
+#define SAT_TRUE SAT_LIT(0)
+#define SAT_FALSE SAT_NOT(SAT_TRUE)
+
+/* Cardinality constraints on this many literals or fewer are written out as clauses instead of a counter */
+#define SAT_DIRECT_MAX 8
+/* Conflicts before the first restart, later ones follow the Luby sequence */
+#define SAT_RESTART_UNIT 64
+/* Conflicts between calls to the cancel callback */
+#define SAT_CANCEL_STRIDE 256
+
+typedef enum SatResult {
+  SAT_UNKNOWN = 0,
+  SAT_SATISFIABLE = 10,
+  SAT_UNSATISFIABLE = 20,
+} SatResult_T;
+
+typedef struct SatWatches {
+  uint32_t *refs;
+  uint32_t len;
+  uint32_t capacity;
+} SatWatches_T;
+
+typedef struct SatSolver {
+  /* Cleared once the clauses contradict each other */
+  int ok;
+  unsigned int num_vars;
+  unsigned int var_capacity;
+
+  /* Per variable */
+  uint8_t *value;
+  uint8_t *model;
+  uint8_t *phase;
+  uint8_t *seen;
+  unsigned int *level;
+  uint32_t *reason;
+  double *activity;
+  unsigned int *heap_index;
+
+  /* Per literal, the clauses watching it */
+  SatWatches_T *watches;
+
+  /* Clauses, each its length followed by its literals */
+  uint32_t *arena;
+  size_t arena_len;
+  size_t arena_capacity;
+
+  uint32_t *trail;
+  unsigned int trail_len;
+  unsigned int qhead;
+  unsigned int *trail_lim;
+  unsigned int num_levels;
+
+  /* Unassigned variables by activity */
+  uint32_t *heap;
+  unsigned int heap_len;
+  double var_inc;
+
+  uint32_t *scratch;
+  uint64_t conflicts;
+
+  /* Polled while solving. A non-zero return gives up with SAT_UNKNOWN */
+  int (*cancelled)(void *opaque);
+  void *opaque;
+} SatSolver_T;
+
+/* SAT prototypes begin */
+
+void sat_init(SatSolver_T *s);
+
+void sat_free(SatSolver_T *s);
+
+unsigned int sat_new_var(SatSolver_T *s);
+
+int sat_add_clause(SatSolver_T *s, const uint32_t *lits, unsigned int len);
+
+void sat_add_cardinality(SatSolver_T *s, const uint32_t *lits, unsigned int n, unsigned int lo, unsigned int hi,
+                         uint32_t guard, uint32_t *at_least);
+
+SatResult_T sat_solve(SatSolver_T *s, const uint32_t *assumptions, unsigned int num_assumptions);
+
+int sat_model_true(const SatSolver_T *s, uint32_t lit);
+
+/* SAT prototypes end */
+
+#endif /* SAT_H */
@@ -0,0 +1,137 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "mem.h"
+#include "save.h"
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+  while (len) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      return 1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Writes the cells out row-major, gathering them a chunk at a time when they are stored in tiles */
+static int write_cells(int fd, const GameBoard_T *board) {
+  size_t cells = (size_t)board->height * board->width;
+  if (!board->layout.tile_rank) {
+    return write_all(fd, board->board, cells);
+  }
+  uint8_t *chunk = (uint8_t *)mem_alloc(MEM_BOARD, SAVE_CHUNK);
+  if (!chunk) {
+    return 1;
+  }
+  int err = 0;
+  for (size_t done = 0; !err && done < cells;) {
+    size_t len = (cells - done < SAVE_CHUNK) ? cells - done : SAVE_CHUNK;
+    for (size_t ii = 0; ii < len; ii++) {
+      chunk[ii] = CELL_KNOWN(board, done + ii);
+    }
+    err = write_all(fd, chunk, len);
+    done += len;
+  }
+  mem_free(chunk);
+  return err;
+}
+
+int save_board(const GameBoard_T *board, const char *path) {
+  uint8_t header[SAVE_HEADER_SIZE] = {0};
+  memcpy(header, SAVE_MAGIC, 4);
+  put_u16(header + 4, SAVE_VERSION);
+  put_u16(header + 6, board->generator);
+  put_u32(header + 8, board->height);
+  put_u32(header + 12, board->width);
+  put_u32(header + 16, board->num_bombs);
+  put_u32(header + 20, board->num_flags);
+  put_u32(header + 24, board->remaining_open_cells);
+  put_u32(header + 28, board->seconds_elapsed);
+  put_u32(header + 32, board->curr_index);
+  put_u32(header + 36, board->seed);
+  put_u32(header + 40, board->is_first_turn ? SAVE_FLAG_FIRST_TURN : 0);
+  put_u32(header + 44, board->topology.kind);
+
+  /* Write next to the destination and rename, so a failed save never clobbers the previous one */
+  size_t tmp_len = strlen(path) + 5;
+  char *tmp_path = (char *)mem_alloc(MEM_BOARD, tmp_len);
+  if (!tmp_path) {
+    return 1;
+  }
+  snprintf(tmp_path, tmp_len, "%s.tmp", path);
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  int err = (fd < 0) || write_all(fd, header, sizeof(header)) || write_cells(fd, board);
+
+  if (fd >= 0) {
+    err |= close(fd);
+  }
+  if (!err) {
+    err = rename(tmp_path, path);
+  }
+  if (err) {
+    unlink(tmp_path);
+  }
+  mem_free(tmp_path);
+  return err;
+}
+
+int load_board(GameBoard_T *board, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < SAVE_HEADER_SIZE) {
+    close(fd);
+    return 1;
+  }
+
+  /* Map the whole file copy-on-write, nothing is read until it is touched */
+  uint8_t *data = (uint8_t *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return 1;
+  }
+
+  uint32_t height = get_u32(data + 8);
+  uint32_t width = get_u32(data + 12);
+  uint64_t cells = (uint64_t)height * width;
+  uint32_t curr_index = get_u32(data + 32);
+  if (memcmp(data, SAVE_MAGIC, 4) || get_u16(data + 4) != SAVE_VERSION || !cells || cells > UINT32_MAX ||
+      (uint64_t)st.st_size != SAVE_HEADER_SIZE + cells || curr_index >= cells ||
+      get_u32(data + 24) > cells || get_u32(data + 44) >= NUM_TOPOLOGIES) {
+    munmap(data, st.st_size);
+    return 1;
+  }
+
+  board->board = data + SAVE_HEADER_SIZE;
+  board->mapping = data;
+  board->mapping_len = st.st_size;
+  board->height = height;
+  board->width = width;
+  layout_init(&board->layout, LAYOUT_ROWS, height, width);
+  topology_init(&board->topology, (TopologyKind_T)get_u32(data + 44), height, width);
+  board->num_bombs = get_u32(data + 16);
+  board->num_flags = get_u32(data + 20);
+  board->remaining_open_cells = get_u32(data + 24);
+  board->curr_index = curr_index;
+  board->seed = get_u32(data + 36);
+  board->generator = get_u16(data + 6);
+
+  board->game_state = TURNS;
+  board->seconds_elapsed = get_u32(data + 28);
+  board->timeout = 1000; /* 1000 ms */
+  board->is_first_turn = (get_u32(data + 40) & SAVE_FLAG_FIRST_TURN) != 0;
+  board->refresh_board_print = 0;
+  return 0;
+}
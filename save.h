@@ -0,0 +1,48 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stdint.h>
+
+#include "minesweeper.h"
+
+/**
+ * Save file format (little endian)
+ *
+ *   Header (SAVE_HEADER_SIZE bytes)
+ *     0: magic "MSSV"
+ *     4: u16 format version
+ *     6: u16 generator version (BoardGenerator_T)
+ *     8: u32 height
+ *    12: u32 width
+ *    16: u32 num_bombs
+ *    20: u32 num_flags
+ *    24: u32 remaining_open_cells
+ *    28: u32 seconds_elapsed
+ *    32: u32 curr_index
+ *    36: u32 seed
+ *    40: u32 save flags (SAVE_FLAG_*)
+ *    44: u32 topology (TopologyKind_T), zero in saves that predate it
+ *    48: reserved, zero
+ *
+ *   Cells (height * width bytes), row-major, in the in-memory cell layout
+ *
+ * Loading maps the file copy-on-write and points board->board at the cells, so nothing is read up front and pages
+ * fault in as the game touches them. Writes made while playing stay private to the process. Boards stored in tiles
+ * (see layout.h) are written out as rows, and a loaded game is always stored as rows.
+ */
+#define SAVE_CHUNK (64 * 1024)
+#define SAVE_MAGIC "MSSV"
+#define SAVE_VERSION 1
+#define SAVE_HEADER_SIZE 64
+
+#define SAVE_FLAG_FIRST_TURN (1 << 0)
+
+/* Save prototypes begin */
+
+int save_board(const GameBoard_T *board, const char *path);
+
+int load_board(GameBoard_T *board, const char *path);
+
+/* Save prototypes end */
+
+#endif /* SAVE_H */
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "game_pool.h"
+#include "mem.h"
+#include "protocol.h"
+#include "server.h"
+
+typedef struct ServerClient {
+  int fd;
+  uint32_t events;
+  ProtoSession_T session;
+  ProtoBuf_T in;
+  ProtoBuf_T out;
+  struct ServerClient *prev;
+  struct ServerClient *next;
+} ServerClient_T;
+
+typedef struct Server {
+  int listen_fd;
+  int epoll_fd;
+  GamePool_T *pool;
+  ServerClient_T *clients;
+  unsigned long accepted;
+} Server_T;
+
+static volatile sig_atomic_t server_stopping = 0;
+
+static void server_stop(int sig) { server_stopping = 1; }
+
+static int server_listen(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void server_watch(Server_T *server, ServerClient_T *client, uint32_t events) {
+  if (client->events == events) {
+    return;
+  }
+  struct epoll_event ev = {.events = events, .data.ptr = client};
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+  client->events = events;
+}
+
+static void server_accept(Server_T *server) {
+  int fd;
+  while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    ServerClient_T *client = (ServerClient_T *)mem_calloc(MEM_NET, 1, sizeof(ServerClient_T));
+    if (!client) {
+      close(fd);
+      continue;
+    }
+    client->fd = fd;
+    client->events = EPOLLIN;
+    proto_session_init(&client->session, server->pool);
+
+    struct epoll_event ev = {.events = client->events, .data.ptr = client};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    client->next = server->clients;
+    if (server->clients) {
+      server->clients->prev = client;
+    }
+    server->clients = client;
+    server->accepted++;
+  }
+}
+
+static void server_drop(Server_T *server, ServerClient_T *client) {
+  epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+  close(client->fd);
+  if (client->prev) {
+    client->prev->next = client->next;
+  } else {
+    server->clients = client->next;
+  }
+  if (client->next) {
+    client->next->prev = client->prev;
+  }
+  proto_session_exit(&client->session);
+  proto_buf_free(&client->in);
+  proto_buf_free(&client->out);
+  mem_free(client);
+}
+
+/* Returns non-zero if the client has gone away or its input cannot be buffered */
+static int server_read(ServerClient_T *client) {
+  uint8_t *p = proto_buf_reserve(&client->in, SERVER_READ_CHUNK);
+  if (!p) {
+    return 1;
+  }
+  ssize_t n = read(client->fd, p, SERVER_READ_CHUNK);
+  client->in.len -= SERVER_READ_CHUNK - (n > 0 ? n : 0);
+  if (n == 0) {
+    return 1;
+  }
+  return n < 0 && errno != EAGAIN && errno != EINTR;
+}
+
+/* Returns non-zero if the client has gone away */
+static int server_flush(ServerClient_T *client) {
+  size_t written = 0;
+  while (written < client->out.len) {
+    ssize_t n = write(client->fd, client->out.data + written, client->out.len - written);
+    if (n < 0) {
+      if (errno == EAGAIN) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return 1;
+    }
+    written += n;
+  }
+  proto_buf_consume(&client->out, written);
+  return 0;
+}
+
+/**
+ * Answers whatever requests are buffered and writes the replies. Requests are left buffered while the client is
+ * not reading its replies, and reading from it is paused until it catches up.
+ * Returns non-zero if the client should be dropped.
+ */
+static int server_service(Server_T *server, ServerClient_T *client) {
+  for (;;) {
+    ssize_t used = proto_session_feed(&client->session, client->in.data, client->in.len, &client->out,
+                                      SERVER_OUT_HIGH_WATER);
+    if (used < 0) {
+      return 1;
+    }
+    proto_buf_consume(&client->in, used);
+    if (server_flush(client)) {
+      return 1;
+    }
+    /* Loop only if replies were backed up and the socket drained them */
+    if (!used || client->out.len) {
+      break;
+    }
+  }
+
+  uint32_t events = (client->out.len < SERVER_OUT_HIGH_WATER) ? EPOLLIN : 0;
+  if (client->out.len) {
+    events |= EPOLLOUT;
+  }
+  server_watch(server, client, events);
+  return 0;
+}
+
+int server_run(const char *path) {
+  Server_T server = {0};
+  server.listen_fd = server_listen(path);
+  if (server.listen_fd < 0) {
+    fprintf(stderr, "Could not listen on %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  server.pool = game_pool_init();
+  if (!server.pool) {
+    fprintf(stderr, "Out of memory\n");
+    close(server.listen_fd);
+    unlink(path);
+    return 1;
+  }
+  server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &ev);
+
+  /* No SA_RESTART, so a signal wakes epoll_wait up */
+  struct sigaction sa = {.sa_handler = server_stop};
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "Serving games on %s\n", path);
+
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  while (!server_stopping) {
+    int ready = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    for (int e = 0; e < ready; e++) {
+      ServerClient_T *client = (ServerClient_T *)events[e].data.ptr;
+      if (!client) {
+        server_accept(&server);
+        continue;
+      }
+
+      int gone = 0;
+      if (events[e].events & EPOLLIN) {
+        gone = server_read(client);
+      } else if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+        gone = 1;
+      }
+      /* Answer what already arrived even if the client has stopped sending */
+      if (server_service(&server, client) || gone) {
+        server_drop(&server, client);
+      }
+    }
+  }
+
+  fprintf(stderr, "Served %lu clients, %u games still open\n", server.accepted, server.pool->live);
+  while (server.clients) {
+    server_drop(&server, server.clients);
+  }
+  game_pool_exit(server.pool);
+  close(server.epoll_fd);
+  close(server.listen_fd);
+  unlink(path);
+  return 0;
+}
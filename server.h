@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/**
+ * Game server: hosts one game per connection on a Unix domain socket, speaking the protocol in protocol.h.
+ *
+ * A single thread multiplexes every client with epoll. Requests are handled as soon as a whole frame has arrived,
+ * and all replies produced by one read are written back with one write, so pipelining clients pay one round trip
+ * per batch rather than per request.
+ */
+#define SERVER_MAX_EVENTS 256
+#define SERVER_READ_CHUNK (64 * 1024)
+/* Stop handling a client's requests while this many reply bytes are waiting for it to read */
+#define SERVER_OUT_HIGH_WATER (4u << 20)
+
+/* Server prototypes begin */
+
+int server_run(const char *path);
+
+/* Server prototypes end */
+
+#endif /* SERVER_H */
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bytes.h"
+#include "protocol.h"
+
+/**
+ * Load generator for minesweeper --server.
+ *
+ * Opens many connections and, round-robin, pipelines a window of action frames on each before reading the replies.
+ * Every game opens its center cell and then toggles flags on random cells, so each op goes through the engine and
+ * comes back as a changed cell. Games are restarted every few rounds.
+ */
+#define SERVER_BENCH_WINDOW 16
+#define SERVER_BENCH_RESTART 64
+
+typedef struct BenchClient {
+  int fd;
+  unsigned int rounds;
+  ProtoBuf_T in;
+} BenchClient_T;
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+  while (len) {
+    ssize_t n = write(fd, buf, len);
+    if (n <= 0) {
+      return 1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Reads until `frames` whole replies are buffered, then drops them. Returns the number of error replies, -1 on EOF */
+static int read_replies(BenchClient_T *client, unsigned int frames) {
+  int errors = 0;
+  size_t pos = 0;
+  while (frames) {
+    if (client->in.len - pos >= PROTO_FRAME_HEADER && client->in.len - pos - 4 >= get_u32(client->in.data + pos)) {
+      errors += client->in.data[pos + 4] == PROTO_ERROR;
+      pos += 4 + get_u32(client->in.data + pos);
+      frames--;
+      continue;
+    }
+    uint8_t *p = proto_buf_reserve(&client->in, 65536);
+    ssize_t n = read(client->fd, p, 65536);
+    client->in.len -= 65536 - (n > 0 ? n : 0);
+    if (n <= 0) {
+      return -1;
+    }
+  }
+  proto_buf_consume(&client->in, pos);
+  return errors;
+}
+
+static void put_new(ProtoBuf_T *out, unsigned int rows, unsigned int cols, unsigned int bombs, unsigned int seed) {
+  uint8_t *p = proto_buf_reserve(out, PROTO_FRAME_HEADER + 16);
+  put_u32(p, 17);
+  p[4] = PROTO_NEW;
+  put_u32(p + 5, rows);
+  put_u32(p + 9, cols);
+  put_u32(p + 13, bombs);
+  put_u32(p + 17, seed);
+}
+
+static void put_op(uint8_t *p, ProtoOp_T op, uint32_t index) {
+  p[0] = op;
+  put_u32(p + 1, index);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 6 || argc > 8) {
+    fprintf(stderr, "Usage: %s <socket> <clients> <rows> <cols> <bombs> [rounds] [ops per frame]\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[1];
+  unsigned int num_clients = strtoul(argv[2], NULL, 10);
+  unsigned int rows = strtoul(argv[3], NULL, 10);
+  unsigned int cols = strtoul(argv[4], NULL, 10);
+  unsigned int bombs = strtoul(argv[5], NULL, 10);
+  unsigned int rounds = (argc > 6) ? strtoul(argv[6], NULL, 10) : 100;
+  unsigned int batch = (argc > 7) ? strtoul(argv[7], NULL, 10) : 64;
+  unsigned int cells = rows * cols;
+  if (!num_clients || !cells || !batch) {
+    fprintf(stderr, "Nothing to do\n");
+    return 1;
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  BenchClient_T *clients = (BenchClient_T *)calloc(num_clients, sizeof(BenchClient_T));
+  for (unsigned int c = 0; c < num_clients; c++) {
+    clients[c].fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(clients[c].fd, (struct sockaddr *)&addr, sizeof(addr))) {
+      fprintf(stderr, "Could not connect client %u to %s\n", c, path);
+      return 1;
+    }
+  }
+
+  struct timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ProtoBuf_T out = {0};
+  unsigned long ops = 0, errors = 0, games = 0;
+  srand(11);
+  for (unsigned int r = 0; r < rounds; r++) {
+    for (unsigned int c = 0; c < num_clients; c++) {
+      out.len = 0;
+      unsigned int frames = 0;
+      if (r % SERVER_BENCH_RESTART == 0) {
+        put_new(&out, rows, cols, bombs, rand());
+        uint8_t *p = proto_buf_reserve(&out, PROTO_FRAME_HEADER + PROTO_OP_SIZE);
+        put_u32(p, 1 + PROTO_OP_SIZE);
+        p[4] = PROTO_ACTIONS;
+        put_op(p + PROTO_FRAME_HEADER, PROTO_OP_UNCOVER, cells / 2 + cols / 2);
+        frames += 2;
+        ops++;
+        games++;
+      }
+      for (unsigned int w = 0; w < SERVER_BENCH_WINDOW; w++, frames++) {
+        uint8_t *p = proto_buf_reserve(&out, PROTO_FRAME_HEADER + batch * PROTO_OP_SIZE);
+        put_u32(p, 1 + batch * PROTO_OP_SIZE);
+        p[4] = PROTO_ACTIONS;
+        for (unsigned int b = 0; b < batch; b++) {
+          put_op(p + PROTO_FRAME_HEADER + b * PROTO_OP_SIZE, PROTO_OP_FLAG, rand() % cells);
+        }
+        ops += batch;
+      }
+      if (write_all(clients[c].fd, out.data, out.len)) {
+        fprintf(stderr, "Server went away\n");
+        return 1;
+      }
+      clients[c].rounds = frames;
+    }
+
+    for (unsigned int c = 0; c < num_clients; c++) {
+      int err = read_replies(&clients[c], clients[c].rounds);
+      if (err < 0) {
+        fprintf(stderr, "Server went away\n");
+        return 1;
+      }
+      errors += err;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  double secs = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+  printf("clients=%u games=%lu ops=%lu errors=%lu in %.3f s, %.0f ops/s\n", num_clients, games, ops, errors, secs,
+         ops / secs);
+
+  for (unsigned int c = 0; c < num_clients; c++) {
+    close(clients[c].fd);
+    proto_buf_free(&clients[c].in);
+  }
+  proto_buf_free(&out);
+  free(clients);
+  return 0;
+}
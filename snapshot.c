@@ -0,0 +1,90 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "minesweeper.h"
+#include "snapshot.h"
+
+/* Returns 1 if the cells could not be copied out */
+int board_snapshot(BoardSnapshot_T *snap, const GameBoard_T *board) {
+  memset(snap, 0, sizeof(BoardSnapshot_T));
+  snap->len = layout_bytes(&board->layout);
+  snap->fd = memfd_create("minesweeper-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (snap->fd < 0) {
+    return 1;
+  }
+
+  int failed = ftruncate(snap->fd, snap->len) != 0;
+  for (size_t done = 0; !failed && done < snap->len;) {
+    ssize_t wrote = pwrite(snap->fd, board->board + done, snap->len - done, done);
+    failed = wrote <= 0;
+    done += (wrote > 0) ? wrote : 0;
+  }
+  /* Sealed, so forks never see anything but these cells */
+  if (failed || fcntl(snap->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+    close(snap->fd);
+    snap->fd = -1;
+    return 1;
+  }
+
+  snap->height = board->height;
+  snap->width = board->width;
+  snap->num_bombs = board->num_bombs;
+  snap->num_flags = board->num_flags;
+  snap->remaining_open_cells = board->remaining_open_cells;
+  snap->curr_index = board->curr_index;
+  snap->seed = board->seed;
+  snap->generator = board->generator;
+  snap->game_state = board->game_state;
+  snap->is_first_turn = board->is_first_turn;
+  layout_copy(&snap->layout, &board->layout);
+  topology_share(&snap->topology, &board->topology);
+  return 0;
+}
+
+static void board_fork_state(const BoardSnapshot_T *snap, GameBoard_T *fork) {
+  fork->height = snap->height;
+  fork->width = snap->width;
+  fork->num_bombs = snap->num_bombs;
+  fork->num_flags = snap->num_flags;
+  fork->remaining_open_cells = snap->remaining_open_cells;
+  fork->curr_index = snap->curr_index;
+  fork->seed = snap->seed;
+  fork->generator = snap->generator;
+  fork->game_state = snap->game_state;
+  fork->is_first_turn = snap->is_first_turn;
+  fork->fill.len = 0;
+}
+
+/* Returns 1 if the snapshot could not be mapped. Release the fork with free_board() */
+int board_fork(const BoardSnapshot_T *snap, GameBoard_T *fork) {
+  memset(fork, 0, sizeof(GameBoard_T));
+  uint8_t *data = (uint8_t *)mmap(NULL, snap->len, PROT_READ | PROT_WRITE, MAP_PRIVATE, snap->fd, 0);
+  if (data == MAP_FAILED) {
+    return 1;
+  }
+  fork->board = data;
+  fork->mapping = data;
+  fork->mapping_len = snap->len;
+  layout_copy(&fork->layout, &snap->layout);
+  topology_share(&fork->topology, &snap->topology);
+  board_fork_state(snap, fork);
+  return 0;
+}
+
+/* Puts a fork back to the snapshot. Pages it never wrote to cost nothing */
+void board_fork_revert(const BoardSnapshot_T *snap, GameBoard_T *fork) {
+  madvise(fork->mapping, fork->mapping_len, MADV_DONTNEED);
+  board_fork_state(snap, fork);
+}
+
+void board_snapshot_free(BoardSnapshot_T *snap) {
+  if (snap->fd >= 0) {
+    close(snap->fd);
+  }
+  snap->fd = -1;
+  layout_exit(&snap->layout);
+  topology_exit(&snap->topology);
+}
@@ -0,0 +1,48 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "minesweeper.h"
+
+/**
+ * Copy-on-write board snapshots for trying moves and throwing them away.
+ *
+ * A snapshot copies a board's cells once into a sealed memfd, after which nothing can change them. Forking maps the
+ * snapshot copy-on-write, the same way load_board() maps a save file, so a fork costs one mmap() whatever the size of
+ * the board, and a write copies only the page it lands on. A fork is an ordinary board: flood fill, bomb counts and
+ * the rest of board.c work on it unchanged, with the snapshot's topology tables shared rather than built again.
+ * Reverting a fork drops the pages it copied, and free_board() unmaps it.
+ *
+ * Any number of forks can share a snapshot, from any thread. A fork has no scenes, journal, analysis or listener.
+ */
+typedef struct BoardSnapshot {
+  int fd;
+  size_t len;
+  unsigned int height;
+  unsigned int width;
+  unsigned int num_bombs;
+  unsigned int num_flags;
+  unsigned int remaining_open_cells;
+  unsigned int curr_index;
+  unsigned int seed;
+  BoardGenerator_T generator;
+  GameState_T game_state;
+  int is_first_turn;
+  Layout_T layout;
+  Topology_T topology;
+} BoardSnapshot_T;
+
+/* Snapshot prototypes begin */
+
+int board_snapshot(BoardSnapshot_T *snap, const GameBoard_T *board);
+
+int board_fork(const BoardSnapshot_T *snap, GameBoard_T *fork);
+
+void board_fork_revert(const BoardSnapshot_T *snap, GameBoard_T *fork);
+
+void board_snapshot_free(BoardSnapshot_T *snap);
+
+/* Snapshot prototypes end */
+
+#endif /* SNAPSHOT_H */
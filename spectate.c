@@ -0,0 +1,211 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "minesweeper.h"
+#include "protocol.h"
+#include "spectate.h"
+
+static size_t spectate_segment_len(uint32_t capacity, uint32_t height, uint32_t width) {
+  return sizeof(SpectateHeader_T) + capacity * sizeof(SpectateRecord_T) + 2 * (size_t)height * width;
+}
+
+int spectate_writer_open(SpectateWriter_T *sw, const char *name, unsigned int height, unsigned int width) {
+  memset(sw, 0, sizeof(SpectateWriter_T));
+  uint32_t capacity = 1u << SPECTATE_RING_CAPACITY_LOG2;
+  size_t len = spectate_segment_len(capacity, height, width);
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    return 1;
+  }
+  void *mapping = MAP_FAILED;
+  if (!ftruncate(fd, len)) {
+    mapping = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    shm_unlink(name);
+    return 1;
+  }
+
+  /* The segment starts zeroed: an empty ring and two keyframes of a fully covered board */
+  sw->shm = (SpectateHeader_T *)mapping;
+  sw->len = len;
+  sw->name = strdup(name);
+  sw->records = (SpectateRecord_T *)(sw->shm + 1);
+  sw->cells[0] = (uint8_t *)(sw->records + capacity);
+  sw->cells[1] = sw->cells[0] + (size_t)height * width;
+  sw->shm->version = SPECTATE_VERSION;
+  sw->shm->height = height;
+  sw->shm->width = width;
+  sw->shm->capacity = capacity;
+  atomic_thread_fence(memory_order_release);
+  sw->shm->magic = SPECTATE_MAGIC;
+  return 0;
+}
+
+static void spectate_write(SpectateWriter_T *sw, SpectateRecordType_T type, uint32_t index, uint32_t value) {
+  SpectateRecord_T *record = &sw->records[sw->head & (sw->shm->capacity - 1)];
+  /* Readers still on the last lap see the slot change before its fields do */
+  atomic_store_explicit(&record->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  record->type = type;
+  record->index = index;
+  record->value = value;
+  atomic_store_explicit(&record->seq, ++sw->head, memory_order_release);
+}
+
+static void spectate_keyframe(SpectateWriter_T *sw, GameBoard_T *board, const SpectateView_T *view) {
+  unsigned int slot = !atomic_load_explicit(&sw->shm->latest_keyframe, memory_order_relaxed);
+  SpectateKeyframe_T *keyframe = &sw->shm->keyframes[slot];
+  uint64_t seq = atomic_load_explicit(&keyframe->seq, memory_order_relaxed);
+  atomic_store_explicit(&keyframe->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  uint8_t *cells = sw->cells[slot];
+  for (unsigned int index = 0; index < board->height * board->width; index++) {
+    cells[index] = proto_visible_cell(__atomic_load_n(&CELL_KNOWN(board, index), __ATOMIC_RELAXED));
+  }
+  /* Readers that are following the ring pick the keyframe up from the marker written after it */
+  keyframe->position = sw->head + 1;
+  keyframe->view = *view;
+
+  atomic_store_explicit(&keyframe->seq, seq + 2, memory_order_release);
+  atomic_store_explicit(&sw->shm->latest_keyframe, slot, memory_order_release);
+  spectate_write(sw, SPECTATE_KEYFRAME, 0, 0);
+  atomic_store_explicit(&sw->shm->head, sw->head, memory_order_release);
+  sw->keyframe_position = sw->head;
+  sw->sent = *view;
+}
+
+/**
+ * Render thread: publishes the batch it is about to draw, or the whole board when `full` is set or the ring has
+ * moved far enough since the last keyframe.
+ */
+void spectate_frame(SpectateWriter_T *sw, GameBoard_T *board, int full) {
+  if (!sw->shm) {
+    return;
+  }
+  RenderState_T *rs = &board->render;
+  SpectateView_T view = {.cursor = rs->cursor,
+                         .num_flags = rs->num_flags,
+                         .seconds_elapsed = rs->seconds_elapsed,
+                         .game_state = board->game_state};
+  if (full || sw->head + rs->batch_len + 4 - sw->keyframe_position > SPECTATE_KEYFRAME_INTERVAL) {
+    spectate_keyframe(sw, board, &view);
+    return;
+  }
+
+  for (unsigned int ii = 0; ii < rs->batch_len; ii++) {
+    spectate_write(sw, SPECTATE_CELL, rs->batch[ii].index, proto_visible_cell(rs->batch[ii].value));
+  }
+  if (view.cursor != sw->sent.cursor) {
+    spectate_write(sw, SPECTATE_CURSOR, view.cursor, 0);
+  }
+  if (view.num_flags != sw->sent.num_flags || view.seconds_elapsed != sw->sent.seconds_elapsed) {
+    spectate_write(sw, SPECTATE_HEADER, view.num_flags, view.seconds_elapsed);
+  }
+  if (view.game_state != sw->sent.game_state) {
+    spectate_write(sw, SPECTATE_STATE, 0, view.game_state);
+  }
+  spectate_write(sw, SPECTATE_FRAME, 0, 0);
+  sw->sent = view;
+  atomic_store_explicit(&sw->shm->head, sw->head, memory_order_release);
+}
+
+void spectate_writer_close(SpectateWriter_T *sw) {
+  if (!sw->shm) {
+    return;
+  }
+  atomic_store(&sw->shm->closed, 1);
+  munmap(sw->shm, sw->len);
+  shm_unlink(sw->name);
+  free(sw->name);
+  memset(sw, 0, sizeof(SpectateWriter_T));
+}
+
+int spectate_reader_open(SpectateReader_T *sr, const char *name) {
+  memset(sr, 0, sizeof(SpectateReader_T));
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(SpectateHeader_T)) {
+    mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return 1;
+  }
+
+  const SpectateHeader_T *shm = (const SpectateHeader_T *)mapping;
+  sr->shm = shm;
+  sr->len = st.st_size;
+  if (shm->magic != SPECTATE_MAGIC || shm->version != SPECTATE_VERSION || !shm->capacity ||
+      (shm->capacity & (shm->capacity - 1)) ||
+      spectate_segment_len(shm->capacity, shm->height, shm->width) > sr->len) {
+    spectate_reader_close(sr);
+    return 1;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  sr->records = (const SpectateRecord_T *)(shm + 1);
+  sr->cells[0] = (const uint8_t *)(sr->records + shm->capacity);
+  sr->cells[1] = sr->cells[0] + (size_t)shm->height * shm->width;
+  return 0;
+}
+
+/* Copies the newest keyframe and continues reading the ring from where it was taken */
+void spectate_reader_keyframe(SpectateReader_T *sr, uint8_t *cells, SpectateView_T *view) {
+  SpectateHeader_T *shm = (SpectateHeader_T *)sr->shm;
+  for (;;) {
+    unsigned int slot = atomic_load_explicit(&shm->latest_keyframe, memory_order_acquire) & 1;
+    SpectateKeyframe_T *keyframe = &shm->keyframes[slot];
+    uint64_t seq = atomic_load_explicit(&keyframe->seq, memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    memcpy(cells, sr->cells[slot], (size_t)shm->height * shm->width);
+    *view = keyframe->view;
+    sr->position = keyframe->position;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&keyframe->seq, memory_order_relaxed) == seq) {
+      return;
+    }
+  }
+}
+
+/* Returns 1 and the next record, 0 if the writer has not got that far, -1 if it has lapped this reader */
+int spectate_reader_next(SpectateReader_T *sr, SpectateRecord_T *record) {
+  SpectateRecord_T *slot = (SpectateRecord_T *)&sr->records[sr->position & (sr->shm->capacity - 1)];
+  uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (seq < sr->position + 1) {
+    return 0;
+  } else if (seq > sr->position + 1) {
+    return -1;
+  }
+  record->type = slot->type;
+  record->index = slot->index;
+  record->value = slot->value;
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq) {
+    return -1;
+  }
+  sr->position++;
+  return 1;
+}
+
+int spectate_reader_closed(SpectateReader_T *sr) {
+  return atomic_load(&((SpectateHeader_T *)sr->shm)->closed);
+}
+
+void spectate_reader_close(SpectateReader_T *sr) {
+  if (sr->shm) {
+    munmap((void *)sr->shm, sr->len);
+  }
+  memset(sr, 0, sizeof(SpectateReader_T));
+}
@@ -0,0 +1,117 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Spectator broadcast through POSIX shared memory.
+ *
+ * The player's render thread writes what it draws into a shared-memory segment: every frame becomes a run of
+ * records in a ring, closed by a SPECTATE_FRAME record. Each ring slot carries its position plus one once it is
+ * written, so readers can tell a slot that is not written yet from one that has been lapped. Now and then, and
+ * whenever the render thread redraws the whole board, the visible board is copied into one of two keyframe slots
+ * instead and a SPECTATE_KEYFRAME record points readers at it. A keyframe slot's sequence number is odd while it is
+ * being written.
+ *
+ * Spectators map the segment read-only and never write to it, so the player does not know how many there are. A
+ * spectator that falls a whole ring behind starts again from the newest keyframe.
+ *
+ * Only what the player can see is published: covered cells never show their bomb.
+ */
+struct GameBoard;
+
+#define SPECTATE_MAGIC 0x5350534d /* "MSPS" */
+#define SPECTATE_VERSION 1
+#define SPECTATE_RING_CAPACITY_LOG2 16
+/* A keyframe is written once this many records have gone by since the last one */
+#define SPECTATE_KEYFRAME_INTERVAL ((1u << SPECTATE_RING_CAPACITY_LOG2) / 2)
+/* How often a spectator looks for new frames */
+#define SPECTATE_POLL_MS 10
+
+typedef enum SpectateRecordType {
+  SPECTATE_CELL,     /* index changed, value is its visible byte */
+  SPECTATE_CURSOR,   /* cursor moved to index */
+  SPECTATE_HEADER,   /* index is num_flags, value is seconds_elapsed */
+  SPECTATE_STATE,    /* value is the game state */
+  SPECTATE_FRAME,    /* the records before this one make up a frame */
+  SPECTATE_KEYFRAME, /* the whole board was published as a keyframe, which continues after this record */
+} SpectateRecordType_T;
+
+typedef struct SpectateRecord {
+  _Atomic uint64_t seq;
+  uint32_t type;
+  uint32_t index;
+  uint32_t value;
+  uint32_t reserved;
+} SpectateRecord_T;
+
+/* What a frame shows besides the cells */
+typedef struct SpectateView {
+  uint32_t cursor;
+  uint32_t num_flags;
+  uint32_t seconds_elapsed;
+  uint32_t game_state;
+} SpectateView_T;
+
+typedef struct SpectateKeyframe {
+  _Atomic uint64_t seq;
+  /* Ring position the keyframe is up to date with */
+  uint64_t position;
+  SpectateView_T view;
+} SpectateKeyframe_T;
+
+/* Start of the segment. The ring follows it, then the cells of keyframe 0 and of keyframe 1 */
+typedef struct SpectateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t height;
+  uint32_t width;
+  uint32_t capacity;
+  atomic_int closed;
+  _Atomic uint64_t head;
+  atomic_uint latest_keyframe;
+  SpectateKeyframe_T keyframes[2];
+} SpectateHeader_T;
+
+typedef struct SpectateWriter {
+  SpectateHeader_T *shm;
+  size_t len;
+  char *name;
+  SpectateRecord_T *records;
+  uint8_t *cells[2];
+  uint64_t head;
+  uint64_t keyframe_position;
+  SpectateView_T sent;
+} SpectateWriter_T;
+
+typedef struct SpectateReader {
+  const SpectateHeader_T *shm;
+  size_t len;
+  const SpectateRecord_T *records;
+  const uint8_t *cells[2];
+  uint64_t position;
+} SpectateReader_T;
+
+/* Spectate prototypes begin */
+
+int spectate_writer_open(SpectateWriter_T *sw, const char *name, unsigned int height, unsigned int width);
+
+void spectate_frame(SpectateWriter_T *sw, struct GameBoard *board, int full);
+
+void spectate_writer_close(SpectateWriter_T *sw);
+
+int spectate_reader_open(SpectateReader_T *sr, const char *name);
+
+void spectate_reader_keyframe(SpectateReader_T *sr, uint8_t *cells, SpectateView_T *view);
+
+int spectate_reader_next(SpectateReader_T *sr, SpectateRecord_T *record);
+
+int spectate_reader_closed(SpectateReader_T *sr);
+
+void spectate_reader_close(SpectateReader_T *sr);
+
+/* Spectate prototypes end */
+
+#endif /* SPECTATE_H */
@@ -0,0 +1,194 @@
+#include <string.h>
+
+#include "mem.h"
+#include "topology.h"
+
+typedef struct TopologyDelta {
+  int row;
+  int col;
+} TopologyDelta_T;
+
+static const TopologyDelta_T KING_DELTAS[] = {{-1, 0}, {-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}};
+static const TopologyDelta_T HEX_EVEN_DELTAS[] = {{-1, -1}, {-1, 0}, {0, -1}, {0, 1}, {1, -1}, {1, 0}};
+static const TopologyDelta_T HEX_ODD_DELTAS[] = {{-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, 0}, {1, 1}};
+static const TopologyDelta_T KNIGHT_DELTAS[] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+
+static const char *TOPOLOGY_NAMES[NUM_TOPOLOGIES] = {"square", "torus", "hex", "knight"};
+
+/* The steps to a cell's neighbors, and how far from an edge they reach */
+static const TopologyDelta_T *topology_deltas(TopologyKind_T kind, unsigned int row, unsigned int *len,
+                                              unsigned int *reach) {
+  switch (kind) {
+  case TOPOLOGY_HEX:
+    *len = 6;
+    *reach = 1;
+    return (row & 1) ? HEX_ODD_DELTAS : HEX_EVEN_DELTAS;
+  case TOPOLOGY_KNIGHT:
+    *len = 8;
+    *reach = 2;
+    return KNIGHT_DELTAS;
+  case TOPOLOGY_SQUARE:
+  case TOPOLOGY_TORUS:
+  default:
+    *len = 8;
+    *reach = 1;
+    return KING_DELTAS;
+  }
+}
+
+/* Works a cell's neighbor list out from scratch. A torus narrower than three cells reaches some neighbors twice */
+static unsigned int topology_walk(const Topology_T *topo, unsigned int row, unsigned int col, uint32_t *out) {
+  unsigned int len, reach, count = 0;
+  const TopologyDelta_T *deltas = topology_deltas(topo->kind, row, &len, &reach);
+  unsigned int index = row * topo->width + col;
+  for (unsigned int k = 0; k < len; k++) {
+    long r = (long)row + deltas[k].row, c = (long)col + deltas[k].col;
+    if (topo->kind == TOPOLOGY_TORUS) {
+      r = (r + topo->height) % topo->height;
+      c = (c + topo->width) % topo->width;
+    } else if (r < 0 || r >= topo->height || c < 0 || c >= topo->width) {
+      continue;
+    }
+    uint32_t neighbor = (uint32_t)(r * topo->width + c);
+    int seen = neighbor == index;
+    for (unsigned int ii = 0; ii < count && !seen; ii++) {
+      seen = out[ii] == neighbor;
+    }
+    if (!seen) {
+      out[count++] = neighbor;
+    }
+  }
+  return count;
+}
+
+/* Where a cell in the band along the edges has its neighbor list */
+static unsigned int topology_edge_slot(const Topology_T *topo, unsigned int row, unsigned int col) {
+  unsigned int sides = topo->left + topo->right;
+  if (row < topo->top) {
+    return row * topo->width + col;
+  }
+  row -= topo->top;
+  if (row >= topo->mid_rows) {
+    return topo->top * topo->width + topo->mid_rows * sides + (row - topo->mid_rows) * topo->width + col;
+  }
+  return topo->top * topo->width + row * sides + ((col < topo->left) ? col : col - topo->mid_cols);
+}
+
+/* The neighbors of a cell within reach of an edge, out of the edge table */
+unsigned int topology_edge_neighbors(const Topology_T *topo, unsigned int row, unsigned int col, uint32_t *out) {
+  const TopologyEdges_T *edges = topo->edges;
+  unsigned int slot = topology_edge_slot(topo, row, col);
+  unsigned int len = edges->start[slot + 1] - edges->start[slot];
+  memcpy(out, edges->cells + edges->start[slot], len * sizeof(uint32_t));
+  for (unsigned int k = len; k < TOPOLOGY_MAX_NEIGHBORS; k++) {
+    out[k] = TOPOLOGY_NO_NEIGHBOR;
+  }
+  return len;
+}
+
+static void topology_release(Topology_T *topo) {
+  TopologyEdges_T *edges = topo->edges;
+  topo->edges = NULL;
+  if (edges && atomic_fetch_sub(&edges->refs, 1) == 1) {
+    mem_free(edges->start);
+    mem_free(edges->cells);
+    mem_free(edges);
+  }
+}
+
+/* Builds the tables for a board of the given size. Does nothing if they already describe it */
+void topology_init(Topology_T *topo, TopologyKind_T kind, unsigned int height, unsigned int width) {
+  if (topo->edges && topo->edges->kind == kind && topo->height == height && topo->width == width) {
+    return;
+  }
+  topology_release(topo);
+  memset(topo, 0, sizeof(Topology_T));
+  topo->kind = kind;
+  topo->height = height;
+  topo->width = width;
+
+  unsigned int len, reach;
+  for (unsigned int parity = 0; parity < 2; parity++) {
+    const TopologyDelta_T *deltas = topology_deltas(kind, parity, &len, &reach);
+    for (unsigned int k = 0; k < len; k++) {
+      topo->offsets[parity][k] = deltas[k].row * (int)width + deltas[k].col;
+    }
+  }
+  topo->num_offsets = len;
+  topo->top = (reach < height) ? reach : height;
+  topo->bottom = (height - topo->top < reach) ? height - topo->top : reach;
+  topo->left = (reach < width) ? reach : width;
+  topo->right = (width - topo->left < reach) ? width - topo->left : reach;
+  topo->mid_rows = height - topo->top - topo->bottom;
+  topo->mid_cols = width - topo->left - topo->right;
+
+  unsigned int num_edge = height * width - topo->mid_rows * topo->mid_cols;
+  TopologyEdges_T *edges = (TopologyEdges_T *)mem_alloc(MEM_BOARD, sizeof(TopologyEdges_T));
+  atomic_init(&edges->refs, 1);
+  edges->kind = kind;
+  edges->start = (uint32_t *)mem_alloc(MEM_BOARD, (num_edge + 1) * sizeof(uint32_t));
+  edges->cells = (uint32_t *)mem_alloc(MEM_BOARD, (size_t)num_edge * TOPOLOGY_MAX_NEIGHBORS * sizeof(uint32_t) + 1);
+
+  /* Slots run in row-major order over the band, so the lists can be laid down one after the other */
+  uint32_t used = 0;
+  for (unsigned int row = 0; row < height; row++) {
+    int interior_row = row - topo->top < topo->mid_rows;
+    for (unsigned int col = 0; col < width; col++) {
+      if (interior_row && col - topo->left < topo->mid_cols) {
+        col += topo->mid_cols - 1;
+        continue;
+      }
+      edges->start[topology_edge_slot(topo, row, col)] = used;
+      used += topology_walk(topo, row, col, edges->cells + used);
+    }
+  }
+  edges->start[num_edge] = used;
+  topo->edges = edges;
+}
+
+/* Points topo at the tables of another board of the same size, without building them again */
+void topology_share(Topology_T *topo, const Topology_T *from) {
+  topology_release(topo);
+  *topo = *from;
+  if (topo->edges) {
+    atomic_fetch_add(&topo->edges->refs, 1);
+  }
+}
+
+int topology_adjacent(const Topology_T *topo, unsigned int index, unsigned int other) {
+  uint32_t neighbors[TOPOLOGY_MAX_NEIGHBORS];
+  unsigned int count = topology_neighbors(topo, index, neighbors);
+  for (unsigned int k = 0; k < count; k++) {
+    if (neighbors[k] == other) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Whether two cells being neighbors depends only on the step between them, unchanged by rotating or mirroring it */
+int topology_translates(TopologyKind_T kind) {
+  return kind == TOPOLOGY_SQUARE || kind == TOPOLOGY_KNIGHT;
+}
+
+const char *topology_name(TopologyKind_T kind) {
+  return ((unsigned int)kind < NUM_TOPOLOGIES) ? TOPOLOGY_NAMES[kind] : "unknown";
+}
+
+/* Returns 1 if name is not a topology */
+int topology_parse(const char *name, TopologyKind_T *kind) {
+  for (unsigned int k = 0; k < NUM_TOPOLOGIES; k++) {
+    if (!strcmp(name, TOPOLOGY_NAMES[k])) {
+      *kind = (TopologyKind_T)k;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void topology_exit(Topology_T *topo) {
+  TopologyKind_T kind = topo->kind;
+  topology_release(topo);
+  memset(topo, 0, sizeof(Topology_T));
+  topo->kind = kind;
+}
@@ -0,0 +1,108 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Board topologies: which cells are a cell's neighbors.
+ *
+ *   square  the eight cells around it
+ *   torus   the same eight, with the edges of the board wrapping around to the opposite side
+ *   hex     the six cells around it, with the odd rows set half a cell to the right of the even ones
+ *   knight  the eight cells a knight's move away
+ *
+ * Each board compiles its topology into tables when it is sized. Cells far enough from the edges have their neighbors
+ * at the same offsets from their own index (one set per row parity on hex boards), so they share one short offset
+ * list. Only the cells within reach of an edge get their own lists, in a compressed table indexed by their position
+ * in the band of rows and columns along the edges. The edge table never changes once built and is shared, counted,
+ * between a board and its snapshots and forks.
+ */
+#define TOPOLOGY_MAX_NEIGHBORS 8
+/* Pads neighbor lists to TOPOLOGY_MAX_NEIGHBORS, the same value as INVALID_INDEX */
+#define TOPOLOGY_NO_NEIGHBOR UINT32_MAX
+
+typedef enum TopologyKind {
+  TOPOLOGY_SQUARE = 0,
+  TOPOLOGY_TORUS = 1,
+  TOPOLOGY_HEX = 2,
+  TOPOLOGY_KNIGHT = 3,
+  NUM_TOPOLOGIES,
+} TopologyKind_T;
+
+typedef struct TopologyEdges {
+  atomic_uint refs;
+  TopologyKind_T kind;
+  /* Neighbors of the edge cell in slot s are cells[start[s]] to cells[start[s + 1]] */
+  uint32_t *start;
+  uint32_t *cells;
+} TopologyEdges_T;
+
+typedef struct Topology {
+  TopologyKind_T kind;
+  unsigned int height;
+  unsigned int width;
+  /* Edge rows above and below the interior, edge columns left and right of it, and the interior's size */
+  unsigned int top;
+  unsigned int bottom;
+  unsigned int left;
+  unsigned int right;
+  unsigned int mid_rows;
+  unsigned int mid_cols;
+  /* Neighbor offsets of an interior cell, by row parity */
+  unsigned int num_offsets;
+  int offsets[2][TOPOLOGY_MAX_NEIGHBORS];
+  TopologyEdges_T *edges;
+} Topology_T;
+
+unsigned int topology_edge_neighbors(const Topology_T *topo, unsigned int row, unsigned int col, uint32_t *out);
+
+/**
+ * Fills out with the neighbors of a cell on the board, followed by TOPOLOGY_NO_NEIGHBOR up to the end, and returns
+ * how many there are. Square boards, by far the most common, spell out their eight interior offsets instead of reading
+ * them from the offset list, starting above the cell and going around counterclockwise.
+ */
+static inline unsigned int topology_neighbors(const Topology_T *topo, unsigned int index,
+                                              uint32_t out[TOPOLOGY_MAX_NEIGHBORS]) {
+  unsigned int row = index / topo->width, col = index - row * topo->width;
+  if (row - topo->top < topo->mid_rows && col - topo->left < topo->mid_cols) {
+    if (topo->kind == TOPOLOGY_SQUARE) {
+      unsigned int width = topo->width;
+      out[0] = index - width;
+      out[1] = index - width - 1;
+      out[2] = index - 1;
+      out[3] = index + width - 1;
+      out[4] = index + width;
+      out[5] = index + width + 1;
+      out[6] = index + 1;
+      out[7] = index - width + 1;
+      return 8;
+    }
+    const int *offsets = topo->offsets[row & 1];
+    for (unsigned int k = 0; k < TOPOLOGY_MAX_NEIGHBORS; k++) {
+      out[k] = (k < topo->num_offsets) ? index + offsets[k] : TOPOLOGY_NO_NEIGHBOR;
+    }
+    return topo->num_offsets;
+  }
+  return topology_edge_neighbors(topo, row, col, out);
+}
+
+/* Topology prototypes begin */
+
+void topology_init(Topology_T *topo, TopologyKind_T kind, unsigned int height, unsigned int width);
+
+void topology_share(Topology_T *topo, const Topology_T *from);
+
+int topology_adjacent(const Topology_T *topo, unsigned int index, unsigned int other);
+
+int topology_translates(TopologyKind_T kind);
+
+const char *topology_name(TopologyKind_T kind);
+
+int topology_parse(const char *name, TopologyKind_T *kind);
+
+void topology_exit(Topology_T *topo);
+
+/* Topology prototypes end */
+
+#endif /* TOPOLOGY_H */
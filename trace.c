@@ -0,0 +1,154 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+typedef struct TraceBuffer {
+  TraceRecord_T records[TRACE_RING_CAPACITY];
+  /* Only the owning thread writes head. The dump reads it once writers are done */
+  _Atomic uint64_t head;
+  long tid;
+  struct TraceBuffer *next;
+} TraceBuffer_T;
+
+typedef struct TraceSamples {
+  uint64_t samples[TRACE_SAMPLE_CAPACITY];
+  unsigned int count;
+  unsigned int next;
+} TraceSamples_T;
+
+/* Every thread's buffer, pushed with a CAS so registration never takes a lock */
+static _Atomic(TraceBuffer_T *) trace_buffers = NULL;
+static atomic_flag trace_atexit_registered = ATOMIC_FLAG_INIT;
+static __thread TraceBuffer_T *trace_local = NULL;
+
+/* Live summary state. Frames are marked by the render thread only, input by the logic thread */
+static TraceSamples_T frame_samples;
+static TraceSamples_T latency_samples;
+static uint64_t frame_start_ns = 0;
+static _Atomic uint64_t pending_input_ns = 0;
+
+uint64_t trace_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void trace_dump_atexit(void) {
+  const char *path = getenv("MINESWEEPER_TRACE_FILE");
+  trace_dump(path ? path : TRACE_DEFAULT_FILE);
+}
+
+static TraceBuffer_T *trace_register_thread(void) {
+  TraceBuffer_T *buf = (TraceBuffer_T *)calloc(1, sizeof(TraceBuffer_T));
+  if (!buf) {
+    return NULL;
+  }
+  buf->tid = syscall(SYS_gettid);
+
+  TraceBuffer_T *head = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+  do {
+    buf->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&trace_buffers, &head, buf, memory_order_release,
+                                                  memory_order_relaxed));
+
+  if (!atomic_flag_test_and_set(&trace_atexit_registered)) {
+    atexit(trace_dump_atexit);
+  }
+  return buf;
+}
+
+void trace_record(const char *name, TracePhase_T phase) {
+  if (!trace_local && !(trace_local = trace_register_thread())) {
+    return;
+  }
+
+  uint64_t head = atomic_load_explicit(&trace_local->head, memory_order_relaxed);
+  TraceRecord_T *rec = &trace_local->records[head & (TRACE_RING_CAPACITY - 1)];
+  rec->ts_ns = trace_now_ns();
+  rec->name = name;
+  rec->phase = phase;
+  atomic_store_explicit(&trace_local->head, head + 1, memory_order_release);
+}
+
+static void trace_sample_add(TraceSamples_T *s, uint64_t sample) {
+  s->samples[s->next] = sample;
+  s->next = (s->next + 1) % TRACE_SAMPLE_CAPACITY;
+  if (s->count < TRACE_SAMPLE_CAPACITY) {
+    s->count++;
+  }
+}
+
+void trace_input_mark(void) {
+  /* Keep the oldest unpresented input, that is the one the player waited on the longest */
+  uint64_t none = 0;
+  atomic_compare_exchange_strong(&pending_input_ns, &none, trace_now_ns());
+}
+
+void trace_frame_begin(void) { frame_start_ns = trace_now_ns(); }
+
+void trace_frame_end(void) {
+  uint64_t now = trace_now_ns();
+  if (frame_start_ns) {
+    trace_sample_add(&frame_samples, now - frame_start_ns);
+    frame_start_ns = 0;
+  }
+  uint64_t input_ns = atomic_exchange(&pending_input_ns, 0);
+  if (input_ns) {
+    trace_sample_add(&latency_samples, now - input_ns);
+  }
+}
+
+static int trace_cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void trace_percentiles(const TraceSamples_T *s, uint64_t *p50, uint64_t *p99) {
+  uint64_t sorted[TRACE_SAMPLE_CAPACITY];
+  *p50 = *p99 = 0;
+  if (!s->count) {
+    return;
+  }
+
+  memcpy(sorted, s->samples, s->count * sizeof(uint64_t));
+  qsort(sorted, s->count, sizeof(uint64_t), trace_cmp_u64);
+  *p50 = sorted[(s->count - 1) * 50 / 100];
+  *p99 = sorted[(s->count - 1) * 99 / 100];
+}
+
+void trace_summary(TraceSummary_T *summary) {
+  summary->frames = frame_samples.count;
+  trace_percentiles(&frame_samples, &summary->frame_p50_ns, &summary->frame_p99_ns);
+  trace_percentiles(&latency_samples, &summary->latency_p50_ns, &summary->latency_p99_ns);
+}
+
+int trace_dump(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    return 1;
+  }
+
+  int pid = getpid();
+  int first = 1;
+  fprintf(out, "{\"traceEvents\":[");
+  for (TraceBuffer_T *buf = atomic_load_explicit(&trace_buffers, memory_order_acquire); buf; buf = buf->next) {
+    uint64_t head = atomic_load_explicit(&buf->head, memory_order_acquire);
+    uint64_t start = (head > TRACE_RING_CAPACITY) ? head - TRACE_RING_CAPACITY : 0;
+    for (uint64_t i = start; i < head; i++) {
+      TraceRecord_T *rec = &buf->records[i & (TRACE_RING_CAPACITY - 1)];
+      fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%ld}", first ? "" : ",",
+              rec->name, rec->phase, (unsigned long long)(rec->ts_ns / 1000), (unsigned long long)(rec->ts_ns % 1000),
+              pid, buf->tid);
+      first = 0;
+    }
+  }
+  fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return fclose(out) ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/**
+ * Hot-path tracing.
+ *
+ * Trace points are compiled in only when TRACE is defined. Each thread writes begin/end records into its own
+ * ring buffer, and every buffer is dumped at exit in Chrome trace-event JSON (chrome://tracing, Perfetto).
+ * The dump goes to $MINESWEEPER_TRACE_FILE, or TRACE_DEFAULT_FILE when unset.
+ */
+#define TRACE_DEFAULT_FILE "minesweeper-trace.json"
+
+/* Records per thread. Must be a power of two, the oldest records are overwritten first */
+#define TRACE_RING_CAPACITY (1 << 16)
+
+/* Number of recent frames kept for the live latency summary */
+#define TRACE_SAMPLE_CAPACITY 512
+
+typedef enum TracePhase {
+  TRACE_PHASE_BEGIN = 'B',
+  TRACE_PHASE_END = 'E',
+} TracePhase_T;
+
+typedef struct TraceRecord {
+  uint64_t ts_ns;
+  const char *name;
+  TracePhase_T phase;
+} TraceRecord_T;
+
+typedef struct TraceSummary {
+  unsigned int frames;
+  uint64_t frame_p50_ns;
+  uint64_t frame_p99_ns;
+  uint64_t latency_p50_ns;
+  uint64_t latency_p99_ns;
+} TraceSummary_T;
+
+#ifdef TRACE
+#define TRACE_BEGIN(name) trace_record(name, TRACE_PHASE_BEGIN)
+#define TRACE_END(name) trace_record(name, TRACE_PHASE_END)
+#define TRACE_SCOPE(name, stmts)                                                                                       \
+  TRACE_BEGIN(name);                                                                                                   \
+  stmts;                                                                                                               \
+  TRACE_END(name)
+#define TRACE_INPUT() trace_input_mark()
+#define TRACE_FRAME_BEGIN() trace_frame_begin()
+#define TRACE_FRAME_END() trace_frame_end()
+#else
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#define TRACE_SCOPE(name, stmts) stmts
+#define TRACE_INPUT()
+#define TRACE_FRAME_BEGIN()
+#define TRACE_FRAME_END()
+#endif
+
+/* Trace prototypes begin */
+
+uint64_t trace_now_ns(void);
+
+void trace_record(const char *name, TracePhase_T phase);
+
+void trace_input_mark(void);
+
+void trace_frame_begin(void);
+
+void trace_frame_end(void);
+
+void trace_summary(TraceSummary_T *summary);
+
+int trace_dump(const char *path);
+
+/* Trace prototypes end */
+
+#endif /* TRACE_H */